@@ -1,3 +1,6 @@
+// Only EON networks are simulated, so their links are fixed as single-core
+// and single-mode at compile time
+#define NETWORK_TYPE EON
 #include "./src/buffer.cpp"
 /*********************************************************************************
  * This is an allocation algorithm that follows the First Fit allocation
@@ -25,6 +28,26 @@ double bitrate_count_blocked[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
 bool buffer_state = false;
 bool allocating_from_buffer = false;
 
+// Stopping rule: end each load point once the Wilson CI of BP and BBP is
+// within 5% of the estimate (number_connections becomes the maximum)
+bool stopping_rule = false;
+
+// Warm-up detection (MSER-5): once steady state is reached, BP, the BBP
+// counters and the buffer averages restart, deleting the transient fill-up
+bool warmup_detection = false;
+
+// Common random numbers: every connection draws its traffic from its own
+// substream, so runs with the buffer ON and OFF see the same connections
+bool common_random_numbers = false;
+
+// Defragmentation: every holding time (1/mu) the active connections are
+// moved to the lowest free slots of their routes
+bool defragmentation = false;
+
+// Fragmentation statistics: the external fragmentation, spectrum entropy and
+// free blocks of the network are averaged over time and written to the output
+bool fragmentation_statistics = false;
+
 // Weight RMSA:
 //double mean_weight_bitrate[5] = {1.0, 1.25, 3.0, 9.5, 23};
 
@@ -61,6 +84,22 @@ double last_time = 0;
 
 // #################################################################################
 
+// Warm-up callback function: the simulator restarts its statistics at the
+// detection, so the BBP counters and the buffer averages restart with them
+void warmupReset(long long /* warmup_connections */) {
+  for (int b = 0; b < 5; b++){
+    bitrate_count_total[b] = 0.0;
+    bitrate_count_blocked[b] = 0.0;
+  }
+  buffer.poped = 0;
+  buffer.mean_service_time = 0;
+  buffer.mean_size_time = 0;
+  buffer.mean_attempts = 0;
+  buffer.start_time = buffer.last_time;
+  buffer.batch_service_time.reset();
+  buffer.batch_size_time.reset();
+}
+
 // Allocation function
 BEGIN_ALLOC_FUNCTION(FirstFit) {
 
@@ -69,6 +108,7 @@ BEGIN_ALLOC_FUNCTION(FirstFit) {
   // Calculate avg buffer size
   if (buffer_state){
     buffer.mean_size_time += buffer.size()*(con.getTimeConnection() -  buffer.last_time);
+    buffer.batch_size_time.addValue(buffer.size(), con.getTimeConnection() - buffer.last_time);
     buffer.last_time = con.getTimeConnection();
   }
 
@@ -85,6 +125,7 @@ BEGIN_ALLOC_FUNCTION(FirstFit) {
     for (int m = 0; m < NUMBER_OF_MODULATIONS;
         m++){ // <- For modulation m
         numberOfSlots = REQ_SLOTS(m); //<- Number of slots that this modulation format requires
+        if (numberOfSlots > ROUTE_LARGEST_FREE_BLOCK(r)) continue; // <- Some link of the route has no free block that large
         //double route_length = 0; // For checking route length
         for (int l = 0; l < NUMBER_OF_LINKS(r);
             l++){ // <- this loops through the links that the current route contains
@@ -168,6 +209,7 @@ BEGIN_UNALLOC_CALLBACK_FUNCTION {
 
       // Total time the connection was in queue
       buffer.mean_service_time += t - front_queue->time_arrival;
+      buffer.batch_service_time.addValue(t - front_queue->time_arrival);
 
       // We keep track of how many times attempted to be allocated from buffer
       buffer.mean_attempts += buffer.front()->current_attempts;
@@ -175,8 +217,7 @@ BEGIN_UNALLOC_CALLBACK_FUNCTION {
       // We output the currrent time being allocated
       //realloc_time << t << "\n";
       
-      // Element allocated so we poped it and delete() members
-      delete(buffer.front()->bitRate);
+      // Element allocated so we poped it
       buffer.pop_front();
 
       // Keep count of how many connections where allocated from the buffer
@@ -226,6 +267,15 @@ int main(int argc, char* argv[]) {
     sim.setGoalConnections(number_connections);
     sim.setLambda(lambdas[lambda]);
     sim.setMu(mu);
+    sim.setBBPWeights(std::vector<double>(std::begin(mean_weight_bitrate), std::end(mean_weight_bitrate)));
+    if (stopping_rule) sim.setStoppingRule(WILSON_CI, 0.05);
+    if (common_random_numbers) sim.setCommonRandomNumbers(true);
+    if (defragmentation) sim.getController()->setDefragmentation(DEFRAGMENT_PERIODICALLY, 1 / mu);
+    if (fragmentation_statistics) sim.setFragmentationStatistics(true);
+    if (warmup_detection){
+      sim.setWarmupDetection();
+      sim.setWarmupCallback(warmupReset);
+    }
     sim.init();
 
     // Set controller accessible for unalloc function (required for buffer)
@@ -247,8 +297,9 @@ int main(int argc, char* argv[]) {
       output.open("./out/RSA-NSFNet-NBuffer-1e7.txt", std::ios::out | std::ios::app);
     }
 
-    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(), number_connections,
-                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time);
+    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(),
+                  (sim.targetReached() ? sim.getNumberOfConnections() : number_connections) - sim.getWarmupConnections(),
+                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time, sim);
 
     /*
     if (buffer_state) {
@@ -259,13 +310,15 @@ int main(int argc, char* argv[]) {
 
     // Reset global variables
       // Clear buffer and related variables
-    for (int be = 0; be < buffer.size(); be++) delete(buffer.elements[be].bitRate);
     buffer.clear();
     buffer.poped = 0;
     buffer.last_time = 0;
+    buffer.start_time = 0;
     buffer.mean_service_time = 0;
     buffer.mean_size_time = 0;
     buffer.mean_attempts = 0;
+    buffer.batch_service_time.reset();
+    buffer.batch_size_time.reset();
       // Reset global variables for BBP calculation
     for (int b = 0; b < 5; b++){
       bitrate_count_total[b] = 0.0;
@@ -304,6 +357,15 @@ int main(int argc, char* argv[]) {
     sim.setGoalConnections(number_connections);
     sim.setLambda(lambdas[lambda]);
     sim.setMu(mu);
+    sim.setBBPWeights(std::vector<double>(std::begin(mean_weight_bitrate), std::end(mean_weight_bitrate)));
+    if (stopping_rule) sim.setStoppingRule(WILSON_CI, 0.05);
+    if (common_random_numbers) sim.setCommonRandomNumbers(true);
+    if (defragmentation) sim.getController()->setDefragmentation(DEFRAGMENT_PERIODICALLY, 1 / mu);
+    if (fragmentation_statistics) sim.setFragmentationStatistics(true);
+    if (warmup_detection){
+      sim.setWarmupDetection();
+      sim.setWarmupCallback(warmupReset);
+    }
     sim.init();
 
     // Set controller accessible for unalloc function (required for buffer)
@@ -322,8 +384,9 @@ int main(int argc, char* argv[]) {
     std::fstream output;
     output.open("./out/RSA-COST239-WBuffer-1e7.txt", std::ios::out | std::ios::app);
 
-    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(), number_connections,
-                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time);
+    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(),
+                  (sim.targetReached() ? sim.getNumberOfConnections() : number_connections) - sim.getWarmupConnections(),
+                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time, sim);
 
     if (buffer_state) {
       realloc_time.close();
@@ -332,13 +395,15 @@ int main(int argc, char* argv[]) {
 
     // Reset global variables
       // Clear buffer and related variables
-    for (int be = 0; be < buffer.size(); be++) delete(buffer.elements[be].bitRate);
     buffer.clear();
     buffer.poped = 0;
     buffer.last_time = 0;
+    buffer.start_time = 0;
     buffer.mean_service_time = 0;
     buffer.mean_size_time = 0;
     buffer.mean_attempts = 0;
+    buffer.batch_service_time.reset();
+    buffer.batch_size_time.reset();
       // Reset global variables for BBP calculation
     for (int b = 0; b < 5; b++){
       bitrate_count_total[b] = 0.0;
@@ -377,6 +442,15 @@ int main(int argc, char* argv[]) {
     sim.setGoalConnections(number_connections);
     sim.setLambda(lambdas[lambda]);
     sim.setMu(mu);
+    sim.setBBPWeights(std::vector<double>(std::begin(mean_weight_bitrate), std::end(mean_weight_bitrate)));
+    if (stopping_rule) sim.setStoppingRule(WILSON_CI, 0.05);
+    if (common_random_numbers) sim.setCommonRandomNumbers(true);
+    if (defragmentation) sim.getController()->setDefragmentation(DEFRAGMENT_PERIODICALLY, 1 / mu);
+    if (fragmentation_statistics) sim.setFragmentationStatistics(true);
+    if (warmup_detection){
+      sim.setWarmupDetection();
+      sim.setWarmupCallback(warmupReset);
+    }
     sim.init();
 
     // Set controller accessible for unalloc function (required for buffer)
@@ -395,8 +469,9 @@ int main(int argc, char* argv[]) {
     std::fstream output;
     output.open("./out/RSA-USNet-WBuffer-1e7.txt", std::ios::out | std::ios::app);
 
-    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(), number_connections,
-                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time);
+    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(),
+                  (sim.targetReached() ? sim.getNumberOfConnections() : number_connections) - sim.getWarmupConnections(),
+                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time, sim);
 
     if (buffer_state) {
       realloc_time.close();
@@ -405,13 +480,15 @@ int main(int argc, char* argv[]) {
 
     // Reset global variables
       // Clear buffer and related variables
-    for (int be = 0; be < buffer.size(); be++) delete(buffer.elements[be].bitRate);
     buffer.clear();
     buffer.poped = 0;
     buffer.last_time = 0;
+    buffer.start_time = 0;
     buffer.mean_service_time = 0;
     buffer.mean_size_time = 0;
     buffer.mean_attempts = 0;
+    buffer.batch_service_time.reset();
+    buffer.batch_size_time.reset();
       // Reset global variables for BBP calculation
     for (int b = 0; b < 5; b++){
       bitrate_count_total[b] = 0.0;
@@ -449,6 +526,15 @@ int main(int argc, char* argv[]) {
     sim.setGoalConnections(number_connections);
     sim.setLambda(lambdas[lambda]);
     sim.setMu(mu);
+    sim.setBBPWeights(std::vector<double>(std::begin(mean_weight_bitrate), std::end(mean_weight_bitrate)));
+    if (stopping_rule) sim.setStoppingRule(WILSON_CI, 0.05);
+    if (common_random_numbers) sim.setCommonRandomNumbers(true);
+    if (defragmentation) sim.getController()->setDefragmentation(DEFRAGMENT_PERIODICALLY, 1 / mu);
+    if (fragmentation_statistics) sim.setFragmentationStatistics(true);
+    if (warmup_detection){
+      sim.setWarmupDetection();
+      sim.setWarmupCallback(warmupReset);
+    }
     sim.init();
 
     // Set controller accessible for unalloc function (required for buffer)
@@ -467,8 +553,9 @@ int main(int argc, char* argv[]) {
     std::fstream output;
     output.open("./out/RSA-UKNet-WBuffer-1e7.txt", std::ios::out | std::ios::app);
 
-    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(), number_connections,
-                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time);
+    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(),
+                  (sim.targetReached() ? sim.getNumberOfConnections() : number_connections) - sim.getWarmupConnections(),
+                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time, sim);
 
     if (buffer_state) {
       realloc_time.close();
@@ -477,13 +564,15 @@ int main(int argc, char* argv[]) {
 
     // Reset global variables
       // Clear buffer and related variables
-    for (int be = 0; be < buffer.size(); be++) delete(buffer.elements[be].bitRate);
     buffer.clear();
     buffer.poped = 0;
     buffer.last_time = 0;
+    buffer.start_time = 0;
     buffer.mean_service_time = 0;
     buffer.mean_size_time = 0;
     buffer.mean_attempts = 0;
+    buffer.batch_service_time.reset();
+    buffer.batch_size_time.reset();
       // Reset global variables for BBP calculation
     for (int b = 0; b < 5; b++){
       bitrate_count_total[b] = 0.0;
@@ -522,6 +611,15 @@ int main(int argc, char* argv[]) {
     sim.setGoalConnections(number_connections);
     sim.setLambda(lambdas[lambda]);
     sim.setMu(mu);
+    sim.setBBPWeights(std::vector<double>(std::begin(mean_weight_bitrate), std::end(mean_weight_bitrate)));
+    if (stopping_rule) sim.setStoppingRule(WILSON_CI, 0.05);
+    if (common_random_numbers) sim.setCommonRandomNumbers(true);
+    if (defragmentation) sim.getController()->setDefragmentation(DEFRAGMENT_PERIODICALLY, 1 / mu);
+    if (fragmentation_statistics) sim.setFragmentationStatistics(true);
+    if (warmup_detection){
+      sim.setWarmupDetection();
+      sim.setWarmupCallback(warmupReset);
+    }
     sim.init();
 
     // Set controller accessible for unalloc function (required for buffer)
@@ -543,8 +641,9 @@ int main(int argc, char* argv[]) {
       output.open("./out/RSA-EuroCore-NBuffer-1e7.txt", std::ios::out | std::ios::app);
     }
 
-    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(), number_connections,
-                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time);
+    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(),
+                  (sim.targetReached() ? sim.getNumberOfConnections() : number_connections) - sim.getWarmupConnections(),
+                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time, sim);
 
     /*
     if (buffer_state) {
@@ -555,13 +654,15 @@ int main(int argc, char* argv[]) {
 
     // Reset global variables
       // Clear buffer and related variables
-    for (int be = 0; be < buffer.size(); be++) delete(buffer.elements[be].bitRate);
     buffer.clear();
     buffer.poped = 0;
     buffer.last_time = 0;
+    buffer.start_time = 0;
     buffer.mean_service_time = 0;
     buffer.mean_size_time = 0;
     buffer.mean_attempts = 0;
+    buffer.batch_service_time.reset();
+    buffer.batch_size_time.reset();
       // Reset global variables for BBP calculation
     for (int b = 0; b < 5; b++){
       bitrate_count_total[b] = 0.0;
@@ -599,6 +700,15 @@ int main(int argc, char* argv[]) {
     sim.setGoalConnections(number_connections);
     sim.setLambda(lambdas[lambda]);
     sim.setMu(mu);
+    sim.setBBPWeights(std::vector<double>(std::begin(mean_weight_bitrate), std::end(mean_weight_bitrate)));
+    if (stopping_rule) sim.setStoppingRule(WILSON_CI, 0.05);
+    if (common_random_numbers) sim.setCommonRandomNumbers(true);
+    if (defragmentation) sim.getController()->setDefragmentation(DEFRAGMENT_PERIODICALLY, 1 / mu);
+    if (fragmentation_statistics) sim.setFragmentationStatistics(true);
+    if (warmup_detection){
+      sim.setWarmupDetection();
+      sim.setWarmupCallback(warmupReset);
+    }
     sim.init();
 
     // Set controller accessible for unalloc function (required for buffer)
@@ -617,8 +727,9 @@ int main(int argc, char* argv[]) {
     std::fstream output;
     output.open("./out/RSA-ARPANet-NBuffer-1e7.txt", std::ios::out | std::ios::app);
 
-    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(), number_connections,
-                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time);
+    resultsToFile(buffer_state, output, BBP_results, sim.getBlockingProbability(),
+                  (sim.targetReached() ? sim.getNumberOfConnections() : number_connections) - sim.getWarmupConnections(),
+                  lambda, lambdas[lambda], bitrate_count_blocked, buffer, last_time, sim);
 
     if (buffer_state) {
       realloc_time.close();
@@ -627,13 +738,15 @@ int main(int argc, char* argv[]) {
 
     // Reset global variables
       // Clear buffer and related variables
-    for (int be = 0; be < buffer.size(); be++) delete(buffer.elements[be].bitRate);
     buffer.clear();
     buffer.poped = 0;
     buffer.last_time = 0;
+    buffer.start_time = 0;
     buffer.mean_service_time = 0;
     buffer.mean_size_time = 0;
     buffer.mean_attempts = 0;
+    buffer.batch_service_time.reset();
+    buffer.batch_size_time.reset();
       // Reset global variables for BBP calculation
     for (int b = 0; b < 5; b++){
       bitrate_count_total[b] = 0.0;
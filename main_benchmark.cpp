@@ -0,0 +1,208 @@
+#include "./src/simulator.hpp"
+/*********************************************************************************
+ * Benchmark matrix of the allocator library (SpectrumAllocator). Every
+ * combination of spectrum, route and modulation policy is simulated on the
+ * same loads, with common random numbers so every allocator serves exactly
+ * the same requests. For each one it reports the blocking probability, the
+ * bandwidth blocking probability and the wall time of the simulation, which
+ * is mostly the time spent allocating.
+ *
+ * An allocator can be given by name as the first argument (for example
+ * "BestFit/LeastLoaded/MostEfficient") to run only that row of the matrix.
+ *
+ * Without arguments it also benchmarks SDMAllocator on the 7-core and
+ * 19-core variants of NSFNet, with and without a crosstalk threshold, at
+ * loads scaled by the number of cores, and compares the sequential and the
+ * parallel events engines on a generated 500-node grid.
+ *
+ * Unlike main_RSA and main_RMSA, it doesn't define NETWORK_TYPE as EON,
+ * since the same build also simulates SDM networks.
+ **********************************************************************************/
+
+// Writes a rows x cols grid topology, every neighbour joined by a link in
+// each direction
+void writeGridNetwork(std::string filename, int rows, int cols, int length, int slots) {
+  std::ofstream file(filename);
+  file << "{\"alias\":\"Grid" << rows * cols << "\",\"name\":\"Grid " << rows << "x" << cols
+       << "\",\"nodes\":[";
+  for (int n = 0; n < rows * cols; n++) file << (n == 0 ? "" : ",") << "{\"id\":" << n << "}";
+  file << "],\"links\":[";
+  int id = 0;
+  for (int r = 0; r < rows; r++) {
+    for (int c = 0; c < cols; c++) {
+      int node = r * cols + c;
+      int neighbours[2] = {c + 1 < cols ? node + 1 : -1, r + 1 < rows ? node + cols : -1};
+      for (int neighbour : neighbours) {
+        if (neighbour < 0) continue;
+        int ends[2][2] = {{node, neighbour}, {neighbour, node}};
+        for (auto &end : ends) {
+          file << (id == 0 ? "" : ",") << "{\"id\":" << id << ",\"src\":" << end[0]
+               << ",\"dst\":" << end[1] << ",\"length\":" << length << ",\"slots\":" << slots << "}";
+          id++;
+        }
+      }
+    }
+  }
+  file << "]}";
+}
+
+int main(int argc, char* argv[]) {
+
+  // Sim parameters
+  double lambdas[4] = {250, 500, 750, 1000};
+  double mu = 1;
+  int number_connections = 1e6;
+
+  // Allocators of the matrix: every spectrum, route and modulation policy
+  std::vector<std::string> allocators;
+  if (argc > 1) {
+    allocators.push_back(std::string(argv[1]));
+  } else {
+    std::vector<std::string> spectrum = SpectrumAllocator::getSpectrumPolicies();
+    std::vector<std::string> routes = SpectrumAllocator::getRoutePolicies();
+    std::vector<std::string> modulations = SpectrumAllocator::getModulationPolicies();
+    for (unsigned int s = 0; s < spectrum.size(); s++)
+      for (unsigned int r = 0; r < routes.size(); r++)
+        for (unsigned int m = 0; m < modulations.size(); m++)
+          allocators.push_back(spectrum[s] + "/" + routes[r] + "/" + modulations[m]);
+  }
+
+  std::fstream output;
+  output.open("./out/Benchmark-NSFNet.txt", std::ios::out | std::ios::app);
+  output << "allocator\tlambda\tBP\tBBP\ttime(ms)\n";
+  std::cout << std::left << std::setw(52) << "allocator" << std::setw(10) << "lambda"
+            << std::setw(14) << "BP" << std::setw(14) << "BBP" << "time(ms)\n";
+
+  // ############################## NSFNET #################################
+  for (unsigned int a = 0; a < allocators.size(); a++) {
+    for (unsigned int lambda = 0; lambda < sizeof(lambdas)/sizeof(double); lambda++) {
+
+      // Simulator object
+      Simulator sim(std::string("./networks/NSFNet.json"),                      // Network nodes and links
+                    std::string("./networks/NSFNet_routes.json"),               // Network Routes
+                    std::string("./networks/bitrates.json"));                   // BitRates and bands (eg. BPSK/C)
+
+      // Assign alloc function by name
+      sim.setAllocator(new SpectrumAllocator(allocators[a]));
+
+      // Assign parameters
+      sim.setGoalConnections(number_connections);
+      sim.setLambda(lambdas[lambda]);
+      sim.setMu(mu);
+      sim.setCommonRandomNumbers(true);
+      sim.setVerbose(false);
+      sim.init();
+
+      // Begin simulation
+      auto start = std::chrono::high_resolution_clock::now();
+      sim.run();
+      long long time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::high_resolution_clock::now() - start).count();
+
+      // Output results
+      std::cout << std::left << std::setw(52) << allocators[a] << std::setw(10) << lambdas[lambda]
+                << std::setw(14) << sim.getBlockingProbability()
+                << std::setw(14) << sim.getBandwidthBlockingProbability() << time << "\n";
+      output << allocators[a] << "\t" << lambdas[lambda] << "\t" << sim.getBlockingProbability()
+             << "\t" << sim.getBandwidthBlockingProbability() << "\t" << time << "\n";
+    }
+  }
+
+  // ############################## NSFNET SDM ##############################
+  std::string sdm_networks[2] = {"./networks/NSFNet_7core.json", "./networks/NSFNet_19core.json"};
+  int sdm_cores[2] = {7, 19};
+  spatialPolicy sdm_policies[2] = {SPATIAL_CONTINUITY, CORE_SWITCHING};
+  int crosstalk_thresholds[2] = {-1, 2};
+  for (int n = 0; n < 2 && argc == 1; n++) {
+    for (int p = 0; p < 2; p++) {
+      for (int x = 0; x < 2; x++) {
+        for (unsigned int lambda = 0; lambda < sizeof(lambdas)/sizeof(double); lambda++) {
+
+          // Simulator object
+          Simulator sim(sdm_networks[n],                                      // Network nodes, links and cores
+                        std::string("./networks/NSFNet_routes.json"),         // Network Routes
+                        std::string("./networks/bitrates.json"),              // BitRates and bands (eg. BPSK/C)
+                        SDM);
+
+          // Assign alloc function
+          SDMAllocator *allocator = new SDMAllocator(sdm_policies[p]);
+          allocator->setCrosstalkThreshold(crosstalk_thresholds[x]);
+          sim.setAllocator(allocator);
+          std::string name = std::to_string(sdm_cores[n]) + "-core " + allocator->getName() +
+                             (crosstalk_thresholds[x] < 0 ? "" : " XT<=" + std::to_string(crosstalk_thresholds[x]));
+
+          // Assign parameters
+          sim.setGoalConnections(number_connections);
+          sim.setLambda(lambdas[lambda] * sdm_cores[n]);
+          sim.setMu(mu);
+          sim.setCommonRandomNumbers(true);
+          sim.setVerbose(false);
+          sim.init();
+
+          // Begin simulation
+          auto start = std::chrono::high_resolution_clock::now();
+          sim.run();
+          long long time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::high_resolution_clock::now() - start).count();
+
+          // Output results
+          std::cout << std::left << std::setw(52) << name << std::setw(10) << lambdas[lambda] * sdm_cores[n]
+                    << std::setw(14) << sim.getBlockingProbability()
+                    << std::setw(14) << sim.getBandwidthBlockingProbability() << time << "\n";
+          output << name << "\t" << lambdas[lambda] * sdm_cores[n] << "\t" << sim.getBlockingProbability()
+                 << "\t" << sim.getBandwidthBlockingProbability() << "\t" << time << "\n";
+        }
+      }
+    }
+  }
+
+  // ########################### GRID 500 PARALLEL ##########################
+  // The k shortest paths of the 250k pairs take a while, so they are cached
+  if (argc == 1) {
+    writeGridNetwork("./out/Grid500.json", 20, 25, 100, 320);
+    double grid_lambda = 2000;
+    long long times[2];
+    double blocking[2];
+    for (int parallel = 0; parallel < 2; parallel++) {
+
+      // Simulator object
+      Simulator sim(std::string("./out/Grid500.json"),                         // Generated grid
+                    2,                                                        // Routes per pair
+                    std::string("./networks/bitrates.json"),                  // BitRates and bands (eg. BPSK/C)
+                    EON, LENGTH, std::string("./out/Grid500_k2.paths"));
+
+      // Assign alloc function by name
+      sim.setAllocator(new SpectrumAllocator("FirstFit/GivenOrder/MostEfficient"));
+
+      // Assign parameters
+      sim.setGoalConnections(number_connections);
+      sim.setLambda(grid_lambda);
+      sim.setMu(mu);
+      sim.setCommonRandomNumbers(true);
+      sim.setVerbose(false);
+      if (parallel) sim.setParallelEvents();
+      sim.init();
+
+      // Begin simulation
+      auto start = std::chrono::high_resolution_clock::now();
+      sim.run();
+      times[parallel] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::high_resolution_clock::now() - start).count();
+      blocking[parallel] = sim.getBlockingProbability();
+
+      // Output results
+      std::string name = std::string("Grid500 FirstFit ") + (parallel ? "parallel" : "sequential");
+      std::cout << std::left << std::setw(52) << name << std::setw(10) << grid_lambda
+                << std::setw(14) << sim.getBlockingProbability()
+                << std::setw(14) << sim.getBandwidthBlockingProbability() << times[parallel] << "\n";
+      output << name << "\t" << grid_lambda << "\t" << sim.getBlockingProbability()
+             << "\t" << sim.getBandwidthBlockingProbability() << "\t" << times[parallel] << "\n";
+    }
+    // Both engines serve the same requests, so only the time may differ
+    std::cout << "Grid500 speedup: " << (double)times[0] / std::max(times[1], 1LL)
+              << (blocking[0] == blocking[1] ? "" : " (the blocking differs!)") << "\n";
+  }
+  output.close();
+
+  return 0;
+}
@@ -6,6 +6,19 @@
 // Bitrate map
 std::map<float, int> bitRates_map { { 10.0 , 0 }, { 40.0 , 1 }, { 100.0 , 2 }, { 400.0 , 3 }, {1000.0, 4} };
 
+// Bit rates of the buffered elements: a single copy of every bit rate, shared
+// by its elements, instead of a new BitRate for each blocked connection. A
+// deque doesn't move its elements when it grows, so the pointers stay valid
+std::deque<BitRate> buffered_bitRates;
+
+BitRate *bufferedBitRate(BitRate *bitRate){
+  for (unsigned int b = 0; b < buffered_bitRates.size(); b++){
+    if (buffered_bitRates[b].getBitRate() == bitRate->getBitRate()) return &buffered_bitRates[b];
+  }
+  buffered_bitRates.push_back(*bitRate);
+  return &buffered_bitRates.back();
+}
+
 // Buffer element class
 class buffer_element {
 
@@ -14,7 +27,7 @@ class buffer_element {
     buffer_element(int src, int dst, long long id, BitRate *bitRate, double time_arrival){
       this->src = src;
       this->dst = dst;
-      this->bitRate = new BitRate(*bitRate);
+      this->bitRate = bufferedBitRate(bitRate);
       this->id = id;
       this->time_arrival = time_arrival;
       this->current_attempts = 1;
@@ -23,7 +36,7 @@ class buffer_element {
     buffer_element(int src, int dst, long long id, BitRate *bitRate, double time_arrival, int attempts){
       this->src = src;
       this->dst = dst;
-      this->bitRate = new BitRate(*bitRate);
+      this->bitRate = bufferedBitRate(bitRate);
       this->id = id;
       this->time_arrival = time_arrival;
       this->current_attempts = attempts;
@@ -58,6 +71,7 @@ class Buffer {
     Buffer(){
       this->elements = std::deque<buffer_element>();
       this->last_time = 0;
+      this->start_time = 0;
       this->poped = 0;
       this->pushed = 0;
       this->mean_size_time = 0;
@@ -90,10 +104,17 @@ class Buffer {
 
     std::deque<buffer_element> elements;
     double last_time;
+    // Time since which mean_size_time is accumulated (the end of the warm-up)
+    double start_time;
     double mean_size_time;
     double mean_service_time;
     double mean_attempts;
 
+    // Batch means of the service (waiting) time of every allocated element and
+    // of the buffer size, weighted by the time it lasted
+    BatchMeans batch_service_time;
+    BatchMeans batch_size_time;
+
     // Number of connections popped from buffer (allocated succesfully)
     int poped;
     int pushed;
@@ -152,9 +173,15 @@ double bandwidthBlockingProbabilityWBuffer(double bitrate_count_total[5],
 
 // Result to TXT
 void resultsToFile(bool buffer_state, std::fstream &output, double BBP, double BP, int number_connections,
-                   int lambda_index, double earlang, double bitrate_count_blocked[5], Buffer buffer, double last_time)
+                   int lambda_index, double earlang, double bitrate_count_blocked[5], Buffer buffer, double last_time,
+                   Simulator &sim)
 {
 
+    // Confidence half-widths (batch means)
+    double confidence = sim.getConfidence();
+    double BBP_CI = sim.getBBPBatchMeans().halfWidth(confidence);
+    double BP_CI = sim.getBPBatchMeans().halfWidth(confidence);
+
     // avgService only poped connections
     double avgService = buffer.mean_service_time/buffer.poped;
 
@@ -166,7 +193,7 @@ void resultsToFile(bool buffer_state, std::fstream &output, double BBP, double B
 
     double avgServiceAll = buffer.mean_service_time/buffer.poped;
     double avgAttempts = buffer.mean_attempts/buffer.poped;
-    double avgSize = buffer.mean_size_time/buffer.last_time;
+    double avgSize = buffer.mean_size_time/(buffer.last_time - buffer.start_time);
 
     switch (buffer_state){
         case false:
@@ -174,8 +201,14 @@ void resultsToFile(bool buffer_state, std::fstream &output, double BBP, double B
             output << "N/Buffer earlang index: " << lambda_index
                     << ", earlang: " << earlang
                     << ", general blocking: " << BP
+                    << ", general blocking CI: " << BP_CI
                     << ", BBP: " << BBP                    
-                    << '\n';
+                    << ", BBP CI: " << BBP_CI;
+            for (unsigned int b = 0; b < sim.getBitRates().size(); b++){
+              BatchMeans bitrate_blocking = sim.getBitRateBatchMeans(b);
+              output << ", BP " << sim.getBitRates()[b].getBitRate() << ": " << bitrate_blocking.getMean()
+                     << " +- " << bitrate_blocking.halfWidth(confidence);
+            }
             break;
         case true:
             if (buffer.size() == 0) std::cout << "\nNo elements in buffer! :P\n";
@@ -189,9 +222,26 @@ void resultsToFile(bool buffer_state, std::fstream &output, double BBP, double B
                     << ", reallocated: " << buffer.poped 
                     << ", Average try per allocated element: " << avgAttempts
                     << ", Average service time: " << avgService
+                    << ", Average service time CI: " << buffer.batch_service_time.halfWidth(confidence)
                     << ", Average service time (ALL): " << avgServiceAll
                     << ", Average buffer size: " << avgSize
-                    << '\n';
+                    << ", Average buffer size CI: " << buffer.batch_size_time.halfWidth(confidence);
             break;
         }
+
+    // Time-weighted averages of the fragmentation of the spectrum, if sampled
+    if (sim.getFragmentationStatistics()){
+        output << ", mean external fragmentation: " << sim.getMeanExternalFragmentation()
+               << ", mean spectrum entropy: " << sim.getMeanSpectrumEntropy()
+               << ", mean free blocks: " << sim.getMeanFreeBlocks();
+    }
+
+    // Defragmentation of the spectrum, if enabled
+    Controller *controller = sim.getController();
+    if (controller->getDefragmentationTrigger() != NO_DEFRAGMENTATION){
+        output << ", defragmentations: " << controller->getDefragmentations()
+               << ", moved connections: " << controller->getMovedConnections()
+               << ", defragmentation CPU time: " << controller->getDefragmentationTime();
+    }
+    output << '\n';
 }
\ No newline at end of file
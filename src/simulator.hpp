@@ -1,7 +1,195 @@
+#ifndef __PHILOX_ENGINE_H__
+#define __PHILOX_ENGINE_H__
+
+#define MT19937 1
+#define PHILOX 2
+
+#include <cstdint>
+/**
+ * @brief Class that generates random numbers with the Philox4x32-10 counter
+ * based generator.
+ *
+ * Unlike std::mt19937, the numbers of a counter based generator are a pure
+ * function of a key and a counter: the block of four 32 bit numbers at
+ * position n of a stream is obtained by encrypting n with the key. That makes
+ * it possible to:
+ * -Split independent streams cheaply, by putting a stream identifier (for
+ * example a replication, variable and thread) in the high half of the
+ * counter.
+ * -Skip ahead any amount of numbers in O(1) time (discard and seek methods).
+ * -Checkpoint the whole state of a stream with three integers: the seed, the
+ * stream and the position.
+ *
+ * The class fulfills the UniformRandomBitGenerator requirements, so it can be
+ * used with the distributions of the standard library.
+ */
+class PhiloxEngine {
+ public:
+  typedef uint32_t result_type;
+  /**
+   * @brief Constructs a new PhiloxEngine object with seed 0 on stream 0.
+   *
+   */
+  PhiloxEngine(void);
+  /**
+   * @brief Constructs a new PhiloxEngine object on the given stream.
+   *
+   * @param seed the key of the generator.
+   * @param stream the identifier of the stream. Different streams of the same
+   * seed are independent.
+   */
+  PhiloxEngine(uint64_t seed, uint64_t stream = 0);
+  /**
+   * @brief Generates the next random number of the stream.
+   *
+   * @return result_type a random number between min() and max().
+   */
+  result_type operator()(void);
+  /**
+   * @brief Advances the stream by n numbers in constant time.
+   *
+   * @param n the amount of numbers to skip.
+   */
+  void discard(uint64_t n);
+  /**
+   * @brief Moves the stream to an absolute position in constant time. The
+   * next number generated will be the one at that position.
+   *
+   * @param position the position (amount of numbers generated since the
+   * beginning of the stream).
+   */
+  void seek(uint64_t position);
+  /**
+   * @brief Get the position of the stream, that is, the amount of numbers
+   * generated since the beginning of the stream. Along with the seed and the
+   * stream identifier, it's all that is needed to restore the generator.
+   *
+   * @return uint64_t the position of the stream.
+   */
+  uint64_t getPosition(void) const;
+  /**
+   * @brief Get the seed (key) of the generator.
+   *
+   * @return uint64_t the seed of the generator.
+   */
+  uint64_t getSeed(void) const;
+  /**
+   * @brief Get the identifier of the stream.
+   *
+   * @return uint64_t the identifier of the stream.
+   */
+  uint64_t getStream(void) const;
+  /**
+   * @brief Builds a stream identifier from a replication, a variable and a
+   * thread index, so every combination gets its own independent stream.
+   *
+   * @param replication the replication index (32 bits).
+   * @param variable the random variable index (16 bits).
+   * @param thread the thread index (16 bits).
+   * @return uint64_t the stream identifier.
+   */
+  static uint64_t streamId(uint32_t replication, uint16_t variable,
+                           uint16_t thread = 0);
+  /**
+   * @brief Computes the block of four random numbers of the given counter
+   * and key. This is the stateless core of the generator.
+   *
+   * @param counter the four 32 bit words of the counter. The result is
+   * written in place.
+   * @param key the two 32 bit words of the key.
+   */
+  static void block(uint32_t counter[4], const uint32_t key[2]);
+
+  static constexpr result_type min(void) { return 0; }
+  static constexpr result_type max(void) { return UINT32_MAX; }
+
+ private:
+  uint64_t seed;
+  uint64_t stream;
+  uint64_t position;
+  uint32_t buffer[4];
+};
+
+#endif
+// #include "philox_engine.hpp"
+
+PhiloxEngine::PhiloxEngine(void) {
+  this->seed = 0;
+  this->stream = 0;
+  this->seek(0);
+}
+
+PhiloxEngine::PhiloxEngine(uint64_t seed, uint64_t stream) {
+  this->seed = seed;
+  this->stream = stream;
+  this->seek(0);
+}
+
+void PhiloxEngine::block(uint32_t counter[4], const uint32_t key[2]) {
+  uint32_t k0 = key[0];
+  uint32_t k1 = key[1];
+  for (int round = 0; round < 10; round++) {
+    uint64_t product0 = static_cast<uint64_t>(0xD2511F53) * counter[0];
+    uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57) * counter[2];
+    uint32_t c0 = static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ k0;
+    uint32_t c2 = static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ k1;
+    counter[0] = c0;
+    counter[1] = static_cast<uint32_t>(product1);
+    counter[2] = c2;
+    counter[3] = static_cast<uint32_t>(product0);
+    k0 += 0x9E3779B9;
+    k1 += 0xBB67AE85;
+  }
+}
+
+PhiloxEngine::result_type PhiloxEngine::operator()(void) {
+  unsigned int index = this->position & 3;
+  if (index == 0) {
+    uint64_t blockIndex = this->position >> 2;
+    uint32_t key[2] = {static_cast<uint32_t>(this->seed),
+                       static_cast<uint32_t>(this->seed >> 32)};
+    this->buffer[0] = static_cast<uint32_t>(blockIndex);
+    this->buffer[1] = static_cast<uint32_t>(blockIndex >> 32);
+    this->buffer[2] = static_cast<uint32_t>(this->stream);
+    this->buffer[3] = static_cast<uint32_t>(this->stream >> 32);
+    PhiloxEngine::block(this->buffer, key);
+  }
+  this->position++;
+  return this->buffer[index];
+}
+
+void PhiloxEngine::discard(uint64_t n) { this->seek(this->position + n); }
+
+void PhiloxEngine::seek(uint64_t position) {
+  // Blocks are generated lazily, so only the first block after a
+  // position in the middle of a block has to be computed here
+  this->position = position & ~static_cast<uint64_t>(3);
+  unsigned int skip = position & 3;
+  if (skip != 0) {
+    this->operator()();
+    this->position = position;
+  }
+}
+
+uint64_t PhiloxEngine::getPosition(void) const { return this->position; }
+
+uint64_t PhiloxEngine::getSeed(void) const { return this->seed; }
+
+uint64_t PhiloxEngine::getStream(void) const { return this->stream; }
+
+uint64_t PhiloxEngine::streamId(uint32_t replication, uint16_t variable,
+                                uint16_t thread) {
+  return (static_cast<uint64_t>(replication) << 32) |
+         (static_cast<uint64_t>(variable) << 16) | thread;
+}
 #ifndef __RANDOM_VARIABLE_H__
 #define __RANDOM_VARIABLE_H__
 
 #include <random>
+#include <stdexcept>
+#include <vector>
+
+// #include "philox_engine.hpp"
 /**
  * @brief Class that generates random numbers.
  *
@@ -9,6 +197,10 @@
  * or personalized parameters. It's inherited by the UniformVariable and
  * ExpVariable classes.
  *
+ * The numbers are generated by a std::mt19937 engine (MT19937) by default, or
+ * by a counter based PhiloxEngine (PHILOX) when the variable is constructed
+ * from one.
+ *
  */
 class RandomVariable {
  public:
@@ -26,6 +218,15 @@ class RandomVariable {
    * @param parameter1 the parameter value.
    */
   RandomVariable(unsigned int seed, double parameter1);
+  /**
+   * @brief Constructs a new Random Variable object that uses a counter based
+   * generator instead of std::mt19937.
+   *
+   * @param generator the PhiloxEngine, already placed on its stream, used as
+   * the source of randomness.
+   * @param parameter1 the parameter value.
+   */
+  RandomVariable(PhiloxEngine generator, double parameter1);
   /**
    * @brief Virtual method to obtain the next value on the random variable
    * object. It must be implemented by an inherited class.
@@ -34,8 +235,124 @@ class RandomVariable {
    * random value.
    */
   virtual double getNextValue(void) = 0;
+  /**
+   * @brief Get the engine used by the random variable.
+   *
+   * @return int MT19937 or PHILOX.
+   */
+  int getEngine(void) const;
+  /**
+   * @brief Get the counter based generator of the random variable. Its seed,
+   * stream and position are enough to checkpoint and restore the variable.
+   *
+   * @return PhiloxEngine the generator. It's only meaningful if the engine is
+   * PHILOX.
+   */
+  PhiloxEngine getPhilox(void) const;
+  /**
+   * @brief Set the size of the buffer of pre-generated values. With a size
+   * greater than 0 the values are generated in blocks of that size by
+   * fillBatch, which amortizes the cost of the engine and lets the compiler
+   * vectorize the transformations. With 0 (default) every value is generated
+   * when it's requested, exactly as in previous versions.
+   *
+   * Batched variables draw the same engine differently, so the sequence of
+   * values is not the same as the one of an unbatched variable.
+   *
+   * @param batchSize the amount of values generated on each block.
+   */
+  void setBatchSize(int batchSize);
+  /**
+   * @brief Get the size of the buffer of pre-generated values.
+   *
+   * @return int the batch size, 0 if the values are not batched.
+   */
+  int getBatchSize(void) const;
+  /**
+   * @brief Makes the variable antithetic: every uniform number U drawn from
+   * the engine is replaced by 1 - U (and the random bits by their
+   * complement). Two variables with the same engine, one of them
+   * antithetic, generate negatively correlated values, which reduces the
+   * variance of the average of both.
+   *
+   * @param antithetic Param type bool.
+   */
+  void setAntithetic(bool antithetic);
+  /**
+   * @brief Tells if the variable is antithetic.
+   *
+   * @return true if the uniform numbers are replaced by 1 - U.
+   */
+  bool getAntithetic(void) const;
 
  protected:
+  /**
+   * @brief Draws a number uniformly distributed in [0, 1] from the engine of
+   * the variable.
+   *
+   * @return double the uniform number.
+   */
+  double nextUniform(void);
+  /**
+   * @brief Draws 32 random bits from the engine of the variable.
+   *
+   * @return uint32_t the random bits.
+   */
+  uint32_t nextBits(void);
+  /**
+   * @brief Draws the uniform number of the given index of the stream, in
+   * (0, 1) with 53 bits of precision. The index n always maps to the numbers
+   * 2n and 2n + 1 of the stream, no matter which indexes were drawn before,
+   * so each index works as an independent substream. Only available with
+   * the PHILOX engine.
+   *
+   * @param index the index of the number.
+   * @return double the uniform number.
+   */
+  double uniformAt(uint64_t index);
+  /**
+   * @brief Returns the next pre-generated value, refilling the buffer when
+   * it's exhausted. Must only be called when the batch size is positive.
+   *
+   * @return double the next value of the buffer.
+   */
+  double nextBatchValue(void);
+  /**
+   * @brief Fills the whole buffer with new values. It must be implemented by
+   * an inherited class.
+   *
+   */
+  virtual void fillBatch(void) = 0;
+  /**
+   * @brief The buffer of pre-generated values.
+   *
+   */
+  std::vector<double> batch;
+  /**
+   * @brief The amount of values of the buffer, 0 if values aren't batched.
+   *
+   */
+  int batchSize;
+  /**
+   * @brief The position of the next value to be returned from the buffer.
+   *
+   */
+  int batchPosition;
+  /**
+   * @brief If true, the uniform numbers U are replaced by 1 - U.
+   *
+   */
+  bool antithetic;
+  /**
+   * @brief The engine used to generate the numbers, MT19937 or PHILOX.
+   *
+   */
+  int engine;
+  /**
+   * @brief The counter based generator, used when the engine is PHILOX.
+   *
+   */
+  PhiloxEngine philox;
   /**
    * @brief A random number engine that generates a pseudo-random number from a
    * seed.
@@ -59,6 +376,10 @@ class RandomVariable {
 // #include "random_variable.hpp"
 
 RandomVariable::RandomVariable() {
+  this->engine = MT19937;
+  this->antithetic = false;
+  this->batchSize = 0;
+  this->batchPosition = 0;
   this->generator = std::mt19937(1234567);
   this->parameter1 = 10;
   this->dist =
@@ -66,12 +387,84 @@ RandomVariable::RandomVariable() {
 }
 
 RandomVariable::RandomVariable(unsigned int seed, double parameter1) {
+  this->engine = MT19937;
+  this->antithetic = false;
+  this->batchSize = 0;
+  this->batchPosition = 0;
   this->generator = std::mt19937(seed);
   this->parameter1 = parameter1;
   this->dist =
       std::uniform_real_distribution<double>(0, std::nextafter(1.0, 1.1));
 }
 
+RandomVariable::RandomVariable(PhiloxEngine generator, double parameter1) {
+  this->engine = PHILOX;
+  this->antithetic = false;
+  this->batchSize = 0;
+  this->batchPosition = 0;
+  this->philox = generator;
+  this->parameter1 = parameter1;
+  this->dist =
+      std::uniform_real_distribution<double>(0, std::nextafter(1.0, 1.1));
+}
+
+int RandomVariable::getEngine(void) const { return this->engine; }
+
+PhiloxEngine RandomVariable::getPhilox(void) const { return this->philox; }
+
+double RandomVariable::nextUniform(void) {
+  double u = this->engine == PHILOX ? this->dist(this->philox)
+                                    : this->dist(this->generator);
+  return this->antithetic ? 1 - u : u;
+}
+
+uint32_t RandomVariable::nextBits(void) {
+  uint32_t bits = this->engine == PHILOX
+                      ? this->philox()
+                      : static_cast<uint32_t>(this->generator());
+  return this->antithetic ? ~bits : bits;
+}
+
+double RandomVariable::uniformAt(uint64_t index) {
+  if (this->engine != PHILOX) {
+    throw std::runtime_error(
+        "Indexed values are only available with the PHILOX engine.");
+  }
+  this->philox.seek(2 * index);
+  uint64_t high = this->philox() >> 5;
+  uint64_t low = this->philox() >> 6;
+  double u = (high * 67108864.0 + low + 0.5) / 9007199254740992.0;
+  return this->antithetic ? 1 - u : u;
+}
+
+void RandomVariable::setAntithetic(bool antithetic) {
+  this->antithetic = antithetic;
+  // Values already generated are discarded
+  this->batchPosition = this->batchSize;
+}
+
+bool RandomVariable::getAntithetic(void) const { return this->antithetic; }
+
+void RandomVariable::setBatchSize(int batchSize) {
+  if (batchSize < 0) {
+    throw std::runtime_error("Batch size must be non negative.");
+  }
+  this->batchSize = batchSize;
+  this->batch.assign(batchSize, 0.0);
+  // Forces a refill on the next request
+  this->batchPosition = batchSize;
+}
+
+int RandomVariable::getBatchSize(void) const { return this->batchSize; }
+
+double RandomVariable::nextBatchValue(void) {
+  if (this->batchPosition == this->batchSize) {
+    this->fillBatch();
+    this->batchPosition = 0;
+  }
+  return this->batch[this->batchPosition++];
+}
+
 #ifndef __NODE_H__
 #define __NODE_H__
 
@@ -197,149 +590,592 @@ int Node::getId(void) const { return this->id; }
 void Node::setLabel(std::string label) { this->label = label; }
 
 std::string Node::getLabel(void) const { return this->label; }
-#ifndef __LINK_H__
-#define __LINK_H__
-
-#define DEFAULT_SLOTS 320
-#define DEFAULT_LENGTH 100.0
-#define DEFAULT_CORES 1
-#define DEFAULT_MODES 1
+#ifndef __SPECTRUM_INDEX_H__
+#define __SPECTRUM_INDEX_H__
 
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 /**
- * @brief Class type Link, this class allows you to create and manipulate the
- link objects. A link
- * within the simulator is the union between two nodes. The connection between
- * two nodes is unidirectional.
-
- * Each link has a number of cores, where each core has an associated number 
- * of modes, and at the same time, each mode has a number of slots, these
- * atributes are arranged in a three-dimensional vector. In case of simulating
- * single-core and single-mode network, the modes and cores can be omitted
+ * @brief Class that indexes the free intervals (gaps) of a slots vector.
+ *
+ * The gaps are kept in three ordered structures, so every query and update
+ * costs O(log S), S being the number of slots:
+ * -A map from the first slot of each gap to its length, to find the gap
+ * that contains a slot and the gaps next to a released interval.
+ * -A set of (length, first slot) pairs, to find the smallest gap of at
+ * least k slots (best fit) or a gap of exactly k slots (exact fit).
+ * -A max segment tree over the first slots of the gaps, to find the first
+ * gap of at least k slots (first fit).
+ *
+ * Allocating slots splits the gap that holds them, and releasing slots
+ * merges them with the gaps next to them.
+ *
+ * The free intervals common to several indexes (for example, the links of a
+ * route) are obtained with intersect, and the static versions of firstFit,
+ * bestFit and exactFit work on that list.
  */
-
-class Link {
-  friend class Network;
-
+class SpectrumIndex {
  public:
   /**
-   * @brief Constructs a Link object. When calling with no parameters the
-   * default link "id" is -1, the default link "length" is 100.0, the default
-   * "number_of_cores" is 1, the default "number_of_modes" is 1 and the default
-   * "slots" are 320.
+   * @brief Constructs a new SpectrumIndex object without slots.
    *
    */
-  Link(void);
+  SpectrumIndex(void);
   /**
-   * @brief Constructs a Link object. The parameter is assigned to the id
-   * attribute of the node, while the link length is set to 100.0, both number
-   * of cores and modes are set to 1, and the slots to 320 by default
-   * 
+   * @brief Constructs a new SpectrumIndex object where every slot is free.
    *
-   * @param id Identifier of the object. Type int. It serves to differentiate
-   * the created object from the others.
+   * @param slots the number of slots.
    */
-  Link(int id);
+  SpectrumIndex(int slots);
   /**
-   * @brief Constructs a Link object. The parameters are assigned to the "id"
-   * and length attributes of the node, while both number of cores and modes are
-   * set to 1 and the slots are set to 320.
+   * @brief Constructs a new SpectrumIndex object from the state of a slots
+   * vector.
    *
-   * @param id Identifier of the object. Type int. It serves to differentiate
-   * the created object from the others.
-   * @param length The length of this new Link object. Type float. The length
-   * indicates the distance between two nodes. The unit of measure for length is
-   * kilometers.
+   * @param state the state of every slot, true if it's used.
    */
-  Link(int id, float length);  
+  SpectrumIndex(const std::vector<bool> &state);
   /**
-   * @brief Construct a Link object. The parameters are assigned to the id,
-   * length and slots attributes, while both number of cores and modes are set
-   * to 1 assuming a single-mode/single-core network.
+   * @brief Marks an interval of free slots as used. The interval must be
+   * inside a single gap.
    *
-   * @param id Identifier of the object. Type int. It serves to differentiate
-   * the created object from the others.
-   * @param length The length of this new Link object. Type int. The length
-   * indicates the distance between two nodes. The unit of measure for length is
-   * kilometers.
-   * @param slots The size of the slots vector of this Link object. Type int.
-   * The slot is the channel through which the information is transmitted.
+   * @param from the first slot of the interval.
+   * @param count the number of slots.
    */
-  Link(int id, float length, int slots);
+  void allocate(int from, int count);
   /**
-   * @brief Construct a Link object. The parameters are assigned to the id,
-   * length, slots and number_of_cores, while the number_of_modes is set to 1.
+   * @brief Marks an interval of used slots as free, merging it with the gaps
+   * next to it. Every slot of the interval must be used.
    *
-   * @param id Identifier of the object. Type int. It serves to differentiate
-   * the created object from the others.
-   * @param length The length of this new Link object. Type int. The length
-   * indicates the distance between two nodes. The unit of measure for length is
-   * kilometers.
-   * @param slots The size of the slots vector of this Link object. Type int.
-   * The slot is the channel through which the information is transmitted.
-   * @param number_of_cores The number of cores of this Link object. Type int.
-   * The number of cores determine the number of paths through which the information
-   * can be transmited within the same link.
+   * @param from the first slot of the interval.
+   * @param count the number of slots.
    */
-  Link(int id, float length, int slots, int number_of_cores);
+  void release(int from, int count);
   /**
-   * @brief Construct a Link object. The parameters are assigned to the id,
-   * length, number_of_cores, number_of_modes and slots attributes.
+   * @brief Finds the first gap of at least length slots.
    *
-   * @param id Identifier of the object. Type int. It serves to differentiate
-   * the created object from the others.
-   * @param length The length of this new Link object. Type int. The length
-   * indicates the distance between two nodes. The unit of measure for length is
-   * kilometers.
-   * @param slots The size of the slots vector of this Link object. Type int.
-   * The slot is the channel through which the information is transmitted.
-   * @param number_of_cores The number of cores of this Link object. Type int.
-   * The number of cores determine the number of paths through which the information
-   * can be transmited within the same link.
-   * @param number_of_modes The number of modes of this Link object. Type int.
-   * The number of modes determines how many modes each core belonging to this link
-   * can support.
+   * @param length the number of slots required.
+   * @return int the first slot of the gap, -1 if there is none.
    */
-  Link(int id, float length, int slots, int number_of_cores, int number_of_modes);
+  int firstFit(int length) const;
   /**
-   * @brief Destroys the Link object.
+   * @brief Finds the smallest gap of at least length slots. Ties are won by
+   * the first gap.
    *
+   * @param length the number of slots required.
+   * @return int the first slot of the gap, -1 if there is none.
    */
-  ~Link();
+  int bestFit(int length) const;
   /**
-   * @brief Set the Id of a link. This method only works on links that were
-   * created without a specified id. That is, objects created with the
-   * constructor Link(void).
+   * @brief Finds the first gap of exactly length slots.
    *
-   * @param id Identifier of the object. Type int. It serves to differentiate
-   * the created object from the others.
+   * @param length the number of slots required.
+   * @return int the first slot of the gap, -1 if there is none.
    */
-  void setId(int id);
+  int exactFit(int length) const;
   /**
-   * @brief Set the Length of the link. The value must be greater than or equal
-   * to zero.
+   * @brief Finds the gap that contains a slot.
    *
-   * @param length The length of this new Link object. Type int. The length
-   * indicates the distance between two nodes. The unit of measure for length is
-   * kilometers.
+   * @param slot the position of the slot.
+   * @return std::pair<int, int> the first slot and length of the gap, (-1, 0)
+   * if the slot is used.
    */
-  void setLength(float length);
+  std::pair<int, int> gapContaining(int slot) const;
   /**
-   * @brief Change the size of the Slots vector of the link. The value must
-   * be greater than or equal to 1 and every element on the previous vector must
-   * be set to false, which represents an inactive slot.
-   * 
-   * In case of a multi-core/multi-mode link, the size of every slot vector 
-   * within that link is changed.
+   * @brief Get the length of the largest gap.
    *
-   * @param slots The size of the slots vector of this Link object. Type int.
-   * The slot is the channel through which the information is transmitted.
+   * @return int the length of the largest gap, 0 if every slot is used.
    */
-  void setSlots(int slots);
-    /**
+  int getLargestGap(void) const;
+  /**
+   * @brief Get the number of gaps.
+   *
+   * @return int the number of gaps.
+   */
+  int getNumberOfGaps(void) const;
+  /**
+   * @brief Get the number of slots.
+   *
+   * @return int the number of slots.
+   */
+  int getSlots(void) const;
+  /**
+   * @brief Get the number of free slots, the sum of the lengths of the gaps.
+   *
+   * @return int the number of free slots.
+   */
+  int getFreeSlots(void) const;
+  /**
+   * @brief Get the gaps, ordered by their first slot.
+   *
+   * @return const std::map<int, int>& the length of every gap, by its first
+   * slot.
+   */
+  const std::map<int, int> &getGaps(void) const;
+  /**
+   * @brief Computes the intervals that are free on every index, walking the
+   * gaps of the first index and querying the others for the gaps that overlap
+   * them.
+   *
+   * @param indexes the indexes to intersect, with the same number of slots.
+   * @return std::vector<std::pair<int, int>> the first slot and length of
+   * every common free interval, ordered by their first slot.
+   */
+  static std::vector<std::pair<int, int>> intersect(
+      const std::vector<const SpectrumIndex *> &indexes);
+  /**
+   * @brief Finds the first interval of at least length slots on a list of
+   * intervals.
+   *
+   * @param gaps the intervals, ordered by their first slot.
+   * @param length the number of slots required.
+   * @return int the first slot of the interval, -1 if there is none.
+   */
+  static int firstFit(const std::vector<std::pair<int, int>> &gaps,
+                      int length);
+  /**
+   * @brief Finds the last interval of at least length slots on a list of
+   * intervals, and places the slots at its end.
+   *
+   * @param gaps the intervals, ordered by their first slot.
+   * @param length the number of slots required.
+   * @return int the first slot of the allocation, so it ends with the
+   * interval, -1 if there is none.
+   */
+  static int lastFit(const std::vector<std::pair<int, int>> &gaps,
+                     int length);
+  /**
+   * @brief Finds the smallest interval of at least length slots on a list of
+   * intervals. Ties are won by the first interval.
+   *
+   * @param gaps the intervals, ordered by their first slot.
+   * @param length the number of slots required.
+   * @return int the first slot of the interval, -1 if there is none.
+   */
+  static int bestFit(const std::vector<std::pair<int, int>> &gaps,
+                     int length);
+  /**
+   * @brief Finds the first interval of exactly length slots on a list of
+   * intervals.
+   *
+   * @param gaps the intervals, ordered by their first slot.
+   * @param length the number of slots required.
+   * @return int the first slot of the interval, -1 if there is none.
+   */
+  static int exactFit(const std::vector<std::pair<int, int>> &gaps,
+                      int length);
+
+ private:
+  int slots;
+  int leaves;
+  int freeSlots;
+  std::map<int, int> gaps;
+  std::set<std::pair<int, int>> sizes;
+  std::vector<int> tree;
+
+  void build(const std::vector<bool> &state);
+  void addGap(int start, int length);
+  void removeGap(int start, int length);
+  void setLeaf(int position, int value);
+};
+
+#endif
+// #include "spectrum_index.hpp"
+
+SpectrumIndex::SpectrumIndex(void) { this->build(std::vector<bool>()); }
+
+SpectrumIndex::SpectrumIndex(int slots) {
+  if (slots < 0) {
+    throw std::runtime_error("Cannot create a spectrum index with " +
+                             std::to_string(slots) + " slots.");
+  }
+  this->build(std::vector<bool>(slots, false));
+}
+
+SpectrumIndex::SpectrumIndex(const std::vector<bool> &state) {
+  this->build(state);
+}
+
+void SpectrumIndex::build(const std::vector<bool> &state) {
+  this->slots = state.size();
+  this->leaves = 1;
+  while (this->leaves < this->slots) this->leaves *= 2;
+  this->tree.assign(2 * this->leaves, 0);
+  this->freeSlots = 0;
+  this->gaps.clear();
+  this->sizes.clear();
+  int i = 0;
+  while (i < this->slots) {
+    if (state[i]) {
+      i++;
+      continue;
+    }
+    int start = i;
+    while (i < this->slots && !state[i]) i++;
+    this->addGap(start, i - start);
+  }
+}
+
+void SpectrumIndex::setLeaf(int position, int value) {
+  int node = this->leaves + position;
+  this->tree[node] = value;
+  for (node /= 2; node > 0; node /= 2) {
+    this->tree[node] = std::max(this->tree[2 * node], this->tree[2 * node + 1]);
+  }
+}
+
+void SpectrumIndex::addGap(int start, int length) {
+  this->gaps[start] = length;
+  this->freeSlots += length;
+  this->sizes.insert(std::make_pair(length, start));
+  this->setLeaf(start, length);
+}
+
+void SpectrumIndex::removeGap(int start, int length) {
+  this->gaps.erase(start);
+  this->freeSlots -= length;
+  this->sizes.erase(std::make_pair(length, start));
+  this->setLeaf(start, 0);
+}
+
+void SpectrumIndex::allocate(int from, int count) {
+  std::pair<int, int> gap = this->gapContaining(from);
+  if (count < 1 || gap.first == -1 ||
+      from + count > gap.first + gap.second) {
+    throw std::runtime_error(
+        "Cannot allocate slots that are not inside a single gap.");
+  }
+  this->removeGap(gap.first, gap.second);
+  if (from > gap.first) this->addGap(gap.first, from - gap.first);
+  if (from + count < gap.first + gap.second) {
+    this->addGap(from + count, gap.first + gap.second - from - count);
+  }
+}
+
+void SpectrumIndex::release(int from, int count) {
+  if (count < 1 || from < 0 || from + count > this->slots) {
+    throw std::runtime_error("Cannot release slots out of bounds.");
+  }
+  std::map<int, int>::iterator next = this->gaps.lower_bound(from);
+  if (next != this->gaps.end() && next->first < from + count) {
+    throw std::runtime_error("Cannot release slots that are already free.");
+  }
+  int start = from;
+  int end = from + count;
+  if (next != this->gaps.begin()) {
+    std::map<int, int>::iterator previous = std::prev(next);
+    if (previous->first + previous->second > from) {
+      throw std::runtime_error("Cannot release slots that are already free.");
+    }
+    if (previous->first + previous->second == from) {
+      start = previous->first;
+      this->removeGap(previous->first, previous->second);
+    }
+  }
+  if (next != this->gaps.end() && next->first == end) {
+    end += next->second;
+    this->removeGap(next->first, next->second);
+  }
+  this->addGap(start, end - start);
+}
+
+int SpectrumIndex::firstFit(int length) const {
+  if (this->tree[1] < length) return -1;
+  int node = 1;
+  while (node < this->leaves) {
+    node = this->tree[2 * node] >= length ? 2 * node : 2 * node + 1;
+  }
+  return node - this->leaves;
+}
+
+int SpectrumIndex::bestFit(int length) const {
+  std::set<std::pair<int, int>>::const_iterator gap =
+      this->sizes.lower_bound(std::make_pair(length, -1));
+  return gap == this->sizes.end() ? -1 : gap->second;
+}
+
+int SpectrumIndex::exactFit(int length) const {
+  std::set<std::pair<int, int>>::const_iterator gap =
+      this->sizes.lower_bound(std::make_pair(length, -1));
+  if (gap == this->sizes.end() || gap->first != length) return -1;
+  return gap->second;
+}
+
+std::pair<int, int> SpectrumIndex::gapContaining(int slot) const {
+  std::map<int, int>::const_iterator gap = this->gaps.upper_bound(slot);
+  if (gap == this->gaps.begin()) return std::make_pair(-1, 0);
+  gap--;
+  if (gap->first + gap->second <= slot) return std::make_pair(-1, 0);
+  return *gap;
+}
+
+int SpectrumIndex::getLargestGap(void) const { return this->tree[1]; }
+
+int SpectrumIndex::getNumberOfGaps(void) const { return this->gaps.size(); }
+
+int SpectrumIndex::getSlots(void) const { return this->slots; }
+
+int SpectrumIndex::getFreeSlots(void) const { return this->freeSlots; }
+
+const std::map<int, int> &SpectrumIndex::getGaps(void) const {
+  return this->gaps;
+}
+
+std::vector<std::pair<int, int>> SpectrumIndex::intersect(
+    const std::vector<const SpectrumIndex *> &indexes) {
+  std::vector<std::pair<int, int>> common;
+  if (indexes.empty()) return common;
+  common.assign(indexes[0]->gaps.begin(), indexes[0]->gaps.end());
+  for (unsigned int i = 1; i < indexes.size() && !common.empty(); i++) {
+    const std::map<int, int> &gaps = indexes[i]->gaps;
+    std::vector<std::pair<int, int>> next;
+    for (unsigned int j = 0; j < common.size(); j++) {
+      int start = common[j].first;
+      int end = start + common[j].second;
+      // The gaps of the index that overlap [start, end)
+      std::map<int, int>::const_iterator gap = gaps.upper_bound(start);
+      if (gap != gaps.begin()) gap--;
+      for (; gap != gaps.end() && gap->first < end; gap++) {
+        int from = std::max(start, gap->first);
+        int to = std::min(end, gap->first + gap->second);
+        if (from < to) next.push_back(std::make_pair(from, to - from));
+      }
+    }
+    common.swap(next);
+  }
+  return common;
+}
+
+int SpectrumIndex::firstFit(const std::vector<std::pair<int, int>> &gaps,
+                            int length) {
+  for (unsigned int i = 0; i < gaps.size(); i++) {
+    if (gaps[i].second >= length) return gaps[i].first;
+  }
+  return -1;
+}
+
+int SpectrumIndex::lastFit(const std::vector<std::pair<int, int>> &gaps,
+                           int length) {
+  for (int i = gaps.size() - 1; i >= 0; i--) {
+    if (gaps[i].second >= length) return gaps[i].first + gaps[i].second - length;
+  }
+  return -1;
+}
+
+int SpectrumIndex::bestFit(const std::vector<std::pair<int, int>> &gaps,
+                           int length) {
+  int best = -1;
+  int bestLength = 0;
+  for (unsigned int i = 0; i < gaps.size(); i++) {
+    if (gaps[i].second >= length &&
+        (best == -1 || gaps[i].second < bestLength)) {
+      best = gaps[i].first;
+      bestLength = gaps[i].second;
+    }
+  }
+  return best;
+}
+
+int SpectrumIndex::exactFit(const std::vector<std::pair<int, int>> &gaps,
+                            int length) {
+  for (unsigned int i = 0; i < gaps.size(); i++) {
+    if (gaps[i].second == length) return gaps[i].first;
+  }
+  return -1;
+}
+#ifndef __LINK_H__
+#define __LINK_H__
+
+#define DEFAULT_SLOTS 320
+#define DEFAULT_LENGTH 100.0
+#define DEFAULT_CORES 1
+#define DEFAULT_MODES 1
+
+#define EON 1
+#define SDM 2
+// Defining NETWORK_TYPE as EON or SDM before including the simulator fixes
+// the type of the networks at compile time. EON builds only accept
+// single-core/single-mode links, whose number of cores and modes become
+// constants
+#ifdef NETWORK_TYPE
+#define DEFAULT_NETWORK_TYPE NETWORK_TYPE
+#else
+#define DEFAULT_NETWORK_TYPE EON
+#endif
+#if defined(NETWORK_TYPE) && NETWORK_TYPE == EON
+#define SINGLE_SPECTRUM
+#endif
+// The bounds and state of every slot changed by Link::setSlot and the slot
+// operations of Network are only checked on builds that define
+// BUFFEREON_CHECKED. Otherwise the Controller validates each connection
+// once, before placing it
+#ifdef BUFFEREON_CHECKED
+#define CHECK_SLOTS 1
+#else
+#define CHECK_SLOTS 0
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// #include "spectrum_index.hpp"
+
+/**
+ * @brief Sums of the fragmentation metrics of a set of spectra, one for every
+ * core and mode of a Link. Each Link keeps the sums of its own spectra up to
+ * date on every change of a slot, so the means of a Network or a route are
+ * read in O(1) per Link.
+ */
+struct FragmentationSums {
+  double externalFragmentation = 0;
+  double spectrumEntropy = 0;
+  int freeBlocks = 0;
+  int spectra = 0;
+};
+
+/**
+ * @brief Class type Link, this class allows you to create and manipulate the
+ link objects. A link
+ * within the simulator is the union between two nodes. The connection between
+ * two nodes is unidirectional.
+
+ * Each link has a number of cores, where each core has an associated number 
+ * of modes, and at the same time, each mode has a number of slots, these
+ * atributes are arranged in a single contiguous vector, core by core and mode
+ * by mode. In case of simulating single-core and single-mode network, the
+ * modes and cores can be omitted, and the slots are accessed without any
+ * indirection.
+ */
+
+class Link {
+  friend class Network;
+
+ public:
+  /**
+   * @brief Constructs a Link object. When calling with no parameters the
+   * default link "id" is -1, the default link "length" is 100.0, the default
+   * "number_of_cores" is 1, the default "number_of_modes" is 1 and the default
+   * "slots" are 320.
+   *
+   */
+  Link(void);
+  /**
+   * @brief Constructs a Link object. The parameter is assigned to the id
+   * attribute of the node, while the link length is set to 100.0, both number
+   * of cores and modes are set to 1, and the slots to 320 by default
+   * 
+   *
+   * @param id Identifier of the object. Type int. It serves to differentiate
+   * the created object from the others.
+   */
+  Link(int id);
+  /**
+   * @brief Constructs a Link object. The parameters are assigned to the "id"
+   * and length attributes of the node, while both number of cores and modes are
+   * set to 1 and the slots are set to 320.
+   *
+   * @param id Identifier of the object. Type int. It serves to differentiate
+   * the created object from the others.
+   * @param length The length of this new Link object. Type float. The length
+   * indicates the distance between two nodes. The unit of measure for length is
+   * kilometers.
+   */
+  Link(int id, float length);  
+  /**
+   * @brief Construct a Link object. The parameters are assigned to the id,
+   * length and slots attributes, while both number of cores and modes are set
+   * to 1 assuming a single-mode/single-core network.
+   *
+   * @param id Identifier of the object. Type int. It serves to differentiate
+   * the created object from the others.
+   * @param length The length of this new Link object. Type int. The length
+   * indicates the distance between two nodes. The unit of measure for length is
+   * kilometers.
+   * @param slots The size of the slots vector of this Link object. Type int.
+   * The slot is the channel through which the information is transmitted.
+   */
+  Link(int id, float length, int slots);
+  /**
+   * @brief Construct a Link object. The parameters are assigned to the id,
+   * length, slots and number_of_cores, while the number_of_modes is set to 1.
+   *
+   * @param id Identifier of the object. Type int. It serves to differentiate
+   * the created object from the others.
+   * @param length The length of this new Link object. Type int. The length
+   * indicates the distance between two nodes. The unit of measure for length is
+   * kilometers.
+   * @param slots The size of the slots vector of this Link object. Type int.
+   * The slot is the channel through which the information is transmitted.
+   * @param number_of_cores The number of cores of this Link object. Type int.
+   * The number of cores determine the number of paths through which the information
+   * can be transmited within the same link.
+   */
+  Link(int id, float length, int slots, int number_of_cores);
+  /**
+   * @brief Construct a Link object. The parameters are assigned to the id,
+   * length, number_of_cores, number_of_modes and slots attributes.
+   *
+   * @param id Identifier of the object. Type int. It serves to differentiate
+   * the created object from the others.
+   * @param length The length of this new Link object. Type int. The length
+   * indicates the distance between two nodes. The unit of measure for length is
+   * kilometers.
+   * @param slots The size of the slots vector of this Link object. Type int.
+   * The slot is the channel through which the information is transmitted.
+   * @param number_of_cores The number of cores of this Link object. Type int.
+   * The number of cores determine the number of paths through which the information
+   * can be transmited within the same link.
+   * @param number_of_modes The number of modes of this Link object. Type int.
+   * The number of modes determines how many modes each core belonging to this link
+   * can support.
+   */
+  Link(int id, float length, int slots, int number_of_cores, int number_of_modes);
+  /**
+   * @brief Destroys the Link object.
+   *
+   */
+  ~Link();
+  /**
+   * @brief Set the Id of a link. This method only works on links that were
+   * created without a specified id. That is, objects created with the
+   * constructor Link(void).
+   *
+   * @param id Identifier of the object. Type int. It serves to differentiate
+   * the created object from the others.
+   */
+  void setId(int id);
+  /**
+   * @brief Set the Length of the link. The value must be greater than or equal
+   * to zero.
+   *
+   * @param length The length of this new Link object. Type int. The length
+   * indicates the distance between two nodes. The unit of measure for length is
+   * kilometers.
+   */
+  void setLength(float length);
+  /**
+   * @brief Change the size of the Slots vector of the link. The value must
+   * be greater than or equal to 1 and every element on the previous vector must
+   * be set to false, which represents an inactive slot.
+   * 
+   * In case of a multi-core/multi-mode link, the size of every slot vector 
+   * within that link is changed.
+   *
+   * @param slots The size of the slots vector of this Link object. Type int.
+   * The slot is the channel through which the information is transmitted.
+   */
+  void setSlots(int slots);
+    /**
    * @brief Change the size of the Slots vector of the link in the specific
    * mode of a especific core. The value must be greater than or equal to 1 
    * and every element on the previous vector must be set to false, which 
@@ -356,7 +1192,8 @@ class Link {
   /**
    * @brief Set the value of a specific Slot inside the slots vector. The
    * position indicated must be inside the bounds of the vector, and the value
-   * parameter is assigned to the corresponding slot.
+   * parameter is assigned to the corresponding slot. The slot must be in the
+   * other state, which is only checked on BUFFEREON_CHECKED builds.
    * 
    * This method assumes a single-mode/single-core network.
    *
@@ -370,7 +1207,8 @@ class Link {
    * @brief Set the value of a specific Slot inside the slots vector of the
    * specified core and mode. The position indicated must be inside the bounds 
    * of the vector, mode and core, and the value parameter will be assigned to
-   * the corresponding slot.
+   * the corresponding slot. The slot must be in the other state, which is
+   * only checked on BUFFEREON_CHECKED builds.
    *
    * @param core The core index on the object Link. Type int, greater than or
    * equal to zero.
@@ -455,9 +1293,23 @@ class Link {
    */
   bool getSlot(int core, int mode, int pos) const;
   /**
-   * @brief Get the Number of cores attribute of the Link object.
+   * @brief Tells if every slot of a range of the specified Core and Mode is
+   * in the given state. It checks 64 slots at a time on the packed words
+   * (see getSlotWords).
    *
-   * @return int, the number_of_cores of this Link object.
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @param slotFrom The first slot of the range.
+   * @param slotTo The slot after the last one of the range.
+   * @param value The state, true for active.
+   * @return bool, true if every slot of the range is in the state.
+   */
+  bool isRangeInState(int core, int mode, int slotFrom, int slotTo,
+                      bool value) const;
+  /**
+   * @brief Get the Number of cores attribute of the Link object.
+   *
+   * @return int, the number_of_cores of this Link object.
    */
   int getCores(void) const;
   /**
@@ -482,6 +1334,218 @@ class Link {
    * @return int, the identifier of the destination attribute of this Link.
    */
   int getDst(void) const;
+  /**
+   * @brief Get the length of the largest block of contiguous free slots of
+   * the link. It's updated on every change of a slot, so it costs O(1). An
+   * allocation that needs more slots than this can be rejected right away.
+   *
+   * This method assumes a single-mode/single-core network.
+   *
+   * @return int, the length of the largest free block, 0 if every slot is
+   * active.
+   */
+  int getLargestFreeBlock(void) const;
+  /**
+   * @brief Get the length of the largest block of contiguous free slots of
+   * the specified Core and Mode.
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @return int, the length of the largest free block.
+   */
+  int getLargestFreeBlock(int core, int mode) const;
+  /**
+   * @brief Get the histogram of the free blocks of the link: the element l
+   * is the number of maximal blocks of exactly l contiguous free slots.
+   *
+   * This method assumes a single-mode/single-core network.
+   *
+   * @return const std::vector<int>&, the histogram, of size slots + 1.
+   */
+  const std::vector<int> &getFreeBlocks(void) const;
+  /**
+   * @brief Get the histogram of the free blocks of the specified Core and
+   * Mode.
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @return const std::vector<int>&, the histogram, of size slots + 1.
+   */
+  const std::vector<int> &getFreeBlocks(int core, int mode) const;
+  /**
+   * @brief Get the number of free slots of the link. Like every
+   * fragmentation metric of the link, it's updated on every change of a
+   * slot, so it costs O(1).
+   *
+   * This method assumes a single-mode/single-core network.
+   *
+   * @return int, the number of free slots.
+   */
+  int getFreeSlots(void) const;
+  /**
+   * @brief Get the number of free slots of the specified Core and Mode.
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @return int, the number of free slots.
+   */
+  int getFreeSlots(int core, int mode) const;
+  /**
+   * @brief Get the number of maximal blocks of contiguous free slots of the
+   * link, that is, the sum of the histogram of getFreeBlocks.
+   *
+   * This method assumes a single-mode/single-core network.
+   *
+   * @return int, the number of free blocks.
+   */
+  int getNumberOfFreeBlocks(void) const;
+  /**
+   * @brief Get the number of maximal blocks of contiguous free slots of the
+   * specified Core and Mode.
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @return int, the number of free blocks.
+   */
+  int getNumberOfFreeBlocks(int core, int mode) const;
+  /**
+   * @brief Get the external fragmentation of the link, the share of the free
+   * slots that are out of the largest free block:
+   *
+   * \f[
+          EF = 1 - \frac{largest\ free\ block}{free\ slots}
+     \f]
+   *
+   * This method assumes a single-mode/single-core network.
+   *
+   * @return double, the external fragmentation between 0 and 1, 0 if every
+   * slot is active.
+   */
+  double getExternalFragmentation(void) const;
+  /**
+   * @brief Get the external fragmentation of the specified Core and Mode.
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @return double, the external fragmentation between 0 and 1.
+   */
+  double getExternalFragmentation(int core, int mode) const;
+  /**
+   * @brief Get the spectrum entropy of the link, computed over its free
+   * blocks of lengths \f$ b_i \f$ on a spectrum of S slots:
+   *
+   * \f[
+          H = -\sum_i \frac{b_i}{S} \ln \frac{b_i}{S}
+     \f]
+   *
+   * It's 0 when the link is full or empty, and grows as the free slots are
+   * split in more blocks.
+   *
+   * This method assumes a single-mode/single-core network.
+   *
+   * @return double, the spectrum entropy in nats.
+   */
+  double getSpectrumEntropy(void) const;
+  /**
+   * @brief Get the spectrum entropy of the specified Core and Mode.
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @return double, the spectrum entropy in nats.
+   */
+  double getSpectrumEntropy(int core, int mode) const;
+  /**
+   * @brief Get the state of the slots packed in 64 bit words: bit s % 64 of
+   * word s / 64 is set if slot s is active. It's updated on every change of
+   * a slot, so the slots of several links can be combined a word at a time.
+   *
+   * The words of every core and mode follow each other as a [core][mode]
+   * [word] tensor, each one getWordStride() words long, so this is also the
+   * beginning of the whole tensor. The bits after the last slot of a core
+   * and mode are 0.
+   *
+   * @return const uint64_t*, the words of the first core and mode.
+   */
+  const uint64_t *getSlotWords(void) const;
+  /**
+   * @brief Get the state of the slots of the specified Core and Mode packed
+   * in 64 bit words.
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @return const uint64_t*, the (getSlots(core, mode) + 63) / 64 words of
+   * the slots vector.
+   */
+  const uint64_t *getSlotWords(int core, int mode) const;
+  /**
+   * @brief Get the number of words of every core and mode on the tensor of
+   * getSlotWords, enough for the core and mode with the most slots.
+   *
+   * @return int, the number of words.
+   */
+  int getWordStride(void) const;
+  /**
+   * @brief Enables or disables the spectrum index of the link (see
+   * SpectrumIndex), which keeps the free intervals of every core and mode on
+   * ordered structures for best fit and exact fit queries. Once enabled, it's
+   * updated on every change of a slot, at O(log S) each.
+   *
+   * @param enabled true to build the index from the current state of the
+   * slots, false to discard it.
+   */
+  void setSpectrumIndex(bool enabled);
+  /**
+   * @brief Get if the spectrum index of the link is enabled.
+   *
+   * @return bool true if the index is enabled.
+   */
+  bool hasSpectrumIndex(void) const;
+  /**
+   * @brief Get the spectrum index of the link.
+   *
+   * This method assumes a single-mode/single-core network.
+   *
+   * @return const SpectrumIndex&, the index of the slots vector.
+   */
+  const SpectrumIndex &getSpectrumIndex(void) const;
+  /**
+   * @brief Get the spectrum index of the specified Core and Mode.
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @return const SpectrumIndex&, the index of the slots vector.
+   */
+  const SpectrumIndex &getSpectrumIndex(int core, int mode) const;
+  /**
+   * @brief Set the cores that are adjacent to every core of the fibre, whose
+   * signals on the same slots and mode interfere with each other
+   * (crosstalk). Once set, the link keeps for every slot the number of
+   * adjacent cores that use it (see getOccupiedNeighbors), updated on every
+   * change of a slot.
+   *
+   * @param adjacency the adjacent cores of every core. It must have one
+   * element per core and be symmetric. An empty vector removes the adjacency.
+   */
+  void setCoreAdjacency(const std::vector<std::vector<int>> &adjacency);
+  /**
+   * @brief Get the cores that are adjacent to every core of the fibre.
+   *
+   * @return const std::vector<std::vector<int>>&, the adjacent cores of every
+   * core, empty if no adjacency was set.
+   */
+  const std::vector<std::vector<int>> &getCoreAdjacency(void) const;
+  /**
+   * @brief Get the number of cores adjacent to a core that use a slot on the
+   * same mode. It's kept up to date on every change of a slot, so it costs
+   * O(1).
+   *
+   * @param core The core index on the object Link.
+   * @param mode The mode index on the object Link.
+   * @param pos The position of the slot.
+   * @return int, the number of adjacent cores that use the slot, 0 if no
+   * adjacency was set.
+   */
+  int getOccupiedNeighbors(int core, int mode, int pos) const;
 
  private:
   int id;
@@ -490,8 +1554,47 @@ class Link {
   float length;
   int number_of_cores;
   int number_of_modes;
-  std::vector<std::vector<std::vector<bool>>>slots;
-
+  // The slots of every core and mode (a spectrum), one after the other:
+  // spectrum core * modes + mode takes [offsets[s], offsets[s + 1]) of slots
+  // and words [s * wordStride, (s + 1) * wordStride) of slotWords, padded
+  // with free bits up to the largest spectrum. The first spectrum starts at
+  // 0, so single-core accesses don't need the offsets
+  std::vector<bool> slots;
+  std::vector<int> offsets;
+  int wordStride;
+  std::vector<uint64_t> slotWords;
+  // Free blocks of every spectrum. The first and last slot of every free
+  // block point to each other, so blocks are split and merged in O(1)
+  std::vector<std::vector<int>> freeBlocks;
+  std::vector<int> blockStart;
+  std::vector<int> blockEnd;
+  std::vector<int> largestFreeBlock;
+  // Fragmentation metrics of every spectrum: free slots, free blocks and the
+  // sum of b ln b over the free blocks of length b, with b ln b tabulated
+  std::vector<int> freeSlots;
+  std::vector<int> numberOfFreeBlocks;
+  std::vector<double> blockEntropy;
+  std::vector<double> blockLogs;
+  // The metrics summed over every spectrum. They're only written by the
+  // changes of the slots of this link, so links can change concurrently
+  FragmentationSums metrics;
+  std::vector<SpectrumIndex> spectrumIndex;
+  bool indexed;
+  // Adjacent cores of every core, and the number of adjacent cores using
+  // every slot, with the same offsets as slots
+  std::vector<std::vector<int>> coreAdjacency;
+  std::vector<int> occupiedNeighbors;
+
+  int spectrumOf(int core, int mode) const;
+  bool hasActiveSlots(void) const;
+  void setLayout(int cores, int modes, const std::vector<int> &sizes);
+  void resetFreeBlocks(void);
+  void updateFreeBlocks(int spectrum, int pos, bool value);
+  void changeFreeBlocks(int spectrum, int length, int delta);
+  FragmentationSums spectrumMetrics(int spectrum) const;
+  void changeMetrics(const FragmentationSums &delta, int sign);
+  void countNeighbors(void);
+  void updateNeighbors(int spectrum, int pos, int delta);
 };
 
 #endif
@@ -500,24 +1603,22 @@ class Link {
 Link::Link(void) {
   this->id = -1;
   this->length = DEFAULT_LENGTH;
-  this->slots = std::vector<std::vector<std::vector<bool>>>
-                (1, std::vector<std::vector<bool>>(1, std::vector<bool>(DEFAULT_SLOTS,false)));
   this->src = -1;
   this->dst = -1;
-  this->number_of_cores = DEFAULT_CORES;
-  this->number_of_modes = DEFAULT_MODES;
+  this->indexed = false;
+  this->setLayout(DEFAULT_CORES, DEFAULT_MODES,
+                  std::vector<int>(DEFAULT_CORES * DEFAULT_MODES, DEFAULT_SLOTS));
 }
 
 Link::Link(int id) {
   this->id = id;
 
   this->length = DEFAULT_LENGTH;
-  this->slots = std::vector<std::vector<std::vector<bool>>>
-                (1, std::vector<std::vector<bool>>(1, std::vector<bool>(DEFAULT_SLOTS,false)));
   this->src = -1;
   this->dst = -1;
-  this->number_of_cores = DEFAULT_CORES;
-  this->number_of_modes = DEFAULT_MODES;
+  this->indexed = false;
+  this->setLayout(DEFAULT_CORES, DEFAULT_MODES,
+                  std::vector<int>(DEFAULT_CORES * DEFAULT_MODES, DEFAULT_SLOTS));
 }
 
 Link::Link(int id, float length) {
@@ -527,12 +1628,11 @@ Link::Link(int id, float length) {
     throw std::runtime_error("Cannot create a link with non-positive length.");
   this->length = length;
 
-  this->slots = std::vector<std::vector<std::vector<bool>>>
-                (1, std::vector<std::vector<bool>>(1, std::vector<bool>(DEFAULT_SLOTS,false)));
   this->src = -1;
   this->dst = -1;
-  this->number_of_cores = DEFAULT_CORES;
-  this->number_of_modes = DEFAULT_MODES;
+  this->indexed = false;
+  this->setLayout(DEFAULT_CORES, DEFAULT_MODES,
+                  std::vector<int>(DEFAULT_CORES * DEFAULT_MODES, DEFAULT_SLOTS));
 }
 
 
@@ -546,12 +1646,11 @@ Link::Link(int id, float length, int slots) {
   if (slots < 1)
     throw std::runtime_error("Cannot create a link with " +
                              std::to_string(slots) + " slots.");
-  this->slots = std::vector<std::vector<std::vector<bool>>>
-                (1, std::vector<std::vector<bool>>(1, std::vector<bool>(slots,false)));
   this->src = -1;
   this->dst = -1;
-  this->number_of_cores = DEFAULT_CORES;
-  this->number_of_modes = DEFAULT_MODES;
+  this->indexed = false;
+  this->setLayout(DEFAULT_CORES, DEFAULT_MODES,
+                  std::vector<int>(DEFAULT_CORES * DEFAULT_MODES, slots));
 }
 
 Link::Link(int id, float length, int slots, int number_of_cores) {
@@ -569,13 +1668,11 @@ Link::Link(int id, float length, int slots, int number_of_cores) {
     throw std::runtime_error("Cannot create a link with " +
                              std::to_string(number_of_cores) + " cores.");
 
-  this->slots = std::vector<std::vector<std::vector<bool>>>
-                (number_of_cores, std::vector<std::vector<bool>>
-                (DEFAULT_MODES, std::vector<bool>(slots,false)));
   this->src = -1;
   this->dst = -1;
-  this->number_of_cores = number_of_cores;
-  this->number_of_modes = DEFAULT_MODES;
+  this->indexed = false;
+  this->setLayout(number_of_cores, DEFAULT_MODES,
+                  std::vector<int>(number_of_cores * DEFAULT_MODES, slots));
 }
 
 Link::Link(int id, float length, int slots, int number_of_cores, int number_of_modes) {
@@ -597,13 +1694,11 @@ Link::Link(int id, float length, int slots, int number_of_cores, int number_of_m
     throw std::runtime_error("Cannot create a link with " +
                              std::to_string(number_of_modes) + " modes.");
 
-  this->slots = std::vector<std::vector<std::vector<bool>>>
-                (number_of_cores, std::vector<std::vector<bool>>
-                (number_of_modes, std::vector<bool>(slots,false)));
   this->src = -1;
   this->dst = -1;
-  this->number_of_cores = number_of_cores;
-  this->number_of_modes = number_of_modes;
+  this->indexed = false;
+  this->setLayout(number_of_cores, number_of_modes,
+                  std::vector<int>(number_of_cores * number_of_modes, slots));
 }
 
 Link::~Link() {}
@@ -626,26 +1721,23 @@ void Link::setSlots(int slots) {
   if (slots < 1)
     throw std::runtime_error("Cannot set a link with " + std::to_string(slots) +
                              " slots.");
-  for (int i = 0; i < this->getCores(); i++)
-    for (int j = 0; j < this->getModes(); j++)
-      for (int k = 0; k < this->getSlots(i,j); k++)
-        if (this->slots[i][j][k] == true)
-          throw std::runtime_error(
-              "Cannot change slots number if at least one slot is active within this link.");
+  if (this->hasActiveSlots())
+    throw std::runtime_error(
+        "Cannot change slots number if at least one slot is active within this link.");
 
-  for (int i = 0; i < this->getCores(); i++)
-    for (int j = 0; j < this->getModes(); j++)
-      this->slots[i][j].resize(slots);
+  this->setLayout(this->getCores(), this->getModes(),
+                  std::vector<int>(this->getCores() * this->getModes(), slots));
 }
 
 void Link::setSlot(int pos, bool value) {
-  if (pos < 0 || pos >= this->getSlots())
+  if (CHECK_SLOTS && (pos < 0 || pos >= this->getSlots()))
     throw std::runtime_error("Cannot set slot in position out of bounds.");
 
-  if (this->getSlot(pos) == value)
+  if (CHECK_SLOTS && this->slots[pos] == value)
     throw std::runtime_error("Slot already setted in desired state.");
 
-  this->slots[0][0][pos] = value;
+  this->updateFreeBlocks(0, pos, value);
+  this->slots[pos] = value;
 }
 
 void Link::setCores(int number_of_cores) {
@@ -656,14 +1748,16 @@ void Link::setCores(int number_of_cores) {
   if (this->getCores() == number_of_cores)
     throw std::runtime_error("Number of cores is already the desired.");
 
-  for (int i = 0; i < this->getCores(); i++)
+  if (this->hasActiveSlots())
+    throw std::runtime_error(
+        "The number of cores cannot be changed if at least one slot is active within this core.");
+
+  // New cores get the slots of the first core
+  std::vector<int> sizes;
+  for (int i = 0; i < number_of_cores; i++)
     for (int j = 0; j < this->getModes(); j++)
-      for (int k = 0; k < this->getSlots(i,j); k++)
-        if (this->slots[i][j][k] == true)
-          throw std::runtime_error(
-              "The number of cores cannot be changed if at least one slot is active within this core.");
-  this->number_of_cores = number_of_cores;
-  this->slots.resize(number_of_cores);
+      sizes.push_back(this->getSlots(i < this->getCores() ? i : 0, j));
+  this->setLayout(number_of_cores, this->getModes(), sizes);
 }
 
 void Link::setModes(int number_of_modes) {
@@ -674,16 +1768,16 @@ void Link::setModes(int number_of_modes) {
   if (this->getModes() == number_of_modes)
     throw std::runtime_error("Number of slots is already the desired.");
 
-  for (int i = 0; i < this->getCores(); i++)
-    for (int j = 0; j < this->getModes(); j++)
-      for (int k = 0; k < this->getSlots(i,j); k++)
-        if (this->slots[i][j][k] == true)
-          throw std::runtime_error(
-              "The number of modes cannot be changed if at least one slot is active within this mode.");
+  if (this->hasActiveSlots())
+    throw std::runtime_error(
+        "The number of modes cannot be changed if at least one slot is active within this mode.");
 
-  this->number_of_modes = number_of_modes;
+  // New modes get the slots of the first mode of their core
+  std::vector<int> sizes;
   for (int i = 0; i < this->getCores(); i++)
-    this->slots[i].resize(number_of_modes);
+    for (int j = 0; j < number_of_modes; j++)
+      sizes.push_back(this->getSlots(i, j < this->getModes() ? j : 0));
+  this->setLayout(this->getCores(), number_of_modes, sizes);
 }
 
 void Link::setSlots(int slots, int core, int mode) {
@@ -700,43 +1794,62 @@ void Link::setSlots(int slots, int core, int mode) {
   if (this->getSlots(core, mode) == slots)
     throw std::runtime_error("Number of modes is already the desired.");
 
-  for (int i = 0; i < this->getSlots(core, mode); i++) 
-    if (this->slots[core][mode][i] == true)
+  int spectrum = this->spectrumOf(core, mode);
+  for (int i = this->offsets[spectrum]; i < this->offsets[spectrum + 1]; i++)
+    if (this->slots[i] == true)
       throw std::runtime_error(
           "Cannot change slots number if at least one slot is active.");
 
-  this->slots[core][mode].resize(slots);
+  // The other spectra keep their state, so they are copied to the new layout
+  std::vector<bool> state = this->slots;
+  std::vector<int> previous = this->offsets;
+  std::vector<int> sizes;
+  for (unsigned int i = 0; i + 1 < previous.size(); i++)
+    sizes.push_back(previous[i + 1] - previous[i]);
+  sizes[spectrum] = slots;
+  this->setLayout(this->getCores(), this->getModes(), sizes);
+  for (unsigned int i = 0; i < sizes.size(); i++) {
+    if (static_cast<int>(i) == spectrum) continue;
+    for (int k = 0; k < sizes[i]; k++)
+      if (state[previous[i] + k]) this->slots[this->offsets[i] + k] = true;
+  }
+  this->resetFreeBlocks();
 }
 
 void Link::setSlot(int core, int mode, int pos, bool value) {
-  if (core < 0 || core >= this->getCores())
+  if (CHECK_SLOTS && (core < 0 || core >= this->getCores()))
     throw std::runtime_error("Cannot set slot in core out of bounds.");
 
-  if (mode < 0 || mode >= this->getModes())
+  if (CHECK_SLOTS && (mode < 0 || mode >= this->getModes()))
     throw std::runtime_error("Cannot set slot in mode out of bounds.");
 
-  if (pos < 0 || pos >= this->getSlots(core, mode))
+  if (CHECK_SLOTS && (pos < 0 || pos >= this->getSlots(core, mode)))
     throw std::runtime_error("Cannot set slot in position out of bounds.");
 
-  if (this->getSlot(core, mode, pos) == value)
+  int spectrum = this->spectrumOf(core, mode);
+  if (CHECK_SLOTS && this->slots[this->offsets[spectrum] + pos] == value)
     throw std::runtime_error("Slot already setted in desired state.");
 
-  this->slots[core][mode][pos] = value;
+  this->updateFreeBlocks(spectrum, pos, value);
+  this->slots[this->offsets[spectrum] + pos] = value;
 }
 
 int Link::getId(void) const { return this->id; }
 
 float Link::getLength(void) const { return this->length; }
 
-int Link::getSlots(void) const { return this->slots[0][0].size(); }
+int Link::getSlots(void) const { return this->offsets[1]; }
 
-int Link::getSlots(int core, int mode) const { return this->slots[core][mode].size(); }
+int Link::getSlots(int core, int mode) const {
+  int spectrum = this->spectrumOf(core, mode);
+  return this->offsets[spectrum + 1] - this->offsets[spectrum];
+}
 
 bool Link::getSlot(int pos) const {
   if (pos < 0 || pos >= this->getSlots())
     throw std::runtime_error("Cannot get slot in position out of bounds.");
 
-  return this->slots[0][0][pos];
+  return this->slots[pos];
 }
 
 bool Link::getSlot(int core, int mode, int pos) const {
@@ -746,150 +1859,567 @@ bool Link::getSlot(int core, int mode, int pos) const {
   if (mode < 0 || mode >= this->getModes())
     throw std::runtime_error("Cannot set number of slots in mode out of bounds.");
 
-  if (pos < 0 || pos >= this->getSlots())
+  if (pos < 0 || pos >= this->getSlots(core, mode))
     throw std::runtime_error("Cannot get slot in position out of bounds.");
 
-  return this->slots[core][mode][pos];
+  return this->slots[this->offsets[this->spectrumOf(core, mode)] + pos];
 }
 
+#ifdef SINGLE_SPECTRUM
+int Link::getCores(void) const { return 1; }
+
+int Link::getModes(void) const { return 1; }
+#else
 int Link::getCores(void) const { return this->number_of_cores; }
 
 int Link::getModes(void) const { return this->number_of_modes; }
+#endif
 
 int Link::getSrc(void) const { return this->src; }
 
 int Link::getDst(void) const { return this->dst; }
-/*
-    __ _____ _____ _____
- __|  |   __|     |   | |  JSON for Modern C++
-|  |  |__   |  |  | | | |  version 3.9.1
-|_____|_____|_____|_|___|  https://github.com/nlohmann/json
-
-Licensed under the MIT License <http://opensource.org/licenses/MIT>.
-SPDX-License-Identifier: MIT
-Copyright (c) 2013-2019 Niels Lohmann <http://nlohmann.me>.
-
-Permission is hereby  granted, free of charge, to any  person obtaining a copy
-of this software and associated  documentation files (the "Software"), to deal
-in the Software  without restriction, including without  limitation the rights
-to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
-copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
-furnished to do so, subject to the following conditions:
 
-The above copyright notice and this permission notice shall be included in all
-copies or substantial portions of the Software.
+int Link::getLargestFreeBlock(void) const {
+  return this->largestFreeBlock[0];
+}
 
-THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
-IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
-FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
-AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
-LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
-SOFTWARE.
-*/
+int Link::getLargestFreeBlock(int core, int mode) const {
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error("Cannot get free blocks in core out of bounds.");
 
-#ifndef INCLUDE_NLOHMANN_JSON_HPP_
-#define INCLUDE_NLOHMANN_JSON_HPP_
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error("Cannot get free blocks in mode out of bounds.");
 
-#define NLOHMANN_JSON_VERSION_MAJOR 3
-#define NLOHMANN_JSON_VERSION_MINOR 9
-#define NLOHMANN_JSON_VERSION_PATCH 1
+  return this->largestFreeBlock[this->spectrumOf(core, mode)];
+}
 
-#include <algorithm> // all_of, find, for_each
-#include <cstddef> // nullptr_t, ptrdiff_t, size_t
-#include <functional> // hash, less
-#include <initializer_list> // initializer_list
-#include <iosfwd> // istream, ostream
-#include <iterator> // random_access_iterator_tag
-#include <memory> // unique_ptr
-#include <numeric> // accumulate
-#include <string> // string, stoi, to_string
-#include <utility> // declval, forward, move, pair, swap
-#include <vector> // vector
+const std::vector<int> &Link::getFreeBlocks(void) const {
+  return this->freeBlocks[0];
+}
 
-// #include <nlohmann/adl_serializer.hpp>
+const std::vector<int> &Link::getFreeBlocks(int core, int mode) const {
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error("Cannot get free blocks in core out of bounds.");
 
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error("Cannot get free blocks in mode out of bounds.");
 
-#include <utility>
+  return this->freeBlocks[this->spectrumOf(core, mode)];
+}
 
-// #include <nlohmann/detail/conversions/from_json.hpp>
+int Link::getFreeSlots(void) const { return this->freeSlots[0]; }
 
+int Link::getFreeSlots(int core, int mode) const {
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error("Cannot get free slots in core out of bounds.");
 
-#include <algorithm> // transform
-#include <array> // array
-#include <forward_list> // forward_list
-#include <iterator> // inserter, front_inserter, end
-#include <map> // map
-#include <string> // string
-#include <tuple> // tuple, make_tuple
-#include <type_traits> // is_arithmetic, is_same, is_enum, underlying_type, is_convertible
-#include <unordered_map> // unordered_map
-#include <utility> // pair, declval
-#include <valarray> // valarray
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error("Cannot get free slots in mode out of bounds.");
 
-// #include <nlohmann/detail/exceptions.hpp>
+  return this->freeSlots[this->spectrumOf(core, mode)];
+}
 
+int Link::getNumberOfFreeBlocks(void) const {
+  return this->numberOfFreeBlocks[0];
+}
 
-#include <exception> // exception
-#include <stdexcept> // runtime_error
-#include <string> // to_string
+int Link::getNumberOfFreeBlocks(int core, int mode) const {
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error("Cannot get free blocks in core out of bounds.");
 
-// #include <nlohmann/detail/input/position_t.hpp>
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error("Cannot get free blocks in mode out of bounds.");
 
+  return this->numberOfFreeBlocks[this->spectrumOf(core, mode)];
+}
 
-#include <cstddef> // size_t
+double Link::getExternalFragmentation(void) const {
+  if (this->freeSlots[0] == 0) return 0;
+  return 1 - this->largestFreeBlock[0] / static_cast<double>(this->freeSlots[0]);
+}
 
-namespace nlohmann
-{
-namespace detail
-{
-/// struct to capture the start position of the current token
-struct position_t
-{
-    /// the total number of characters read
-    std::size_t chars_read_total = 0;
-    /// the number of characters read in the current line
-    std::size_t chars_read_current_line = 0;
-    /// the number of lines read
-    std::size_t lines_read = 0;
+double Link::getExternalFragmentation(int core, int mode) const {
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error(
+        "Cannot get fragmentation in core out of bounds.");
 
-    /// conversion to size_t to preserve SAX interface
-    constexpr operator size_t() const
-    {
-        return chars_read_total;
-    }
-};
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error(
+        "Cannot get fragmentation in mode out of bounds.");
 
-} // namespace detail
-} // namespace nlohmann
+  int spectrum = this->spectrumOf(core, mode);
+  if (this->freeSlots[spectrum] == 0) return 0;
+  return 1 - this->largestFreeBlock[spectrum] /
+                 static_cast<double>(this->freeSlots[spectrum]);
+}
 
-// #include <nlohmann/detail/macro_scope.hpp>
+double Link::getSpectrumEntropy(void) const {
+  return this->getSpectrumEntropy(0, 0);
+}
 
+double Link::getSpectrumEntropy(int core, int mode) const {
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error("Cannot get entropy in core out of bounds.");
 
-#include <utility> // pair
-// #include <nlohmann/thirdparty/hedley/hedley.hpp>
-/* Hedley - https://nemequ.github.io/hedley
- * Created by Evan Nemerson <evan@nemerson.com>
- *
- * To the extent possible under law, the author(s) have dedicated all
- * copyright and related and neighboring rights to this software to
- * the public domain worldwide. This software is distributed without
- * any warranty.
- *
- * For details, see <http://creativecommons.org/publicdomain/zero/1.0/>.
- * SPDX-License-Identifier: CC0-1.0
- */
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error("Cannot get entropy in mode out of bounds.");
+
+  // -sum (b/S) ln(b/S) = (F ln S - sum b ln b) / S, with F the free slots
+  int spectrum = this->spectrumOf(core, mode);
+  int size = this->offsets[spectrum + 1] - this->offsets[spectrum];
+  return (this->freeSlots[spectrum] * std::log(static_cast<double>(size)) -
+          this->blockEntropy[spectrum]) /
+         size;
+}
 
-#if !defined(JSON_HEDLEY_VERSION) || (JSON_HEDLEY_VERSION < 14)
-#if defined(JSON_HEDLEY_VERSION)
-    #undef JSON_HEDLEY_VERSION
+int Link::spectrumOf(int core, int mode) const {
+#ifdef SINGLE_SPECTRUM
+  (void)core;
+  (void)mode;
+  return 0;
+#else
+  return core * this->number_of_modes + mode;
 #endif
-#define JSON_HEDLEY_VERSION 14
+}
 
-#if defined(JSON_HEDLEY_STRINGIFY_EX)
-    #undef JSON_HEDLEY_STRINGIFY_EX
-#endif
-#define JSON_HEDLEY_STRINGIFY_EX(x) #x
+bool Link::hasActiveSlots(void) const {
+  for (unsigned int i = 0; i < this->slotWords.size(); i++)
+    if (this->slotWords[i] != 0) return true;
+  return false;
+}
+
+void Link::setLayout(int cores, int modes, const std::vector<int> &sizes) {
+#ifdef SINGLE_SPECTRUM
+  if (cores != 1 || modes != 1)
+    throw std::runtime_error(
+        "Cannot create a link with several cores or modes on an EON build.");
+#endif
+  if (static_cast<int>(this->coreAdjacency.size()) != cores)
+    this->coreAdjacency.clear();
+  this->number_of_cores = cores;
+  this->number_of_modes = modes;
+  this->offsets.assign(1, 0);
+  this->wordStride = 0;
+  int largest = 0;
+  for (unsigned int i = 0; i < sizes.size(); i++) {
+    this->offsets.push_back(this->offsets.back() + sizes[i]);
+    this->wordStride = std::max(this->wordStride, (sizes[i] + 63) / 64);
+    largest = std::max(largest, sizes[i]);
+  }
+  this->blockLogs.assign(largest + 1, 0);
+  for (int b = 2; b <= largest; b++) this->blockLogs[b] = b * std::log(b);
+  this->slots.assign(this->offsets.back(), false);
+  this->resetFreeBlocks();
+}
+
+void Link::resetFreeBlocks(void) {
+  this->metrics = FragmentationSums();
+  int spectra = this->offsets.size() - 1;
+  this->freeBlocks.resize(spectra);
+  this->blockStart.assign(this->offsets.back(), 0);
+  this->blockEnd.assign(this->offsets.back(), 0);
+  this->largestFreeBlock.assign(spectra, 0);
+  this->freeSlots.assign(spectra, 0);
+  this->numberOfFreeBlocks.assign(spectra, 0);
+  this->blockEntropy.assign(spectra, 0);
+  this->slotWords.assign(spectra * this->wordStride, 0);
+  for (int i = 0; i < spectra; i++) {
+    int offset = this->offsets[i];
+    int size = this->offsets[i + 1] - offset;
+    uint64_t *words = &this->slotWords[0] + i * this->wordStride;
+    int *start = &this->blockStart[0] + offset;
+    int *end = &this->blockEnd[0] + offset;
+    this->freeBlocks[i].assign(size + 1, 0);
+    for (int k = 0; k < size; k++) {
+      if (this->slots[offset + k]) words[k / 64] |= uint64_t(1) << (k % 64);
+    }
+    int k = 0;
+    while (k < size) {
+      if (this->slots[offset + k]) {
+        k++;
+        continue;
+      }
+      int first = k;
+      while (k < size && !this->slots[offset + k]) k++;
+      end[first] = k - 1;
+      start[k - 1] = first;
+      this->changeFreeBlocks(i, k - first, 1);
+      this->freeSlots[i] += k - first;
+      if (k - first > this->largestFreeBlock[i]) {
+        this->largestFreeBlock[i] = k - first;
+      }
+    }
+    this->changeMetrics(this->spectrumMetrics(i), 1);
+  }
+  if (this->indexed) this->setSpectrumIndex(true);
+  this->countNeighbors();
+}
+
+void Link::countNeighbors(void) {
+  this->occupiedNeighbors.assign(this->offsets.back(), 0);
+  for (unsigned int i = 0; i < this->coreAdjacency.size(); i++) {
+    for (int j = 0; j < this->getModes(); j++) {
+      int spectrum = this->spectrumOf(i, j);
+      int size = this->offsets[spectrum + 1] - this->offsets[spectrum];
+      for (int k = 0; k < size; k++) {
+        if (this->slots[this->offsets[spectrum] + k])
+          this->updateNeighbors(spectrum, k, 1);
+      }
+    }
+  }
+}
+
+void Link::updateNeighbors(int spectrum, int pos, int delta) {
+  int modes = this->getModes();
+  const std::vector<int> &adjacent = this->coreAdjacency[spectrum / modes];
+  for (unsigned int i = 0; i < adjacent.size(); i++) {
+    int neighbor = adjacent[i] * modes + spectrum % modes;
+    if (pos < this->offsets[neighbor + 1] - this->offsets[neighbor]) {
+      this->occupiedNeighbors[this->offsets[neighbor] + pos] += delta;
+    }
+  }
+}
+
+void Link::setCoreAdjacency(const std::vector<std::vector<int>> &adjacency) {
+  if (!adjacency.empty() &&
+      static_cast<int>(adjacency.size()) != this->getCores())
+    throw std::runtime_error("The core adjacency must have one element per core.");
+
+  for (unsigned int i = 0; i < adjacency.size(); i++) {
+    for (unsigned int j = 0; j < adjacency[i].size(); j++) {
+      int neighbor = adjacency[i][j];
+      if (neighbor < 0 || neighbor >= this->getCores() ||
+          neighbor == static_cast<int>(i))
+        throw std::runtime_error("Cannot set core " + std::to_string(neighbor) +
+                                 " adjacent to core " + std::to_string(i) + ".");
+      if (std::count(adjacency[neighbor].begin(), adjacency[neighbor].end(),
+                     static_cast<int>(i)) != 1)
+        throw std::runtime_error("The core adjacency must be symmetric.");
+    }
+  }
+  this->coreAdjacency = adjacency;
+  this->countNeighbors();
+}
+
+const std::vector<std::vector<int>> &Link::getCoreAdjacency(void) const {
+  return this->coreAdjacency;
+}
+
+int Link::getOccupiedNeighbors(int core, int mode, int pos) const {
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error("Cannot get neighbors in core out of bounds.");
+
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error("Cannot get neighbors in mode out of bounds.");
+
+  if (pos < 0 || pos >= this->getSlots(core, mode))
+    throw std::runtime_error("Cannot get neighbors in position out of bounds.");
+
+  return this->occupiedNeighbors[this->offsets[this->spectrumOf(core, mode)] + pos];
+}
+
+bool Link::isRangeInState(int core, int mode, int slotFrom, int slotTo,
+                          bool value) const {
+  const uint64_t *words = this->getSlotWords(core, mode);
+  if (slotFrom < 0 || slotTo > this->getSlots(core, mode) || slotFrom >= slotTo)
+    throw std::runtime_error("Cannot check slots in range out of bounds.");
+
+  for (int w = slotFrom / 64; w <= (slotTo - 1) / 64; w++) {
+    int first = std::max(slotFrom - w * 64, 0);
+    int last = std::min(slotTo - w * 64, 64);
+    uint64_t mask = (last == 64 ? ~uint64_t(0) : (uint64_t(1) << last) - 1) &
+                    ~((uint64_t(1) << first) - 1);
+    if ((value ? ~words[w] & mask : words[w] & mask) != 0) return false;
+  }
+  return true;
+}
+
+const uint64_t *Link::getSlotWords(void) const {
+  return this->slotWords.data();
+}
+
+const uint64_t *Link::getSlotWords(int core, int mode) const {
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error("Cannot get slot words in core out of bounds.");
+
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error("Cannot get slot words in mode out of bounds.");
+
+  return this->slotWords.data() +
+         this->spectrumOf(core, mode) * this->wordStride;
+}
+
+int Link::getWordStride(void) const { return this->wordStride; }
+
+void Link::setSpectrumIndex(bool enabled) {
+  this->indexed = enabled;
+  this->spectrumIndex.clear();
+  if (!enabled) return;
+  for (unsigned int i = 0; i + 1 < this->offsets.size(); i++) {
+    this->spectrumIndex.push_back(SpectrumIndex(
+        std::vector<bool>(this->slots.begin() + this->offsets[i],
+                          this->slots.begin() + this->offsets[i + 1])));
+  }
+}
+
+bool Link::hasSpectrumIndex(void) const { return this->indexed; }
+
+const SpectrumIndex &Link::getSpectrumIndex(void) const {
+  return this->getSpectrumIndex(0, 0);
+}
+
+const SpectrumIndex &Link::getSpectrumIndex(int core, int mode) const {
+  if (!this->indexed)
+    throw std::runtime_error("The spectrum index of the link is not enabled.");
+
+  if (core < 0 || core >= this->getCores())
+    throw std::runtime_error("Cannot get spectrum index in core out of bounds.");
+
+  if (mode < 0 || mode >= this->getModes())
+    throw std::runtime_error("Cannot get spectrum index in mode out of bounds.");
+
+  return this->spectrumIndex[this->spectrumOf(core, mode)];
+}
+
+void Link::updateFreeBlocks(int spectrum, int pos, bool value) {
+  // Called before the slot changes its state
+  this->slotWords[spectrum * this->wordStride + pos / 64] ^=
+      uint64_t(1) << (pos % 64);
+  if (!this->coreAdjacency.empty()) {
+    this->updateNeighbors(spectrum, pos, value ? 1 : -1);
+  }
+  if (this->indexed) {
+    if (value) {
+      this->spectrumIndex[spectrum].allocate(pos, 1);
+    } else {
+      this->spectrumIndex[spectrum].release(pos, 1);
+    }
+  }
+  this->changeMetrics(this->spectrumMetrics(spectrum), -1);
+  int offset = this->offsets[spectrum];
+  std::vector<bool>::const_iterator state = this->slots.begin() + offset;
+  std::vector<int> &blocks = this->freeBlocks[spectrum];
+  this->freeSlots[spectrum] += value ? -1 : 1;
+  int *start = &this->blockStart[0] + offset;
+  int *end = &this->blockEnd[0] + offset;
+  int &largest = this->largestFreeBlock[spectrum];
+  int size = this->offsets[spectrum + 1] - offset;
+  if (value) {
+    // The free block that holds pos is split in two. Allocations usually
+    // start on an edge of a block; otherwise the nearest edge is searched
+    int first, last;
+    if (pos == 0 || state[pos - 1]) {
+      first = pos;
+      last = end[pos];
+    } else if (pos == size - 1 || state[pos + 1]) {
+      last = pos;
+      first = start[pos];
+    } else {
+      for (int d = 1;; d++) {
+        if (pos - d == 0 || state[pos - d - 1]) {
+          first = pos - d;
+          last = end[first];
+          break;
+        }
+        if (pos + d == size - 1 || state[pos + d + 1]) {
+          last = pos + d;
+          first = start[last];
+          break;
+        }
+      }
+    }
+    this->changeFreeBlocks(spectrum, last - first + 1, -1);
+    if (first < pos) {
+      this->changeFreeBlocks(spectrum, pos - first, 1);
+      end[first] = pos - 1;
+      start[pos - 1] = first;
+    }
+    if (pos < last) {
+      this->changeFreeBlocks(spectrum, last - pos, 1);
+      start[last] = pos + 1;
+      end[pos + 1] = last;
+    }
+    while (largest > 0 && blocks[largest] == 0) largest--;
+  } else {
+    // The slot joins the free blocks next to it
+    int first = pos;
+    int last = pos;
+    if (pos > 0 && !state[pos - 1]) {
+      first = start[pos - 1];
+      this->changeFreeBlocks(spectrum, pos - first, -1);
+    }
+    if (pos < size - 1 && !state[pos + 1]) {
+      last = end[pos + 1];
+      this->changeFreeBlocks(spectrum, last - pos, -1);
+    }
+    this->changeFreeBlocks(spectrum, last - first + 1, 1);
+    end[first] = last;
+    start[last] = first;
+    if (last - first + 1 > largest) largest = last - first + 1;
+  }
+  this->changeMetrics(this->spectrumMetrics(spectrum), 1);
+}
+
+void Link::changeFreeBlocks(int spectrum, int length, int delta) {
+  this->freeBlocks[spectrum][length] += delta;
+  this->numberOfFreeBlocks[spectrum] += delta;
+  this->blockEntropy[spectrum] += delta * this->blockLogs[length];
+}
+
+FragmentationSums Link::spectrumMetrics(int spectrum) const {
+  // The same metrics of getExternalFragmentation and getSpectrumEntropy,
+  // with ln S taken from the table of b ln b
+  FragmentationSums value;
+  int size = this->offsets[spectrum + 1] - this->offsets[spectrum];
+  int free = this->freeSlots[spectrum];
+  if (free > 0)
+    value.externalFragmentation =
+        1 - this->largestFreeBlock[spectrum] / static_cast<double>(free);
+  value.spectrumEntropy =
+      (free * (this->blockLogs[size] / size) - this->blockEntropy[spectrum]) /
+      size;
+  value.freeBlocks = this->numberOfFreeBlocks[spectrum];
+  value.spectra = 1;
+  return value;
+}
+
+void Link::changeMetrics(const FragmentationSums &delta, int sign) {
+  this->metrics.externalFragmentation += sign * delta.externalFragmentation;
+  this->metrics.spectrumEntropy += sign * delta.spectrumEntropy;
+  this->metrics.freeBlocks += sign * delta.freeBlocks;
+  this->metrics.spectra += sign * delta.spectra;
+}
+/*
+    __ _____ _____ _____
+ __|  |   __|     |   | |  JSON for Modern C++
+|  |  |__   |  |  | | | |  version 3.9.1
+|_____|_____|_____|_|___|  https://github.com/nlohmann/json
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2013-2019 Niels Lohmann <http://nlohmann.me>.
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef INCLUDE_NLOHMANN_JSON_HPP_
+#define INCLUDE_NLOHMANN_JSON_HPP_
+
+#define NLOHMANN_JSON_VERSION_MAJOR 3
+#define NLOHMANN_JSON_VERSION_MINOR 9
+#define NLOHMANN_JSON_VERSION_PATCH 1
+
+#include <algorithm> // all_of, find, for_each
+#include <cstddef> // nullptr_t, ptrdiff_t, size_t
+#include <functional> // hash, less
+#include <initializer_list> // initializer_list
+#include <iosfwd> // istream, ostream
+#include <iterator> // random_access_iterator_tag
+#include <memory> // unique_ptr
+#include <numeric> // accumulate
+#include <string> // string, stoi, to_string
+#include <utility> // declval, forward, move, pair, swap
+#include <vector> // vector
+
+// #include <nlohmann/adl_serializer.hpp>
+
+
+#include <utility>
+
+// #include <nlohmann/detail/conversions/from_json.hpp>
+
+
+#include <algorithm> // transform
+#include <array> // array
+#include <forward_list> // forward_list
+#include <iterator> // inserter, front_inserter, end
+#include <map> // map
+#include <string> // string
+#include <tuple> // tuple, make_tuple
+#include <type_traits> // is_arithmetic, is_same, is_enum, underlying_type, is_convertible
+#include <unordered_map> // unordered_map
+#include <utility> // pair, declval
+#include <valarray> // valarray
+
+// #include <nlohmann/detail/exceptions.hpp>
+
+
+#include <exception> // exception
+#include <stdexcept> // runtime_error
+#include <string> // to_string
+
+// #include <nlohmann/detail/input/position_t.hpp>
+
+
+#include <cstddef> // size_t
+
+namespace nlohmann
+{
+namespace detail
+{
+/// struct to capture the start position of the current token
+struct position_t
+{
+    /// the total number of characters read
+    std::size_t chars_read_total = 0;
+    /// the number of characters read in the current line
+    std::size_t chars_read_current_line = 0;
+    /// the number of lines read
+    std::size_t lines_read = 0;
+
+    /// conversion to size_t to preserve SAX interface
+    constexpr operator size_t() const
+    {
+        return chars_read_total;
+    }
+};
+
+} // namespace detail
+} // namespace nlohmann
+
+// #include <nlohmann/detail/macro_scope.hpp>
+
+
+#include <utility> // pair
+// #include <nlohmann/thirdparty/hedley/hedley.hpp>
+/* Hedley - https://nemequ.github.io/hedley
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * For details, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#if !defined(JSON_HEDLEY_VERSION) || (JSON_HEDLEY_VERSION < 14)
+#if defined(JSON_HEDLEY_VERSION)
+    #undef JSON_HEDLEY_VERSION
+#endif
+#define JSON_HEDLEY_VERSION 14
+
+#if defined(JSON_HEDLEY_STRINGIFY_EX)
+    #undef JSON_HEDLEY_STRINGIFY_EX
+#endif
+#define JSON_HEDLEY_STRINGIFY_EX(x) #x
 
 #if defined(JSON_HEDLEY_STRINGIFY)
     #undef JSON_HEDLEY_STRINGIFY
@@ -26301,8 +27831,13 @@ inline nlohmann::json::json_pointer operator "" _json_pointer(const char* s, std
 
 #ifndef __EXP_VARIABLE_H__
 #define __EXP_VARIABLE_H__
+#define INVERSION 1
+#define ZIGGURAT 2
 
+#include <cmath>
+#include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 // #include "random_variable.hpp"
 /**
@@ -26333,6 +27868,14 @@ class ExpVariable : public RandomVariable {
    * @param parameter1 the parameter value. It must be a positive number.
    */
   ExpVariable(unsigned int seed, double parameter1);
+  /**
+   * @brief Constructs a new Exponential Variable object that uses a counter
+   * based generator.
+   *
+   * @param generator the PhiloxEngine, already placed on its stream.
+   * @param parameter1 the parameter value. It must be a positive number.
+   */
+  ExpVariable(PhiloxEngine generator, double parameter1);
   /**
    * @brief Generates a new value according to an exponential distribution
    * inside the ExpVariable object. Said object must have been previously
@@ -26342,40 +27885,197 @@ class ExpVariable : public RandomVariable {
    * @return double the new exponential variable value.
    */
   double getNextValue(void);
+  /**
+   * @brief Generates the value of the given index of an exponential
+   * distribution. The same index always gives the same value, independently
+   * of the order in which the values are requested. Only available with the
+   * PHILOX engine.
+   *
+   * @param index the index of the value.
+   * @return double the exponential variable value.
+   */
+  double getValueAt(long long index);
+  /**
+   * @brief Set the method used to fill the buffer when the values are
+   * batched (see setBatchSize):
+   * -INVERSION: a block of uniform numbers is drawn and transformed with
+   * -log(U) in a separate loop, which the compiler can vectorize.
+   * -ZIGGURAT (default): the Marsaglia-Tsang ziggurat with 256 layers. About
+   * 99% of the values only need a table lookup and a product, the remaining
+   * ones fall back to a scalar path with exp/log. The low 8 bits of each
+   * random number pick the layer and the high 24 bits the position on it,
+   * so the two aren't correlated. The ziggurat isn't monotone on its input,
+   * so antithetic variables should use INVERSION.
+   *
+   * @param method INVERSION or ZIGGURAT.
+   */
+  void setMethod(int method);
+  /**
+   * @brief Get the method used to fill the buffer of batched values.
+   *
+   * @return int INVERSION or ZIGGURAT.
+   */
+  int getMethod(void) const;
+
+ protected:
+  void fillBatch(void);
+
+ private:
+  struct ZigguratTables {
+    uint32_t k[256];
+    double w[256];
+    double f[256];
+    ZigguratTables(void);
+  };
+  static const ZigguratTables &ziggurat(void);
+  /**
+   * @brief Slow path of the ziggurat, for values that are outside of the
+   * rectangle of their layer. The result has rate 1.
+   *
+   * @param bits the random bits that failed the fast path (layer on the low
+   * 8 bits, position on the high 24).
+   * @return double the exponential value.
+   */
+  double zigguratSlow(uint32_t bits);
+  int method;
+  std::vector<uint32_t> bits;
 };
 
 #endif
 // #include "exp_variable.hpp"
 
-ExpVariable::ExpVariable(void) : RandomVariable() {}
+ExpVariable::ExpVariable(void) : RandomVariable() { this->method = ZIGGURAT; }
 
 ExpVariable::ExpVariable(unsigned int seed, double parameter1)
     : RandomVariable(seed, parameter1) {
   if (parameter1 <= 0) {
     throw std::runtime_error("Lambda parameter must be positive.");
   }
+  this->method = ZIGGURAT;
+}
+
+ExpVariable::ExpVariable(PhiloxEngine generator, double parameter1)
+    : RandomVariable(generator, parameter1) {
+  if (parameter1 <= 0) {
+    throw std::runtime_error("Lambda parameter must be positive.");
+  }
+  this->method = ZIGGURAT;
 }
 
 double ExpVariable::getNextValue() {
-  return (-log(1 - dist(this->generator)) / this->parameter1);
+  if (this->batchSize > 0) return this->nextBatchValue();
+  return (-log(1 - this->nextUniform()) / this->parameter1);
 }
 
-#ifndef __BITRATE_H__
-#define __BITRATE_H__
+double ExpVariable::getValueAt(long long index) {
+  return -log(this->uniformAt(index)) / this->parameter1;
+}
 
-#include <string>
-#include <vector>
+void ExpVariable::setMethod(int method) {
+  if (method != INVERSION && method != ZIGGURAT) {
+    throw std::runtime_error("Unknown exponential method " +
+                             std::to_string(method) + ".");
+  }
+  this->method = method;
+  // Values already generated with the previous method are discarded
+  this->batchPosition = this->batchSize;
+}
 
-// #include "json.hpp"
+int ExpVariable::getMethod(void) const { return this->method; }
+
+ExpVariable::ZigguratTables::ZigguratTables(void) {
+  // Marsaglia & Tsang (2000), "The Ziggurat Method for Generating Random
+  // Variables", tables of the exponential distribution. The position on a
+  // layer has 24 bits, the other 8 of the random number are the layer
+  const double m2 = 16777216.0;
+  const double v = 3.949659822581572e-3;
+  double d = 7.697117470131487;
+  double t = d;
+  double q = v / exp(-d);
+  this->k[0] = static_cast<uint32_t>((d / q) * m2);
+  this->k[1] = 0;
+  this->w[0] = q / m2;
+  this->w[255] = d / m2;
+  this->f[0] = 1.0;
+  this->f[255] = exp(-d);
+  for (int i = 254; i >= 1; i--) {
+    d = -log(v / d + exp(-d));
+    this->k[i + 1] = static_cast<uint32_t>((d / t) * m2);
+    t = d;
+    this->f[i] = exp(-d);
+    this->w[i] = d / m2;
+  }
+}
 
-/**
- * @brief Class BitRate
- *
- * The BitRate class is used to represent the Bit Rate, which is the amount of
- * data transmitted/processed (in bits) per unit of time inside a digital
- * transmission system or a computer network (and, for simulation purposes,
- * inside the Simulator (class) itself.)
- *
+const ExpVariable::ZigguratTables &ExpVariable::ziggurat(void) {
+  static const ZigguratTables tables;
+  return tables;
+}
+
+double ExpVariable::zigguratSlow(uint32_t bits) {
+  const ZigguratTables &z = ExpVariable::ziggurat();
+  const double twoPow32Inv = 2.3283064365386963e-10;
+  uint32_t layer = bits & 255;
+  uint32_t position = bits >> 8;
+  while (true) {
+    // The base layer holds the tail, which is again exponential past r
+    if (layer == 0) {
+      return 7.697117470131487 - log((this->nextBits() + 0.5) * twoPow32Inv);
+    }
+    double x = position * z.w[layer];
+    double u = (this->nextBits() + 0.5) * twoPow32Inv;
+    if (z.f[layer] + u * (z.f[layer - 1] - z.f[layer]) < exp(-x)) return x;
+    bits = this->nextBits();
+    layer = bits & 255;
+    position = bits >> 8;
+    if (position < z.k[layer]) return position * z.w[layer];
+  }
+}
+
+void ExpVariable::fillBatch(void) {
+  const double scale = 1.0 / this->parameter1;
+  const double twoPow32Inv = 2.3283064365386963e-10;
+  int n = this->batchSize;
+  if (static_cast<int>(this->bits.size()) != n) this->bits.resize(n);
+  uint32_t *b = this->bits.data();
+  double *values = this->batch.data();
+  for (int i = 0; i < n; i++) b[i] = this->nextBits();
+  if (this->method == INVERSION) {
+    // (b + 0.5) / 2^32 is in (0, 1), so the logarithm is always finite
+    for (int i = 0; i < n; i++) {
+      values[i] = -log((b[i] + 0.5) * twoPow32Inv) * scale;
+    }
+    return;
+  }
+  // The fast path is branch free, so it's computed for every value and the
+  // few rejected ones are overwritten afterwards
+  const ZigguratTables &z = ExpVariable::ziggurat();
+  for (int i = 0; i < n; i++) {
+    values[i] = (b[i] >> 8) * z.w[b[i] & 255] * scale;
+  }
+  for (int i = 0; i < n; i++) {
+    if ((b[i] >> 8) >= z.k[b[i] & 255]) {
+      values[i] = this->zigguratSlow(b[i]) * scale;
+    }
+  }
+}
+
+#ifndef __BITRATE_H__
+#define __BITRATE_H__
+
+#include <string>
+#include <vector>
+
+// #include "json.hpp"
+
+/**
+ * @brief Class BitRate
+ *
+ * The BitRate class is used to represent the Bit Rate, which is the amount of
+ * data transmitted/processed (in bits) per unit of time inside a digital
+ * transmission system or a computer network (and, for simulation purposes,
+ * inside the Simulator (class) itself.)
+ *
  * A Bit Rate of certain magnitude can be represented in different modulation
  * formats, each with it's own number of slots and maximum reach.
  *
@@ -26658,6 +28358,7 @@ int BitRate::getNumberOfModulations() { return this->modulation.size(); }
 #ifndef __UNIFORM_VARIABLE_H__
 #define __UNIFORM_VARIABLE_H__
 
+#include <cmath>
 #include <stdexcept>
 
 // #include "random_variable.hpp"
@@ -26690,6 +28391,15 @@ class UniformVariable : public RandomVariable {
    * must be a positive number.
    */
   UniformVariable(unsigned int seed, double parameter1);
+  /**
+   * @brief Constructs a new Uniform Variable object that uses a counter based
+   * generator.
+   *
+   * @param generator the PhiloxEngine, already placed on its stream.
+   * @param parameter1 the upper bound of the uniform distribution interval. It
+   * must be a positive number.
+   */
+  UniformVariable(PhiloxEngine generator, double parameter1);
   /**
    * @brief Generates a new value according to an uniform distribution on the
    * established interval of the UniformVariable object. Said object must have
@@ -26706,6 +28416,19 @@ class UniformVariable : public RandomVariable {
    * @return double the new uniform variable value.
    */
   double getNextIntValue(void);
+  /**
+   * @brief Generates the value of the given index of an uniform distribution
+   * on the established interval. The same index always gives the same value,
+   * independently of the order in which the values are requested. Only
+   * available with the PHILOX engine.
+   *
+   * @param index the index of the value.
+   * @return double the uniform variable value.
+   */
+  double getIntValueAt(long long index);
+
+ protected:
+  void fillBatch(void);
 
  private:
   std::uniform_int_distribution<int> dist;
@@ -26720,19 +28443,52 @@ UniformVariable::UniformVariable(unsigned int seed, double parameter1) {
   if (parameter1 < 0) {
     throw std::runtime_error("Parameter 1  must be positive.");
   }
+  this->engine = MT19937;
   this->generator = std::mt19937(seed);
   this->parameter1 = parameter1;
   this->dist = std::uniform_int_distribution<int>(0, this->parameter1);
 }
 
-double UniformVariable::getNextValue(void) { return dist(this->generator); }
+UniformVariable::UniformVariable(PhiloxEngine generator, double parameter1)
+    : RandomVariable(generator, parameter1) {
+  if (parameter1 < 0) {
+    throw std::runtime_error("Parameter 1  must be positive.");
+  }
+  this->dist = std::uniform_int_distribution<int>(0, this->parameter1);
+}
+
+double UniformVariable::getNextValue(void) { return this->getNextIntValue(); }
+
+double UniformVariable::getNextIntValue(void) {
+  if (this->batchSize > 0) return this->nextBatchValue();
+  int value =
+      this->engine == PHILOX ? dist(this->philox) : dist(this->generator);
+  // The antithetic of an uniform integer on [0, p] is p - X
+  return this->antithetic ? this->parameter1 - value : value;
+}
+
+double UniformVariable::getIntValueAt(long long index) {
+  return floor(this->uniformAt(index) * (this->parameter1 + 1));
+}
 
-double UniformVariable::getNextIntValue(void) { return dist(this->generator); }
+void UniformVariable::fillBatch(void) {
+  double *values = this->batch.data();
+  if (this->engine == PHILOX) {
+    for (int i = 0; i < this->batchSize; i++) values[i] = dist(this->philox);
+  } else {
+    for (int i = 0; i < this->batchSize; i++) {
+      values[i] = dist(this->generator);
+    }
+  }
+  if (this->antithetic) {
+    for (int i = 0; i < this->batchSize; i++) {
+      values[i] = this->parameter1 - values[i];
+    }
+  }
+}
 
 #ifndef __NETWORK_H__
 #define __NETWORK_H__
-#define EON 1
-#define SDM 2
 
 // #include "link.hpp"
 // #include "node.hpp"
@@ -26775,6 +28531,8 @@ class Network {
     * (dst), the length of the link and the number of slots. With SDM it must contain the link id, the source node (src), the destination node (dst), the
     * number of cores, number of modes, the length of the link and a list of lists containing the number of slots, where the first dimension correspond to the
     * cores and the second dimension correspond to the modes (eg. "slots": [[320, 100], [100, 320], [100, 100]]).
+    * Optionally, an SDM link can declare which cores of its fibre are adjacent, for crosstalk
+    * (eg. "core_adjacency": [[1, 2], [0, 2], [0, 1]] for three cores in a triangle, see Link::setCoreAdjacency).
     *
     * In the example above, the node 0 goes to the nodes 1 and 2. The node 1 goes
     * to the node 2. They are connected by
@@ -26827,7 +28585,7 @@ class Network {
 
         \endcode
     */
-  Network(std::string filename, int networkType = EON);
+  Network(std::string filename, int networkType = DEFAULT_NETWORK_TYPE);
   /**
    * @brief Constructs a new Network object that represents a (deep) copy of an
    * already existing Network object. The new Network object is allocated via
@@ -26837,7 +28595,7 @@ class Network {
    * @param net the original Network to be (deep) copied into a
    * new Network object. The original Network doesn't get modified.
    */
-  Network(const Network &net, int networkType = EON);
+  Network(const Network &net, int networkType = DEFAULT_NETWORK_TYPE);
   /**
    * @brief Adds a new Node object to the Network object. To add a new Node to a
    * Network, the new Node's Id must match the amount of nodes that were already
@@ -26913,6 +28671,9 @@ class Network {
    * @brief The useSlot method activates a single Slot of a given position
    * inside a Link of a given position inside the Network.
    *
+   * Like every slot operation of the Network, the bounds and the state of the
+   * slots are only checked on BUFFEREON_CHECKED builds.
+   *
    * @param linkPos the position of the Link inside the links vector.
    * @param slotPos the position of the single Slot to be used/activated inside
    * the slot vector.
@@ -27135,6 +28896,57 @@ class Network {
    * @return float The Nodal Variance value of average neighborhood
    */
   float nodalVariance();
+  /**
+   * @brief Get the external fragmentation of the Network, the mean of the
+   * external fragmentation of every core and mode of its Links (see
+   * Link::getExternalFragmentation). Every Link keeps the sums of the
+   * metrics of its cores and modes up to date on every change of a slot, so
+   * it costs O(1) per Link.
+   *
+   * @return double The external fragmentation between 0 and 1.
+   */
+  double getExternalFragmentation(void);
+  /**
+   * @brief Get the external fragmentation of a route, the mean of the
+   * external fragmentation of every core and mode of its Links.
+   *
+   * @param route the Links of the route.
+   * @return double The external fragmentation between 0 and 1.
+   */
+  double getExternalFragmentation(const std::vector<Link *> &route);
+  /**
+   * @brief Get the spectrum entropy of the Network, the mean of the spectrum
+   * entropy of every core and mode of its Links (see
+   * Link::getSpectrumEntropy). It costs O(1) per Link, as
+   * getExternalFragmentation.
+   *
+   * @return double The spectrum entropy in nats.
+   */
+  double getSpectrumEntropy(void);
+  /**
+   * @brief Get the spectrum entropy of a route, the mean of the spectrum
+   * entropy of every core and mode of its Links.
+   *
+   * @param route the Links of the route.
+   * @return double The spectrum entropy in nats.
+   */
+  double getSpectrumEntropy(const std::vector<Link *> &route);
+  /**
+   * @brief Get the mean number of free blocks of every core and mode of the
+   * Links of the Network (see Link::getNumberOfFreeBlocks). It costs O(1) per
+   * Link, as getExternalFragmentation.
+   *
+   * @return double The mean number of free blocks.
+   */
+  double getNumberOfFreeBlocks(void);
+  /**
+   * @brief Get the mean number of free blocks of every core and mode of the
+   * Links of a route.
+   *
+   * @param route the Links of the route.
+   * @return double The mean number of free blocks.
+   */
+  double getNumberOfFreeBlocks(const std::vector<Link *> &route);
 
  private:
   std::vector<Node *> nodes;
@@ -27147,10 +28959,15 @@ class Network {
   int nodeCounter;
   int networkType;
 
+  FragmentationSums sumMetrics(const std::vector<Link *> &links);
+
   void validateSlotFromTo(int linkPos, int slotFrom, int slotTo);
 
   void validateSlotFromTo(int linkPos, int core, int mode, int slotFrom, int slotTo);
 
+  void validateSlotState(int linkPos, int core, int mode, int slotFrom,
+                         int slotTo, bool value);
+
   void readEON(std::string filename);
 
   void readSDM(std::string filename);
@@ -27165,7 +28982,7 @@ class Network {
 #include <set>
 #include <unordered_map>
 
-Network::Network(void) : networkType(1)  {
+Network::Network(void) : networkType(DEFAULT_NETWORK_TYPE)  {
   this->linkCounter = 0;
   this->nodeCounter = 0;
 
@@ -27181,6 +28998,10 @@ Network::Network(void) : networkType(1)  {
 }
 
 Network::Network(std::string filename, int networkType) : networkType(networkType) {
+#ifdef SINGLE_SPECTRUM
+  if (networkType == SDM)
+    throw std::runtime_error("Cannot read an SDM network on an EON build.");
+#endif
   switch (networkType) {
     case EON:
       readEON(filename);
@@ -27298,6 +29119,10 @@ void Network::readSDM(std::string filename) {
         link->setSlots(slots, j, k);
       }      
     }
+    if (NSFnet["links"][i].contains("core_adjacency")) {
+      link->setCoreAdjacency(NSFnet["links"][i]["core_adjacency"]
+                                 .get<std::vector<std::vector<int>>>());
+    }
     this->addLink(link);
 
     // connecting nodes
@@ -27355,7 +29180,13 @@ Link *Network::getLink(int linkPos) {
 int Network::getNetworkType() { return this->networkType; }
 // Returns the int that represents the network type of the object
 
-void Network::setNetworkType(int networkType) { this->networkType = networkType; }
+void Network::setNetworkType(int networkType) {
+#ifdef SINGLE_SPECTRUM
+  if (networkType == SDM)
+    throw std::runtime_error("Cannot set an SDM network on an EON build.");
+#endif
+  this->networkType = networkType;
+}
 // Returns the int that represents the network type of the object
 
 void Network::addNode(Node *node) {
@@ -27429,56 +29260,72 @@ int Network::isConnected(int src, int dst) {
 }
 
 void Network::useSlot(int linkPos, int slotPos) {
-  if (linkPos < 0 || linkPos >= static_cast<int>(this->links.size()))
+  if (CHECK_SLOTS &&
+      (linkPos < 0 || linkPos >= static_cast<int>(this->links.size())))
     throw std::runtime_error("Link position out of bounds.");
 
   this->links[linkPos]->setSlot(slotPos, true);
 }
 
 void Network::useSlot(int linkPos, int core, int mode, int slotPos) {
-  if (linkPos < 0 || linkPos >= static_cast<int>(this->links.size()))
+  if (CHECK_SLOTS &&
+      (linkPos < 0 || linkPos >= static_cast<int>(this->links.size())))
     throw std::runtime_error("Link position out of bounds.");
 
   this->links[linkPos]->setSlot(core, mode, slotPos, true);
 }
 
 void Network::useSlot(int linkPos, int slotFrom, int slotTo) {
-  this->validateSlotFromTo(linkPos, slotFrom, slotTo);
+  if (CHECK_SLOTS) {
+    this->validateSlotFromTo(linkPos, slotFrom, slotTo);
+    this->validateSlotState(linkPos, 0, 0, slotFrom, slotTo, true);
+  }
 
   for (int i = slotFrom; i < slotTo; i++)
     this->links[linkPos]->setSlot(i, true);
 }
 
 void Network::useSlot(int linkPos, int core, int mode, int slotFrom, int slotTo) {
-  this->validateSlotFromTo(linkPos, core, mode, slotFrom, slotTo);
+  if (CHECK_SLOTS) {
+    this->validateSlotFromTo(linkPos, core, mode, slotFrom, slotTo);
+    this->validateSlotState(linkPos, core, mode, slotFrom, slotTo, true);
+  }
 
   for (int i = slotFrom; i < slotTo; i++)
     this->links[linkPos]->setSlot(core, mode, i, true);
 }
 
 void Network::unuseSlot(int linkPos, int slotPos) {
-  if (linkPos < 0 || linkPos >= static_cast<int>(this->links.size()))
+  if (CHECK_SLOTS &&
+      (linkPos < 0 || linkPos >= static_cast<int>(this->links.size())))
     throw std::runtime_error("Link position out of bounds.");
 
   this->links[linkPos]->setSlot(slotPos, false);
 }
 
 void Network::unuseSlot(int linkPos, int core, int mode, int slotPos) {
-  if (linkPos < 0 || linkPos >= static_cast<int>(this->links.size()))
+  if (CHECK_SLOTS &&
+      (linkPos < 0 || linkPos >= static_cast<int>(this->links.size())))
     throw std::runtime_error("Link position out of bounds.");
 
   this->links[linkPos]->setSlot(core, mode, slotPos, false);
 }
 
 void Network::unuseSlot(int linkPos, int slotFrom, int slotTo) {
-  this->validateSlotFromTo(linkPos, slotFrom, slotTo);
+  if (CHECK_SLOTS) {
+    this->validateSlotFromTo(linkPos, slotFrom, slotTo);
+    this->validateSlotState(linkPos, 0, 0, slotFrom, slotTo, false);
+  }
 
   for (int i = slotFrom; i < slotTo; i++)
     this->links[linkPos]->setSlot(i, false);
 }
 
 void Network::unuseSlot(int linkPos, int core, int mode, int slotFrom, int slotTo) {
-  this->validateSlotFromTo(linkPos, core, mode, slotFrom, slotTo);
+  if (CHECK_SLOTS) {
+    this->validateSlotFromTo(linkPos, core, mode, slotFrom, slotTo);
+    this->validateSlotState(linkPos, core, mode, slotFrom, slotTo, false);
+  }
 
   for (int i = slotFrom; i < slotTo; i++)
     this->links[linkPos]->setSlot(core, mode, i, false);
@@ -27567,6 +29414,46 @@ float Network::nodalVariance() {
   return result;
 }
 
+FragmentationSums Network::sumMetrics(const std::vector<Link *> &links) {
+  FragmentationSums sums;
+  for (unsigned int i = 0; i < links.size(); i++) {
+    sums.externalFragmentation += links[i]->metrics.externalFragmentation;
+    sums.spectrumEntropy += links[i]->metrics.spectrumEntropy;
+    sums.freeBlocks += links[i]->metrics.freeBlocks;
+    sums.spectra += links[i]->metrics.spectra;
+  }
+  return sums;
+}
+
+double Network::getExternalFragmentation(void) {
+  return this->getExternalFragmentation(this->links);
+}
+
+double Network::getExternalFragmentation(const std::vector<Link *> &route) {
+  FragmentationSums sums = this->sumMetrics(route);
+  return sums.spectra > 0 ? sums.externalFragmentation / sums.spectra : 0;
+}
+
+double Network::getSpectrumEntropy(void) {
+  return this->getSpectrumEntropy(this->links);
+}
+
+double Network::getSpectrumEntropy(const std::vector<Link *> &route) {
+  FragmentationSums sums = this->sumMetrics(route);
+  return sums.spectra > 0 ? sums.spectrumEntropy / sums.spectra : 0;
+}
+
+double Network::getNumberOfFreeBlocks(void) {
+  return this->getNumberOfFreeBlocks(this->links);
+}
+
+double Network::getNumberOfFreeBlocks(const std::vector<Link *> &route) {
+  FragmentationSums sums = this->sumMetrics(route);
+  return sums.spectra > 0
+             ? sums.freeBlocks / static_cast<double>(sums.spectra)
+             : 0;
+}
+
 void Network::validateSlotFromTo(int linkPos, int slotFrom, int slotTo) {
   if (linkPos < 0 || linkPos >= static_cast<int>(this->links.size()))
     throw std::runtime_error("Link position out of bounds.");
@@ -27574,7 +29461,7 @@ void Network::validateSlotFromTo(int linkPos, int slotFrom, int slotTo) {
       slotFrom >= static_cast<int>(this->links[linkPos]->getSlots()))
     throw std::runtime_error("slot position out of bounds.");
   if (slotTo < 0 ||
-      slotTo >= static_cast<int>(this->links[linkPos]->getSlots()))
+      slotTo > static_cast<int>(this->links[linkPos]->getSlots()))
     throw std::runtime_error("slot position out of bounds.");
   if (slotFrom > slotTo)
     throw std::runtime_error(
@@ -27591,7 +29478,7 @@ void Network::validateSlotFromTo(int linkPos, int core, int mode, int slotFrom,
       slotFrom >= static_cast<int>(this->links[linkPos]->getSlots(core, mode)))
     throw std::runtime_error("slot position out of bounds.");
   if (slotTo < 0 ||
-      slotTo >= static_cast<int>(this->links[linkPos]->getSlots(core, mode)))
+      slotTo > static_cast<int>(this->links[linkPos]->getSlots(core, mode)))
     throw std::runtime_error("slot position out of bounds.");
   if (slotFrom > slotTo)
     throw std::runtime_error(
@@ -27600,6 +29487,15 @@ void Network::validateSlotFromTo(int linkPos, int core, int mode, int slotFrom,
   if (slotFrom == slotTo)
     throw std::runtime_error("Slot from and slot To cannot be equals.");
 }
+
+void Network::validateSlotState(int linkPos, int core, int mode, int slotFrom,
+                                int slotTo, bool value) {
+  // The whole range is checked before any slot changes, so a range operation
+  // either changes every slot or none
+  if (!this->links[linkPos]->isRangeInState(core, mode, slotFrom, slotTo,
+                                            !value))
+    throw std::runtime_error("Slot already setted in desired state.");
+}
 #ifndef __CONNECTION_H__
 #define __CONNECTION_H__
 
@@ -27622,6 +29518,12 @@ class Connection {
    * @param id the id of the new connection object.
    */
   Connection(long long id, double time, BitRate *bitRate);
+  // Declared because of the destructor, so connections are moved and not
+  // copied when the containers of the Controller grow or shift
+  Connection(const Connection &connection) = default;
+  Connection(Connection &&connection) = default;
+  Connection &operator=(const Connection &connection) = default;
+  Connection &operator=(Connection &&connection) = default;
   /**
    * @brief Destroys the Connection object.
    *
@@ -27645,9 +29547,34 @@ class Connection {
    * @param toSlot the position of the last slot to be taken on the link.
    */
   void addLink(int idLink, int fromSlot, int toSlot);
+  /**
+   * @brief Adds a new link to the Connection object, taking the slots in the
+   * range fromSlot-toSlot of a core and mode of the link.
+   *
+   * @param idLink the id of the new link added to the connection object.
+   * @param core the core of the link.
+   * @param mode the mode of the core.
+   * @param fromSlot the position of the first slot to be taken on the link.
+   * @param toSlot the position of the last slot to be taken on the link.
+   */
+  void addLink(int idLink, int core, int mode, int fromSlot, int toSlot);
 
-  std::vector<int> getLinks(void);
+  const std::vector<int> &getLinks(void);
   std::vector<std::vector<int> > getSlots(void);
+  /**
+   * @brief Get the core used on every link of the connection, in the order
+   * of getLinks. It's 0 for links added without a core.
+   *
+   * @return std::vector<int> the cores.
+   */
+  std::vector<int> getCores(void);
+  /**
+   * @brief Get the mode used on every link of the connection, in the order
+   * of getLinks. It's 0 for links added without a mode.
+   *
+   * @return std::vector<int> the modes.
+   */
+  std::vector<int> getModes(void);
   double getTimeConnection(void);
   BitRate *getBitrate(void);
   long long getId(void);
@@ -27658,8 +29585,16 @@ class Connection {
   BitRate *bitRate;
   std::vector<int> links;
   std::vector<std::vector<int> > slots;
+  std::vector<int> cores;
+  std::vector<int> modes;
+
+  // Empties the connection to reuse it with another id. The slots vector
+  // isn't shrunk: its first links.size() elements are the slots of the
+  // links, and the rest keep their storage for the next links added
+  void recycle(long long id, double time, BitRate *bitRate);
 
   friend class Controller;
+  friend class SpectrumSnapshot;
 };
 #endif
 // #include "connection.hpp"
@@ -27675,340 +29610,3051 @@ Connection::Connection(long long id, double time, BitRate *bitRate) {
 Connection::~Connection() {}
 
 void Connection::addLink(int idLink, std::vector<int> slots) {
+  if (this->links.size() < this->slots.size()) {
+    this->slots[this->links.size()].swap(slots);
+  } else {
+    this->slots.push_back(std::move(slots));
+  }
   this->links.push_back(idLink);
-  this->slots.push_back(slots);
+  this->cores.push_back(0);
+  this->modes.push_back(0);
 }
 
 void Connection::addLink(int idLink, int fromSlot, int toSlot) {
+  this->addLink(idLink, 0, 0, fromSlot, toSlot);
+}
+
+void Connection::addLink(int idLink, int core, int mode, int fromSlot,
+                         int toSlot) {
+  if (this->links.size() == this->slots.size()) {
+    this->slots.push_back(std::vector<int>());
+  }
+  std::vector<int> &range = this->slots[this->links.size()];
+  range.resize(toSlot - fromSlot);
   this->links.push_back(idLink);
-  this->slots.push_back(std::vector<int>(toSlot - fromSlot));
+  this->cores.push_back(core);
+  this->modes.push_back(mode);
   int j = 0;
   for (int i = fromSlot; i < toSlot; i++) {
-    this->slots.back()[j] = i;
+    range[j] = i;
     j++;
   }
 }
 
-std::vector<int> Connection::getLinks(void) { return this->links; }
+void Connection::recycle(long long id, double time, BitRate *bitRate) {
+  this->id = id;
+  this->timeConnection = time;
+  this->bitRate = bitRate;
+  this->links.clear();
+  this->cores.clear();
+  this->modes.clear();
+}
+
+const std::vector<int> &Connection::getLinks(void) { return this->links; }
 std::vector<std::vector<int> > Connection::getSlots(void) {
-  return this->slots;
+  return std::vector<std::vector<int> >(
+      this->slots.begin(), this->slots.begin() + this->links.size());
 }
+std::vector<int> Connection::getCores(void) { return this->cores; }
+std::vector<int> Connection::getModes(void) { return this->modes; }
 
 double Connection::getTimeConnection(void) { return this->timeConnection; }
 BitRate *Connection::getBitrate(void) { return this->bitRate; }
 long long Connection::getId(void) { return this->id; }
-#ifndef __ALLOCATOR_H__
-#define __ALLOCATOR_H__
-#include <string>
+#ifndef __SPECTRUM_SNAPSHOT_H__
+#define __SPECTRUM_SNAPSHOT_H__
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
 
-// #include "bitrate.hpp"
 // #include "connection.hpp"
 // #include "network.hpp"
 
-typedef enum allocStatus { ALLOCATED, NOT_ALLOCATED, N_A } allocationStatus;
 /**
- * @brief Class with the allocator information.
+ * @brief Class with a what-if view of the spectrum of a Network.
  *
- * The Allocator class handles the assignment of connections inside a Network.
- * This class must be inherited by another class, in which a method to allocate
- * resources has to be implemented.
+ * A snapshot starts as a view of the slots of a Network (or of another
+ * snapshot, its parent) and can be modified without touching it, to try an
+ * allocation, evaluate the resulting state and then commit or discard it.
+ * It's copy-on-write: the packed slot words of a core and mode of a Link
+ * (see Link::getSlotWords), a page, are only copied the first time the
+ * snapshot modifies them. Every other read goes to the parent, so forking a
+ * snapshot costs O(links) and trying a placement only copies the pages of
+ * its links.
  *
- * The Allocator class consists of a Network object, a Path vector to the Links
- * inside said Network and a Name attribute and methods for setting them.
+ * The parent must not be modified while the snapshot is alive, and the
+ * pointers returned by getSlotWords are only valid until the next change of
+ * the snapshot.
  */
-class Allocator {
+class SpectrumSnapshot {
  public:
   /**
-   * @brief Constructs a new Allocator object that represents the default
-   * initialization of an Allocator invoked by calling the void constructor.
-   This
-   * constructor sets all the information about the Allocator's Networks and
-   Paths as
-   * empty so the Allocator is ready to be built from a clean state.
-
+   * @brief Constructs a new SpectrumSnapshot object of the current state of
+   * a Network.
+   *
+   * @param network the network whose spectrum is viewed.
    */
-  Allocator(void);
+  SpectrumSnapshot(Network *network);
   /**
-   * @brief Constructs a new Allocator object that represents the
-   * initialization of an Allocator with a given (already existing) Network
-   * to be set as the Allocator's own Network.
+   * @brief Constructs a new SpectrumSnapshot object of the current state of
+   * another snapshot, so hypothetical placements can be nested. Committing
+   * it applies its changes to the parent snapshot.
    *
-   * @param network the pointer to the Network object that will be set as the
-   * Allocator's own Network.
+   * @param parent the snapshot whose spectrum is viewed.
    */
-  Allocator(Network *network);
+  SpectrumSnapshot(SpectrumSnapshot *parent);
   /**
-   * @brief Set the Allocator's Network as the one given by the pointer of an
-   * already existing Network object.
+   * @brief Creates a child snapshot of the current state of this one.
    *
-   * @param network the pointer to the Network object that will be set as the
-   * Allocator's own Network.
+   * @return SpectrumSnapshot the child snapshot.
    */
-  void setNetwork(Network *network);
+  SpectrumSnapshot fork(void);
   /**
-   * @brief Set the Path attribute of the Allocator.
+   * @brief Get the state of the slots of a Link packed in 64 bit words, as
+   * seen by the snapshot.
    *
-   * @param path the pointer to the Path vector. This vector contains the
-   * information regarding the routes between the Nodes inside Network.
+   * This method assumes a single-mode/single-core network.
+   *
+   * @param link the id of the Link.
+   * @return const uint64_t*, the words of the slots.
    */
-  void setPaths(
-      std::vector<std::vector<std::vector<std::vector<Link *>>>> *path);
+  const uint64_t *getSlotWords(int link) const;
   /**
-   * @brief Destroys the Allocator object.
+   * @brief Get the state of the slots of a core and mode of a Link packed in
+   * 64 bit words, as seen by the snapshot.
    *
+   * @param link the id of the Link.
+   * @param core the core index on the Link.
+   * @param mode the mode index on the Link.
+   * @return const uint64_t*, the words of the slots.
    */
-  ~Allocator();
+  const uint64_t *getSlotWords(int link, int core, int mode) const;
   /**
-   * @brief The method to allocate resources inside the Network of the
-   * Allocator. It must be implemented inside an inherited class, such as a
-   * controller.
+   * @brief Get the state of a slot of a Link, as seen by the snapshot.
    *
-   * @param src the id of the source Node in the requested connection.
-   * @param dst the id of the destination Node in the requested connection.
-   * @param bitRate the BitRate object.
-   * @param con the Connection object. It's passed by reference.
-   * @return allocationStatus the result of the allocation process, whether the
-   * resources were allocated or not.
+   * This method assumes a single-mode/single-core network.
+   *
+   * @param link the id of the Link.
+   * @param pos the position of the slot.
+   * @return bool true if the slot is active.
    */
-  virtual allocationStatus exec(int src, int dst, BitRate bitRate,
-                                Connection &con);
+  bool getSlot(int link, int pos) const;
   /**
-   * @brief Get the name attribute of the allocator object.
+   * @brief Get the state of a slot of a core and mode of a Link, as seen by
+   * the snapshot.
    *
-   * @return std::string the name of the allocator.
+   * @param link the id of the Link.
+   * @param core the core index on the Link.
+   * @param mode the mode index on the Link.
+   * @param pos the position of the slot.
+   * @return bool true if the slot is active.
    */
-  std::string getName(void);
-
- protected:
+  bool getSlot(int link, int core, int mode, int pos) const;
   /**
-   * @brief A pointer to the Network object that the Allocator will generate
-   * connections on.
+   * @brief Activates the slots [slotFrom, slotTo) of a Link on the snapshot.
    *
+   * This method assumes a single-mode/single-core network.
+   *
+   * @param link the id of the Link.
+   * @param slotFrom the first slot.
+   * @param slotTo the slot after the last one.
    */
-  Network *network;
+  void useSlot(int link, int slotFrom, int slotTo);
   /**
-   * @brief A pointer to a four dimensional vector that contains pointers to
-   * each Link on every existing route between the Nodes inside the Network.
+   * @brief Activates the slots [slotFrom, slotTo) of a core and mode of a
+   * Link on the snapshot. They must be free.
    *
+   * @param link the id of the Link.
+   * @param core the core index on the Link.
+   * @param mode the mode index on the Link.
+   * @param slotFrom the first slot.
+   * @param slotTo the slot after the last one.
    */
-  std::vector<std::vector<std::vector<std::vector<Link *>>>> *path;
+  void useSlot(int link, int core, int mode, int slotFrom, int slotTo);
   /**
-   * @brief The Name of the allocation algorithm.
+   * @brief Deactivates the slots [slotFrom, slotTo) of a Link on the
+   * snapshot.
+   *
+   * This method assumes a single-mode/single-core network.
    *
+   * @param link the id of the Link.
+   * @param slotFrom the first slot.
+   * @param slotTo the slot after the last one.
    */
-  std::string name;
+  void unuseSlot(int link, int slotFrom, int slotTo);
+  /**
+   * @brief Deactivates the slots [slotFrom, slotTo) of a core and mode of a
+   * Link on the snapshot. They must be active.
+   *
+   * @param link the id of the Link.
+   * @param core the core index on the Link.
+   * @param mode the mode index on the Link.
+   * @param slotFrom the first slot.
+   * @param slotTo the slot after the last one.
+   */
+  void unuseSlot(int link, int core, int mode, int slotFrom, int slotTo);
+  /**
+   * @brief Activates the slots of every link of a connection on the
+   * snapshot, for example the placement chosen by an allocator.
+   *
+   * @param connection the connection.
+   */
+  void occupy(const Connection &connection);
+  /**
+   * @brief Deactivates the slots of every link of a connection on the
+   * snapshot.
+   *
+   * @param connection the connection.
+   */
+  void release(const Connection &connection);
+  /**
+   * @brief Get the number of free slots of a core and mode of a Link, as
+   * seen by the snapshot. It costs O(1) on pages that weren't modified and
+   * O(S / 64) on the others.
+   *
+   * @param link the id of the Link.
+   * @param core the core index on the Link.
+   * @param mode the mode index on the Link.
+   * @return int the number of free slots.
+   */
+  int getFreeSlots(int link, int core = 0, int mode = 0) const;
+  /**
+   * @brief Get the length of the largest block of free slots of a core and
+   * mode of a Link, as seen by the snapshot. It costs O(1) on pages that
+   * weren't modified and O(S) on the others.
+   *
+   * @param link the id of the Link.
+   * @param core the core index on the Link.
+   * @param mode the mode index on the Link.
+   * @return int the length of the largest free block.
+   */
+  int getLargestFreeBlock(int link, int core = 0, int mode = 0) const;
+  /**
+   * @brief Get the external fragmentation of a core and mode of a Link (see
+   * Link::getExternalFragmentation), as seen by the snapshot.
+   *
+   * @param link the id of the Link.
+   * @param core the core index on the Link.
+   * @param mode the mode index on the Link.
+   * @return double the external fragmentation between 0 and 1.
+   */
+  double getExternalFragmentation(int link, int core = 0,
+                                  int mode = 0) const;
+  /**
+   * @brief Get the number of pages copied by the snapshot, that is, the
+   * cores and modes of links it modified.
+   *
+   * @return int the number of pages.
+   */
+  int getModifiedPages(void) const;
+  /**
+   * @brief Applies the changes of the snapshot to its parent, the network or
+   * the parent snapshot, and leaves the snapshot as a view of the new state
+   * of the parent.
+   *
+   */
+  void commit(void);
+  /**
+   * @brief Drops the changes of the snapshot, which becomes a view of the
+   * parent again. The memory of the pages is kept for the next changes.
+   *
+   */
+  void discard(void);
+
+ private:
+  Network *network;
+  SpectrumSnapshot *parent;
+  // Page of every core and mode of every link (-1 if it wasn't copied),
+  // the words of the copied pages one after the other, and the copied
+  // (link, spectrum) pairs
+  std::vector<std::vector<int>> pageOffset;
+  std::vector<uint64_t> pages;
+  std::vector<std::pair<int, int>> modified;
+
+  Link *getLink(int link) const;
+  int spectrumOf(int link, int core, int mode) const;
+  uint64_t *writablePage(int link, int core, int mode);
+  void setRange(int link, int core, int mode, int slotFrom, int slotTo,
+                bool value);
 };
+
 #endif
-// #include "allocator.hpp"
+// #include "spectrum_snapshot.hpp"
 
-Allocator::Allocator(Network *network) {
+SpectrumSnapshot::SpectrumSnapshot(Network *network) {
   this->network = network;
-  this->name = std::string("No name");
+  this->parent = nullptr;
+  this->pageOffset.resize(network->getNumberOfLinks());
 }
 
-Allocator::~Allocator() {}
+SpectrumSnapshot::SpectrumSnapshot(SpectrumSnapshot *parent) {
+  this->network = parent->network;
+  this->parent = parent;
+  this->pageOffset.resize(this->network->getNumberOfLinks());
+}
 
-allocationStatus Allocator::exec(int src, int dst, BitRate bitRate,
-                                 Connection &con) {
-  throw std::runtime_error(
-      "You must implement a method to allocate resources. You can do this "
-      "making an inherited class from Allocator, or ...");
+SpectrumSnapshot SpectrumSnapshot::fork(void) {
+  return SpectrumSnapshot(this);
 }
 
-std::string Allocator::getName(void) { return this->name; }
+Link *SpectrumSnapshot::getLink(int link) const {
+  if (link < 0 || link >= static_cast<int>(this->pageOffset.size()))
+    throw std::runtime_error("Link position out of bounds.");
+  return this->network->getLink(link);
+}
 
-Allocator::Allocator(void) {
-  this->network = nullptr;
-  this->path = nullptr;
+int SpectrumSnapshot::spectrumOf(int link, int core, int mode) const {
+  Link *l = this->getLink(link);
+  if (core < 0 || core >= l->getCores())
+    throw std::runtime_error("Cannot use a snapshot in core out of bounds.");
+  if (mode < 0 || mode >= l->getModes())
+    throw std::runtime_error("Cannot use a snapshot in mode out of bounds.");
+  return core * l->getModes() + mode;
 }
 
-void Allocator::setNetwork(Network *network) { this->network = network; }
+const uint64_t *SpectrumSnapshot::getSlotWords(int link) const {
+  return this->getSlotWords(link, 0, 0);
+}
 
-void Allocator::setPaths(
-    std::vector<std::vector<std::vector<std::vector<Link *>>>> *path) {
-  this->path = path;
+const uint64_t *SpectrumSnapshot::getSlotWords(int link, int core,
+                                               int mode) const {
+  int spectrum = this->spectrumOf(link, core, mode);
+  const std::vector<int> &offsets = this->pageOffset[link];
+  if (!offsets.empty() && offsets[spectrum] >= 0)
+    return this->pages.data() + offsets[spectrum];
+  if (this->parent != nullptr)
+    return this->parent->getSlotWords(link, core, mode);
+  return this->network->getLink(link)->getSlotWords(core, mode);
 }
 
-#ifndef __DUMMY_ALLOCATOR_H__
-#define __DUMMY_ALLOCATOR_H__
+bool SpectrumSnapshot::getSlot(int link, int pos) const {
+  return this->getSlot(link, 0, 0, pos);
+}
 
-// #include "allocator.hpp"
+bool SpectrumSnapshot::getSlot(int link, int core, int mode, int pos) const {
+  const uint64_t *words = this->getSlotWords(link, core, mode);
+  if (pos < 0 || pos >= this->network->getLink(link)->getSlots(core, mode))
+    throw std::runtime_error("Cannot get slot in position out of bounds.");
+  return (words[pos / 64] >> (pos % 64)) & 1;
+}
+
+uint64_t *SpectrumSnapshot::writablePage(int link, int core, int mode) {
+  int spectrum = this->spectrumOf(link, core, mode);
+  Link *l = this->network->getLink(link);
+  std::vector<int> &offsets = this->pageOffset[link];
+  if (offsets.empty()) offsets.assign(l->getCores() * l->getModes(), -1);
+  if (offsets[spectrum] < 0) {
+    // First change of the page: copy it from the parent
+    const uint64_t *words = this->getSlotWords(link, core, mode);
+    int stride = l->getWordStride();
+    offsets[spectrum] = this->pages.size();
+    this->pages.insert(this->pages.end(), words, words + stride);
+    this->modified.push_back(std::make_pair(link, spectrum));
+  }
+  return this->pages.data() + offsets[spectrum];
+}
+
+void SpectrumSnapshot::setRange(int link, int core, int mode, int slotFrom,
+                                int slotTo, bool value) {
+  if (slotFrom < 0 || slotTo > this->getLink(link)->getSlots(core, mode) ||
+      slotFrom >= slotTo)
+    throw std::runtime_error("slot position out of bounds.");
+  uint64_t *words = this->writablePage(link, core, mode);
+  for (int w = slotFrom / 64; w <= (slotTo - 1) / 64; w++) {
+    int first = std::max(slotFrom - w * 64, 0);
+    int last = std::min(slotTo - w * 64, 64);
+    uint64_t mask = (last == 64 ? ~uint64_t(0) : (uint64_t(1) << last) - 1) &
+                    ~((uint64_t(1) << first) - 1);
+    if (value ? (words[w] & mask) != 0 : (words[w] & mask) != mask)
+      throw std::runtime_error(value ? "Slot already used."
+                                     : "Slot already free.");
+    words[w] ^= mask;
+  }
+}
+
+void SpectrumSnapshot::useSlot(int link, int slotFrom, int slotTo) {
+  this->setRange(link, 0, 0, slotFrom, slotTo, true);
+}
+
+void SpectrumSnapshot::useSlot(int link, int core, int mode, int slotFrom,
+                               int slotTo) {
+  this->setRange(link, core, mode, slotFrom, slotTo, true);
+}
+
+void SpectrumSnapshot::unuseSlot(int link, int slotFrom, int slotTo) {
+  this->setRange(link, 0, 0, slotFrom, slotTo, false);
+}
+
+void SpectrumSnapshot::unuseSlot(int link, int core, int mode, int slotFrom,
+                                 int slotTo) {
+  this->setRange(link, core, mode, slotFrom, slotTo, false);
+}
+
+void SpectrumSnapshot::occupy(const Connection &connection) {
+  for (unsigned int j = 0; j < connection.links.size(); j++) {
+    for (unsigned int k = 0; k < connection.slots[j].size(); k++) {
+      int slot = connection.slots[j][k];
+      this->setRange(connection.links[j], connection.cores[j],
+                     connection.modes[j], slot, slot + 1, true);
+    }
+  }
+}
+
+void SpectrumSnapshot::release(const Connection &connection) {
+  for (unsigned int j = 0; j < connection.links.size(); j++) {
+    for (unsigned int k = 0; k < connection.slots[j].size(); k++) {
+      int slot = connection.slots[j][k];
+      this->setRange(connection.links[j], connection.cores[j],
+                     connection.modes[j], slot, slot + 1, false);
+    }
+  }
+}
+
+int SpectrumSnapshot::getFreeSlots(int link, int core, int mode) const {
+  int spectrum = this->spectrumOf(link, core, mode);
+  const std::vector<int> &offsets = this->pageOffset[link];
+  if (offsets.empty() || offsets[spectrum] < 0) {
+    if (this->parent != nullptr)
+      return this->parent->getFreeSlots(link, core, mode);
+    return this->network->getLink(link)->getFreeSlots(core, mode);
+  }
+  int slots = this->network->getLink(link)->getSlots(core, mode);
+  const uint64_t *words = this->pages.data() + offsets[spectrum];
+  int used = 0;
+  for (int w = 0; w < (slots + 63) / 64; w++)
+    used += __builtin_popcountll(words[w]);
+  return slots - used;
+}
+
+int SpectrumSnapshot::getLargestFreeBlock(int link, int core,
+                                          int mode) const {
+  int spectrum = this->spectrumOf(link, core, mode);
+  const std::vector<int> &offsets = this->pageOffset[link];
+  if (offsets.empty() || offsets[spectrum] < 0) {
+    if (this->parent != nullptr)
+      return this->parent->getLargestFreeBlock(link, core, mode);
+    return this->network->getLink(link)->getLargestFreeBlock(core, mode);
+  }
+  int slots = this->network->getLink(link)->getSlots(core, mode);
+  const uint64_t *words = this->pages.data() + offsets[spectrum];
+  // A word at a time: the free run that crosses into the word ends on its
+  // first used slot, and a new one starts after its last used slot
+  int largest = 0;
+  int run = 0;
+  for (int w = 0; w < (slots + 63) / 64; w++) {
+    uint64_t used = words[w];
+    if (slots - w * 64 < 64) used |= ~uint64_t(0) << (slots - w * 64);
+    if (used == 0) {
+      run += 64;
+      continue;
+    }
+    int inner = 0;
+    for (uint64_t free = ~used; free != 0; free &= free >> 1) inner++;
+    largest = std::max(largest, std::max(run + __builtin_ctzll(used), inner));
+    run = __builtin_clzll(used);
+  }
+  return std::max(largest, run);
+}
+
+double SpectrumSnapshot::getExternalFragmentation(int link, int core,
+                                                  int mode) const {
+  int free = this->getFreeSlots(link, core, mode);
+  if (free == 0) return 0;
+  return 1 - this->getLargestFreeBlock(link, core, mode) /
+                 static_cast<double>(free);
+}
+
+int SpectrumSnapshot::getModifiedPages(void) const {
+  return this->modified.size();
+}
+
+void SpectrumSnapshot::commit(void) {
+  for (unsigned int i = 0; i < this->modified.size(); i++) {
+    int link = this->modified[i].first;
+    int spectrum = this->modified[i].second;
+    Link *l = this->network->getLink(link);
+    int core = spectrum / l->getModes();
+    int mode = spectrum % l->getModes();
+    const uint64_t *words =
+        this->pages.data() + this->pageOffset[link][spectrum];
+    if (this->parent != nullptr) {
+      uint64_t *target = this->parent->writablePage(link, core, mode);
+      std::copy(words, words + l->getWordStride(), target);
+      continue;
+    }
+    // Only the slots that differ from the network are changed on it
+    const uint64_t *current = l->getSlotWords(core, mode);
+    for (int w = 0; w < l->getWordStride(); w++) {
+      uint64_t changed = words[w] ^ current[w];
+      while (changed != 0) {
+        int slot = w * 64 + __builtin_ctzll(changed);
+        changed &= changed - 1;
+        if ((words[w] >> (slot % 64)) & 1) {
+          this->network->useSlot(link, core, mode, slot);
+        } else {
+          this->network->unuseSlot(link, core, mode, slot);
+        }
+      }
+    }
+  }
+  this->discard();
+}
+
+void SpectrumSnapshot::discard(void) {
+  for (unsigned int i = 0; i < this->modified.size(); i++) {
+    this->pageOffset[this->modified[i].first][this->modified[i].second] = -1;
+  }
+  this->modified.clear();
+  this->pages.clear();
+}
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 /**
- * @brief Class "DummyAllocator" which extends class father "Allocator".
+ * @brief Class with a persistent pool of worker threads.
+ *
+ * The ThreadPool class keeps a fixed set of worker threads alive during its
+ * whole lifetime, so parallel sections inside the simulator (route
+ * computation, replications, candidate evaluation) don't pay the cost of
+ * creating threads every time they are executed.
+ *
+ * Work is submitted through the parallelFor method, which splits a range of
+ * indexes between the workers and the calling thread, and returns once every
+ * index has been processed. A pool must not be used by more than one caller
+ * at the same time.
  */
-
-class DummyAllocator : public Allocator {
+class ThreadPool {
  public:
   /**
-   * @brief Constructs a new DummyAllocator object.
+   * @brief Constructs a new ThreadPool object with as many threads as
+   * hardware threads are available on the machine.
+   *
    */
-  DummyAllocator();
+  ThreadPool(void);
   /**
-   * @brief Constructs a new DummyAllocator object and initialize the network.
+   * @brief Constructs a new ThreadPool object with the given number of
+   * threads. The calling thread is counted as one of them, so a pool of one
+   * thread executes everything sequentially.
    *
-   * @param network pointer type network representing the network of nodes.
+   * @param numberOfThreads the number of threads used by the pool. If it's
+   * lower than 1, the number of hardware threads is used.
    */
-  DummyAllocator(Network *network);
+  ThreadPool(int numberOfThreads);
   /**
-   * @brief Delete the object DummyAllocator.
+   * @brief Destroys the ThreadPool object, joining all the worker threads.
+   *
    */
-  ~DummyAllocator();
+  ~ThreadPool();
   /**
-   * @brief The method to allocate resources. It must be implemented on an
-   * inherited class.
+   * @brief Executes the task for every index in the range [begin, end),
+   * distributing the indexes between the threads of the pool. If a task throws
+   * an exception, the first one is rethrown on the calling thread once every
+   * thread has stopped.
    *
-   * @param src start node, type integer.
-   * @param dst destiny node, type integer.
-   * @param bitRate the bit rate of the connection. param typer BitRare.
-   * @param con the Connection object. It's passed by reference.
+   * @param begin the first index of the range.
+   * @param end the limit of the range (not included).
+   * @param task the function executed for every index of the range.
+   */
+  void parallelFor(int begin, int end, std::function<void(int)> task);
+  /**
+   * @brief Get the number of threads of the pool, counting the calling thread.
    *
-   * @return param type allocationStatus what represents if it is ALLOCATED,
-   * NOT_ALLOCATED, N_A (not assigned )
+   * @return int the number of threads.
    */
-  allocationStatus exec(int src, int dst, BitRate bitRate, Connection &con);
+  int getNumberOfThreads(void) const;
+
+ private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::condition_variable finished;
+  std::function<void(int)> *task;
+  std::atomic<int> next;
+  int end;
+  int pending;
+  unsigned long long generation;
+  bool stop;
+  std::exception_ptr error;
+
+  void start(int numberOfThreads);
+  void work(void);
+  void workerLoop(void);
 };
 
 #endif
-// #include "dummy_allocator.hpp"
+// #include "thread_pool.hpp"
 
-DummyAllocator::DummyAllocator(Network *network) : Allocator(network) {
-  this->name = std::string("Dummy Allocator");
+ThreadPool::ThreadPool(void) { this->start(0); }
+
+ThreadPool::ThreadPool(int numberOfThreads) { this->start(numberOfThreads); }
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop = true;
+  }
+  this->condition.notify_all();
+  for (unsigned int i = 0; i < this->workers.size(); i++) {
+    this->workers[i].join();
+  }
 }
 
-DummyAllocator::~DummyAllocator() {}
+void ThreadPool::start(int numberOfThreads) {
+  if (numberOfThreads < 1)
+    numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+  this->task = nullptr;
+  this->next = 0;
+  this->end = 0;
+  this->pending = 0;
+  this->generation = 0;
+  this->stop = false;
+  this->error = nullptr;
+  // The calling thread works too, so it isn't counted as a worker
+  for (int i = 1; i < numberOfThreads; i++) {
+    this->workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+  }
+}
 
-allocationStatus DummyAllocator::exec(int src, int dst, BitRate bitRate,
-                                      Connection &con) {
-  int link = this->network->isConnected(src, dst);
-  if (link != -1) {
-    if (!this->network->isSlotUsed(link, 0, 2)) {
-      con.addLink(link, 0, 2);
-      return ALLOCATED;
-    } else {
-      return NOT_ALLOCATED;
+void ThreadPool::parallelFor(int begin, int end,
+                             std::function<void(int)> task) {
+  if (end <= begin) return;
+  if (this->workers.empty() || end - begin == 1) {
+    for (int i = begin; i < end; i++) task(i);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->task = &task;
+  this->next = begin;
+  this->end = end;
+  this->pending = this->workers.size();
+  this->error = nullptr;
+  this->generation++;
+  lock.unlock();
+  this->condition.notify_all();
+
+  this->work();
+
+  lock.lock();
+  this->finished.wait(lock, [this] { return this->pending == 0; });
+  this->task = nullptr;
+  if (this->error) std::rethrow_exception(this->error);
+}
+
+int ThreadPool::getNumberOfThreads(void) const {
+  return this->workers.size() + 1;
+}
+
+void ThreadPool::work(void) {
+  int i;
+  while ((i = this->next.fetch_add(1)) < this->end) {
+    try {
+      (*this->task)(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (!this->error) this->error = std::current_exception();
+      // Skip the remaining indexes
+      this->next = this->end;
     }
-  } else {
-    return NOT_ALLOCATED;
   }
 }
-DummyAllocator::DummyAllocator() : Allocator() {}
 
-#ifndef __CONTROLLER_H__
-#define __CONTROLLER_H__
+void ThreadPool::workerLoop(void) {
+  unsigned long long seen = 0;
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (true) {
+    this->condition.wait(
+        lock, [&] { return this->stop || this->generation != seen; });
+    if (this->stop) return;
+    seen = this->generation;
+    lock.unlock();
+    this->work();
+    lock.lock();
+    if (--this->pending == 0) this->finished.notify_one();
+  }
+}
 
-// #include "allocator.hpp"
+#ifndef __ALLOCATOR_H__
+#define __ALLOCATOR_H__
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// #include "bitrate.hpp"
 // #include "connection.hpp"
 // #include "network.hpp"
+// #include "thread_pool.hpp"
 
+typedef enum allocStatus { ALLOCATED, NOT_ALLOCATED, N_A } allocationStatus;
 /**
- * @brief Class with the controller information.
+ * @brief Class with the allocator information.
  *
- * This class allows you to create the object Controller and manipulate it by
- * its methods. The importance of this object is that it handles connection
- * requests generated inside the Simulator by executing an allocation algorithm
- * from the Allocator object on the network. Once the process is completed, it
- * returns the result to the simulator. The Controller is the link between the
- * Simulator and the Network.
+ * The Allocator class handles the assignment of connections inside a Network.
+ * This class must be inherited by another class, in which a method to allocate
+ * resources has to be implemented.
+ *
+ * The Allocator class consists of a Network object, a Path vector to the Links
+ * inside said Network and a Name attribute and methods for setting them.
  *
+ * Allocators that spend most of their time scoring candidates can evaluate
+ * them in parallel with bestCandidate, after enabling it with
+ * setParallelCandidates (as the Most Used policy of SpectrumAllocator does).
+ * Candidates are numbered by the allocator, for example
+ * (route * NUMBER_OF_MODULATIONS + modulation) * slots + slot, and the
+ * method returns the same candidate as a sequential loop over that order.
  */
-class Controller {
+class Allocator {
  public:
   /**
-   * @brief Constructs a new Controller object. The attribute connections is
-   * assigned to an empty Connection vector. This object does not have a network
-   * or connections registered.
+   * @brief Constructs a new Allocator object that represents the default
+   * initialization of an Allocator invoked by calling the void constructor.
+   This
+   * constructor sets all the information about the Allocator's Networks and
+   Paths as
+   * empty so the Allocator is ready to be built from a clean state.
+
+   */
+  Allocator(void);
+  /**
+   * @brief Constructs a new Allocator object that represents the
+   * initialization of an Allocator with a given (already existing) Network
+   * to be set as the Allocator's own Network.
    *
+   * @param network the pointer to the Network object that will be set as the
+   * Allocator's own Network.
    */
-  Controller();
+  Allocator(Network *network);
   /**
-   * @brief Constructs a new Controller object. It takes a Network object and
-   * stores it as an attribute. An empty Connection vector is created and
-   * stored as well.
+   * @brief Set the Allocator's Network as the one given by the pointer of an
+   * already existing Network object.
    *
-   * @param network The pointer type Network object. This contains all
-   * the information about the network, nodes, routes, path length and slots.
+   * @param network the pointer to the Network object that will be set as the
+   * Allocator's own Network.
    */
-  Controller(Network *network);
+  void setNetwork(Network *network);
   /**
-   * @brief Delete the Controller object.
+   * @brief Set the Path attribute of the Allocator.
    *
+   * @param path the pointer to the Path vector. This vector contains the
+   * information regarding the routes between the Nodes inside Network.
    */
-  ~Controller();
+  void setPaths(
+      std::vector<std::vector<std::vector<std::vector<Link *>>>> *path);
   /**
-   * @brief Assigns a connection between a source and a destination node through
-   * an allocation method from the allocator. It creates a connection object
-   * with idConnection as its id, upon which the connections between nodes are
-   * generated.
+   * @brief Destroys the Allocator object. It's virtual because the
+   * Controller deletes its allocator through an Allocator pointer.
    *
-   * @param src the source node of the connection.
-   * @param dst the destination node of the connection.
-   * @param bitRate the bitRate object of the connection.
-   * @param idConnection the id of the new connection object. It serves to
-   * identify the connection within the attribute connections.
-   * @return the result of the allocation process, whether the
-   * allocation was succesful or not. This is type allocationStatus, there are
-   * three states: ALLOCATED, NOT_ALLOCATED, N_A (not assigned).
    */
-  allocationStatus assignConnection(int src, int dst, BitRate bitRate,
-                                    long long idConnection, double time);
+  virtual ~Allocator();
   /**
-   * @brief Unnasigns the requested connection making the resources that were
-   * being used become available again. It deactivates the slots that were
-   * taken in the connection.
+   * @brief The method to allocate resources inside the Network of the
+   * Allocator. It must be implemented inside an inherited class, such as a
+   * controller.
    *
-   * @param idConnection the id of the Connection object. It serves to
-   * identify the connection within the attribute connections.
-   * @return int number zero if unsuccessful.
+   * @param src the id of the source Node in the requested connection.
+   * @param dst the id of the destination Node in the requested connection.
+   * @param bitRate the BitRate object.
+   * @param con the Connection object. It's passed by reference.
+   * @return allocationStatus the result of the allocation process, whether the
+   * resources were allocated or not.
    */
-  int (Controller::*unassignConnection)(long long idConnection, double time);
+  virtual allocationStatus exec(int src, int dst, BitRate bitRate,
+                                Connection &con);
   /**
-   * @brief Sets the paths vector from the routes on the JSON file. From this
-   file, the method creates the paths vector based on an array of routes. This
-   array contains the source and destination nodes, as well as an array with all
-   the existing paths between them. The path vector is important because it is
-   all the nodes and the respective routes that link them
+   * @brief Get the name attribute of the allocator object.
    *
+   * @return std::string the name of the allocator.
+   */
+  std::string getName(void);
+  /**
+   * @brief Tells if the allocator can run concurrently for connections whose
+   * candidate routes don't share links, as on the parallel events mode of the
+   * Simulator, which refuses allocators that can't. That requires exec to
+   * only read the links of the candidate routes of the connection and to
+   * keep no mutable state. The base class can't know, so it returns false.
    *
-   * In the example below, the network consists of three nodes: 0, 1 and 2. Node
-   0 is connected to node 1 directly and through node 2, to which it's directly
-   connected as well. Node 2 is connected directly to node one. All the
-   connections are unidirectional.
+   * @return true if exec can run concurrently on disjoint routes.
+   */
+  virtual bool isParallelSafe(void);
+  /**
+   * @brief Set the replication the allocator runs on, so allocators that
+   * draw random numbers use independent streams on every replication. The
+   * Simulator sets it on init and on every reset.
    *
+   * @param replication the replication index.
+   */
+  void setReplication(unsigned int replication);
+  /**
+   * @brief Enables the parallel evaluation of candidates on a persistent
+   * pool of threads owned by the allocator. Evaluations with less than
+   * minCandidates candidates, or that happen while the pool is busy (for
+   * example, allocations running concurrently on the parallel events mode of
+   * the simulator), are executed sequentially on the calling thread.
    *
-   * @param filename name of the JSON file that contains the routes. Example of
-   this: "routes.json"
-   * \code{.json}
-     {
-      "name": "Example routes between 3 nodes",
-      "alias": "example",
-      "routes": [
-        {
-          "src": 0,
-          "dst": 1,
-          "paths": [
-            [
-              0,
-              1
-            ],
-            [
-              0,
-              2,
-              1
-            ]
-          ]
-        },
-        {
-          "src": 0,
-          "dst": 2,
-          "paths": [
-            [
-              0,
-              2
-            ]
-          ]
-        },
-        {
+   * @param numberOfThreads the threads of the pool. If it's lower than 1,
+   * the number of hardware threads is used.
+   * @param minCandidates the minimum amount of candidates evaluated in
+   * parallel.
+   */
+  void setParallelCandidates(int numberOfThreads = 0,
+                             long long minCandidates = 1024);
+
+ protected:
+  /**
+   * @brief Finds the candidate with the lowest score. Ties are won by the
+   * lowest index, so the result doesn't depend on the number of threads.
+   * The score function is evaluated concurrently on the network as it is, so
+   * it must only read it.
+   *
+   * @param numberOfCandidates the amount of candidates.
+   * @param score function that gives the score of the candidate of an index,
+   * infinity if it's not feasible.
+   * @return long long the index of the best candidate, -1 if there is no
+   * feasible one.
+   */
+  long long bestCandidate(long long numberOfCandidates,
+                          std::function<double(long long)> score);
+  /**
+   * @brief Get an upper bound of the contiguous free slots that can be
+   * allocated on a route: the smallest of the largest free blocks of its
+   * links. If a request needs more slots, the route can be skipped without
+   * looking at its slots.
+   *
+   * @param route the links of the route.
+   * @return int the bound, 0 if some link is full.
+   */
+  int routeLargestFreeBlock(const std::vector<Link *> &route);
+  /**
+   * @brief Get the intervals of slots that are free on every link of a
+   * route, intersecting the spectrum indexes of the links (see
+   * SpectrumIndex::intersect). The indexes of the links are enabled the first
+   * time they are needed.
+   *
+   * @param route the links of the route.
+   * @return std::vector<std::pair<int, int>> the first slot and length of
+   * every common free interval, ordered by their first slot.
+   */
+  std::vector<std::pair<int, int>> routeGaps(const std::vector<Link *> &route);
+  /**
+   * @brief A pointer to the Network object that the Allocator will generate
+   * connections on.
+   *
+   */
+  Network *network;
+  /**
+   * @brief A pointer to a four dimensional vector that contains pointers to
+   * each Link on every existing route between the Nodes inside the Network.
+   *
+   */
+  std::vector<std::vector<std::vector<std::vector<Link *>>>> *path;
+  /**
+   * @brief The Name of the allocation algorithm.
+   *
+   */
+  std::string name;
+  /**
+   * @brief The replication the allocator runs on (see setReplication).
+   *
+   */
+  unsigned int replication;
+
+ private:
+  std::shared_ptr<ThreadPool> pool;
+  std::shared_ptr<std::mutex> poolMutex;
+  long long minCandidates;
+};
+#endif
+// #include "allocator.hpp"
+
+Allocator::Allocator(Network *network) {
+  this->network = network;
+  this->name = std::string("No name");
+  this->replication = 0;
+  this->minCandidates = 1024;
+}
+
+Allocator::~Allocator() {}
+
+allocationStatus Allocator::exec(int src, int dst, BitRate bitRate,
+                                 Connection &con) {
+  throw std::runtime_error(
+      "You must implement a method to allocate resources. You can do this "
+      "making an inherited class from Allocator, or ...");
+}
+
+std::string Allocator::getName(void) { return this->name; }
+
+bool Allocator::isParallelSafe(void) { return false; }
+
+void Allocator::setReplication(unsigned int replication) {
+  this->replication = replication;
+}
+
+Allocator::Allocator(void) {
+  this->network = nullptr;
+  this->path = nullptr;
+  this->replication = 0;
+  this->minCandidates = 1024;
+}
+
+void Allocator::setNetwork(Network *network) { this->network = network; }
+
+void Allocator::setPaths(
+    std::vector<std::vector<std::vector<std::vector<Link *>>>> *path) {
+  this->path = path;
+}
+
+int Allocator::routeLargestFreeBlock(const std::vector<Link *> &route) {
+  int bound = std::numeric_limits<int>::max();
+  for (unsigned int l = 0; l < route.size(); l++) {
+    bound = std::min(bound, route[l]->getLargestFreeBlock());
+  }
+  return bound;
+}
+
+std::vector<std::pair<int, int>> Allocator::routeGaps(
+    const std::vector<Link *> &route) {
+  std::vector<const SpectrumIndex *> indexes;
+  for (unsigned int l = 0; l < route.size(); l++) {
+    if (!route[l]->hasSpectrumIndex()) route[l]->setSpectrumIndex(true);
+    indexes.push_back(&route[l]->getSpectrumIndex());
+  }
+  return SpectrumIndex::intersect(indexes);
+}
+
+void Allocator::setParallelCandidates(int numberOfThreads,
+                                      long long minCandidates) {
+  this->pool = std::make_shared<ThreadPool>(numberOfThreads);
+  this->poolMutex = std::make_shared<std::mutex>();
+  this->minCandidates = minCandidates;
+}
+
+long long Allocator::bestCandidate(long long numberOfCandidates,
+                                   std::function<double(long long)> score) {
+  std::unique_lock<std::mutex> lock;
+  if (this->pool != nullptr && numberOfCandidates >= this->minCandidates) {
+    lock = std::unique_lock<std::mutex>(*this->poolMutex, std::try_to_lock);
+  }
+  int chunks = lock.owns_lock() ? 4 * this->pool->getNumberOfThreads() : 1;
+  long long chunkSize = (numberOfCandidates + chunks - 1) / chunks;
+  std::vector<long long> bestIndex(chunks, -1);
+  std::vector<double> bestScore(chunks,
+                                std::numeric_limits<double>::infinity());
+  std::function<void(int)> task = [&](int c) {
+    long long end = std::min(numberOfCandidates, (c + 1) * chunkSize);
+    for (long long i = c * chunkSize; i < end; i++) {
+      double value = score(i);
+      if (value < bestScore[c]) {
+        bestScore[c] = value;
+        bestIndex[c] = i;
+      }
+    }
+  };
+  if (lock.owns_lock()) {
+    this->pool->parallelFor(0, chunks, task);
+  } else {
+    task(0);
+  }
+
+  // Chunks are reduced in order, so ties keep the lowest index
+  long long best = -1;
+  double value = std::numeric_limits<double>::infinity();
+  for (int c = 0; c < chunks; c++) {
+    if (bestScore[c] < value) {
+      value = bestScore[c];
+      best = bestIndex[c];
+    }
+  }
+  return best;
+}
+
+#ifndef __DUMMY_ALLOCATOR_H__
+#define __DUMMY_ALLOCATOR_H__
+
+// #include "allocator.hpp"
+
+/**
+ * @brief Class "DummyAllocator" which extends class father "Allocator".
+ */
+
+class DummyAllocator : public Allocator {
+ public:
+  /**
+   * @brief Constructs a new DummyAllocator object.
+   */
+  DummyAllocator();
+  /**
+   * @brief Constructs a new DummyAllocator object and initialize the network.
+   *
+   * @param network pointer type network representing the network of nodes.
+   */
+  DummyAllocator(Network *network);
+  /**
+   * @brief Delete the object DummyAllocator.
+   */
+  ~DummyAllocator();
+  /**
+   * @brief The method to allocate resources. It must be implemented on an
+   * inherited class.
+   *
+   * @param src start node, type integer.
+   * @param dst destiny node, type integer.
+   * @param bitRate the bit rate of the connection. param typer BitRare.
+   * @param con the Connection object. It's passed by reference.
+   *
+   * @return param type allocationStatus what represents if it is ALLOCATED,
+   * NOT_ALLOCATED, N_A (not assigned )
+   */
+  allocationStatus exec(int src, int dst, BitRate bitRate, Connection &con);
+};
+
+#endif
+// #include "dummy_allocator.hpp"
+
+DummyAllocator::DummyAllocator(Network *network) : Allocator(network) {
+  this->name = std::string("Dummy Allocator");
+}
+
+DummyAllocator::~DummyAllocator() {}
+
+allocationStatus DummyAllocator::exec(int src, int dst, BitRate bitRate,
+                                      Connection &con) {
+  int link = this->network->isConnected(src, dst);
+  if (link != -1) {
+    if (!this->network->isSlotUsed(link, 0, 2)) {
+      con.addLink(link, 0, 2);
+      return ALLOCATED;
+    } else {
+      return NOT_ALLOCATED;
+    }
+  } else {
+    return NOT_ALLOCATED;
+  }
+}
+DummyAllocator::DummyAllocator() : Allocator() {}
+
+#ifndef __SLOT_MASK_H__
+#define __SLOT_MASK_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// #include "bitrate.hpp"
+// #include "link.hpp"
+
+/**
+ * @brief Class with the kernels over sets of positions packed in 64 bit
+ * words, as in Link::getSlotWords. They are the spectrum kernel of every
+ * policy allocator: SlotMask, SpectrumAllocator and SDMAllocator.
+ */
+class SlotWords {
+ public:
+  /**
+   * @brief Keeps, on every channel, only the positions that start length
+   * consecutive set positions of the same channel. It takes O(log length)
+   * passes over the words.
+   *
+   * @param words channels * stride words, stride words for each channel.
+   * @param channels the number of channels.
+   * @param stride the number of words of every channel.
+   * @param length the number of consecutive positions.
+   */
+  static void fitting(uint64_t *words, int channels, int stride, int length);
+  /**
+   * @brief Get the first set position at or after another one.
+   *
+   * @param words the words of the positions.
+   * @param size the number of positions.
+   * @param from the position where the search starts.
+   * @return int the position, -1 if there is none.
+   */
+  static int next(const uint64_t *words, int size, int from);
+  /**
+   * @brief Get the first position that is not set at or after another one.
+   *
+   * @param words the words of the positions.
+   * @param size the number of positions.
+   * @param from the position where the search starts.
+   * @return int the position, size if every position after from is set.
+   */
+  static int nextUnset(const uint64_t *words, int size, int from);
+  /**
+   * @brief Get the last set position.
+   *
+   * @param words the words of the positions.
+   * @param size the number of positions.
+   * @return int the position, -1 if there is none.
+   */
+  static int last(const uint64_t *words, int size);
+  /**
+   * @brief Get the number of set positions.
+   *
+   * @param words the words of the positions.
+   * @param size the number of positions.
+   * @return int the number of set positions.
+   */
+  static int count(const uint64_t *words, int size);
+  /**
+   * @brief Get the n-th set position, counting from 0.
+   *
+   * @param words the words of the positions.
+   * @param size the number of positions.
+   * @param n the index of the position among the set ones.
+   * @return int the position, -1 if there are n or fewer set positions.
+   */
+  static int nth(const uint64_t *words, int size, int n);
+};
+
+/**
+ * @brief Class that represents a set of Slots positions, packed in a fixed
+ * number of 64 bit words.
+ *
+ * The size is a template parameter, so the loops over the words (see
+ * SlotWords) have a constant trip count and are unrolled and vectorized by
+ * the compiler. The free slots of a route are the slots not removed by any
+ * of its links (see Link::getSlotWords), and fitting turns them into the
+ * positions where a request fits. SlotMask<0> has the same methods for a
+ * number of positions given at runtime, so the spectrum policies below work
+ * on both PolicyAllocator and SpectrumAllocator.
+ */
+template <int Slots>
+class SlotMask {
+ public:
+  static const int WORDS = (Slots + 63) / 64;
+  /**
+   * @brief Constructs a new SlotMask object with every position set.
+   */
+  SlotMask(void);
+  /**
+   * @brief Clears the positions set on the given words.
+   *
+   * @param words the WORDS words of the positions to clear, packed as in
+   * Link::getSlotWords.
+   */
+  void remove(const uint64_t *words);
+  /**
+   * @brief Keeps only the positions that start length consecutive set
+   * positions. It takes O(log length) passes over the words.
+   *
+   * @param length the number of consecutive positions.
+   */
+  void fitting(int length);
+  /**
+   * @brief Get the first set position at or after another one.
+   *
+   * @param from the position where the search starts.
+   * @return int the position, -1 if there is none.
+   */
+  int next(int from = 0) const;
+  /**
+   * @brief Get the first position that is not set at or after another one.
+   *
+   * @param from the position where the search starts.
+   * @return int the position, Slots if every position after from is set.
+   */
+  int nextUnset(int from) const;
+  /**
+   * @brief Get the last set position.
+   *
+   * @return int the position, -1 if there is none.
+   */
+  int last(void) const;
+  /**
+   * @brief Get the number of set positions.
+   *
+   * @return int the number of set positions.
+   */
+  int count(void) const;
+  /**
+   * @brief Get the n-th set position, counting from 0.
+   *
+   * @param n the index of the position among the set ones.
+   * @return int the position, -1 if there are n or fewer set positions.
+   */
+  int nth(int n) const;
+
+ private:
+  uint64_t words[WORDS];
+};
+
+/**
+ * @brief SlotMask of a number of positions only known at runtime, for the
+ * allocators whose links can have any number of slots. The methods are the
+ * ones of SlotMask.
+ */
+template <>
+class SlotMask<0> {
+ public:
+  /**
+   * @brief Constructs a new SlotMask object with every position set.
+   *
+   * @param slots the number of positions.
+   */
+  SlotMask(int slots);
+  void remove(const uint64_t *words);
+  void fitting(int length);
+  int next(int from = 0) const;
+  int nextUnset(int from) const;
+  int last(void) const;
+  int count(void) const;
+  int nth(int n) const;
+
+ private:
+  int slots;
+  std::vector<uint64_t> words;
+};
+
+/**
+ * @brief Route policy that tries the routes in the order of the routes file.
+ */
+struct GivenOrderRoute {
+  static std::string name(void) { return "GivenOrder"; }
+  template <class Try>
+  static bool forEach(const std::vector<std::vector<Link *>> &routes,
+                      Try tryRoute);
+};
+
+/**
+ * @brief Route policy that tries the shortest routes (in length) first.
+ */
+struct ShortestFirstRoute {
+  static std::string name(void) { return "ShortestFirst"; }
+  static std::vector<int> order(
+      const std::vector<std::vector<Link *>> &routes);
+  template <class Try>
+  static bool forEach(const std::vector<std::vector<Link *>> &routes,
+                      Try tryRoute);
+};
+
+/**
+ * @brief Route policy that tries the least loaded routes first, the load of
+ * a route being the active slots of its busiest link.
+ */
+struct LeastLoadedRoute {
+  static std::string name(void) { return "LeastLoaded"; }
+  static std::vector<int> order(
+      const std::vector<std::vector<Link *>> &routes);
+  template <class Try>
+  static bool forEach(const std::vector<std::vector<Link *>> &routes,
+                      Try tryRoute);
+};
+
+/**
+ * @brief Modulation policy that uses the modulation with the fewest slots
+ * among those that reach the length of the route.
+ */
+struct MostEfficientModulation {
+  static std::string name(void) { return "MostEfficient"; }
+  static int select(const std::vector<Link *> &route, BitRate &bitRate);
+};
+
+/**
+ * @brief Modulation policy that always uses the modulation of index M,
+ * regardless of its reach. The index can also be given at runtime, as the
+ * last parameter of select.
+ */
+template <int M>
+struct FixedModulation {
+  static std::string name(void) { return "Fixed" + std::to_string(M); }
+  static int select(const std::vector<Link *> &route, BitRate &bitRate,
+                    int modulation = M);
+};
+
+/**
+ * @brief Spectrum policy that takes the lowest slots where the request fits.
+ */
+struct FirstFitSpectrum {
+  static std::string name(void) { return "FirstFit"; }
+  template <int Slots>
+  static int select(const SlotMask<Slots> &free, int length, int hops);
+};
+
+/**
+ * @brief Spectrum policy that takes the highest slots where the request
+ * fits.
+ */
+struct LastFitSpectrum {
+  static std::string name(void) { return "LastFit"; }
+  template <int Slots>
+  static int select(const SlotMask<Slots> &free, int length, int hops);
+};
+
+/**
+ * @brief Spectrum policy that takes the smallest free interval where the
+ * request fits. Ties are won by the first interval.
+ */
+struct BestFitSpectrum {
+  static std::string name(void) { return "BestFit"; }
+  template <int Slots>
+  static int select(const SlotMask<Slots> &free, int length, int hops);
+};
+
+/**
+ * @brief Spectrum policy that takes a free interval of exactly the slots of
+ * the request, or the first one where it fits if there is none.
+ */
+struct ExactFitSpectrum {
+  static std::string name(void) { return "ExactFit"; }
+  template <int Slots>
+  static int select(const SlotMask<Slots> &free, int length, int hops);
+};
+
+/**
+ * @brief Spectrum policy that uses First Fit on routes with an odd number of
+ * links and Last Fit on the others.
+ */
+struct FirstLastFitSpectrum {
+  static std::string name(void) { return "FirstLastFit"; }
+  template <int Slots>
+  static int select(const SlotMask<Slots> &free, int length, int hops);
+};
+
+#endif
+// #include "slot_mask.hpp"
+
+void SlotWords::fitting(uint64_t *words, int channels, int stride,
+                        int length) {
+  // After each pass, a position is set if it starts len set positions. A
+  // pass of step <= len extends that to len + step. Word w is updated from
+  // words w + q and w + q + 1, that haven't been updated yet; the bounds of
+  // the channel are handled out of the inner loops, which only see a
+  // constant shift and can be vectorized
+  for (int c = 0; c < channels; c++) {
+    uint64_t *channel = words + c * stride;
+    for (int len = 1; len < length;) {
+      int step = std::min(len, length - len);
+      int q = step / 64;
+      int r = step % 64;
+      int w = 0;
+      if (r == 0) {
+        for (; w + q < stride; w++) channel[w] &= channel[w + q];
+      } else {
+        for (; w + q + 1 < stride; w++) {
+          channel[w] &=
+              (channel[w + q] >> r) | (channel[w + q + 1] << (64 - r));
+        }
+        if (w + q < stride) {
+          channel[w] &= channel[w + q] >> r;
+          w++;
+        }
+      }
+      for (; w < stride; w++) channel[w] = 0;
+      len += step;
+    }
+  }
+}
+
+int SlotWords::next(const uint64_t *words, int size, int from) {
+  if (from >= size) return -1;
+  int i = from / 64;
+  int last = (size - 1) / 64;
+  uint64_t word = words[i] & (~uint64_t(0) << (from % 64));
+  while (word == 0) {
+    if (++i > last) return -1;
+    word = words[i];
+  }
+  return i * 64 + __builtin_ctzll(word);
+}
+
+int SlotWords::nextUnset(const uint64_t *words, int size, int from) {
+  if (from >= size) return size;
+  int i = from / 64;
+  int last = (size - 1) / 64;
+  uint64_t word = ~words[i] & (~uint64_t(0) << (from % 64));
+  while (word == 0) {
+    if (++i > last) return size;
+    word = ~words[i];
+  }
+  return std::min(size, i * 64 + __builtin_ctzll(word));
+}
+
+int SlotWords::last(const uint64_t *words, int size) {
+  for (int i = (size - 1) / 64; i >= 0; i--) {
+    if (words[i] != 0) return i * 64 + 63 - __builtin_clzll(words[i]);
+  }
+  return -1;
+}
+
+int SlotWords::count(const uint64_t *words, int size) {
+  int total = 0;
+  for (int i = 0; i < (size + 63) / 64; i++) {
+    total += __builtin_popcountll(words[i]);
+  }
+  return total;
+}
+
+int SlotWords::nth(const uint64_t *words, int size, int n) {
+  for (int i = 0; i < (size + 63) / 64; i++) {
+    int set = __builtin_popcountll(words[i]);
+    if (n >= set) {
+      n -= set;
+      continue;
+    }
+    uint64_t word = words[i];
+    for (; n > 0; n--) word &= word - 1;
+    return i * 64 + __builtin_ctzll(word);
+  }
+  return -1;
+}
+
+template <int Slots>
+SlotMask<Slots>::SlotMask(void) {
+  for (int i = 0; i < WORDS; i++) this->words[i] = ~uint64_t(0);
+  if (Slots % 64 != 0) {
+    this->words[WORDS - 1] = (uint64_t(1) << (Slots % 64)) - 1;
+  }
+}
+
+template <int Slots>
+void SlotMask<Slots>::remove(const uint64_t *words) {
+  for (int i = 0; i < WORDS; i++) this->words[i] &= ~words[i];
+}
+
+template <int Slots>
+void SlotMask<Slots>::fitting(int length) {
+  SlotWords::fitting(this->words, 1, WORDS, length);
+}
+
+template <int Slots>
+int SlotMask<Slots>::next(int from) const {
+  return SlotWords::next(this->words, Slots, from);
+}
+
+template <int Slots>
+int SlotMask<Slots>::nextUnset(int from) const {
+  return SlotWords::nextUnset(this->words, Slots, from);
+}
+
+template <int Slots>
+int SlotMask<Slots>::last(void) const {
+  return SlotWords::last(this->words, Slots);
+}
+
+template <int Slots>
+int SlotMask<Slots>::count(void) const {
+  return SlotWords::count(this->words, Slots);
+}
+
+template <int Slots>
+int SlotMask<Slots>::nth(int n) const {
+  return SlotWords::nth(this->words, Slots, n);
+}
+
+SlotMask<0>::SlotMask(int slots) {
+  this->slots = slots;
+  this->words.assign((slots + 63) / 64, ~uint64_t(0));
+  if (slots % 64 != 0) {
+    this->words.back() = (uint64_t(1) << (slots % 64)) - 1;
+  }
+}
+
+void SlotMask<0>::remove(const uint64_t *words) {
+  for (unsigned int i = 0; i < this->words.size(); i++) {
+    this->words[i] &= ~words[i];
+  }
+}
+
+void SlotMask<0>::fitting(int length) {
+  SlotWords::fitting(this->words.data(), 1, this->words.size(), length);
+}
+
+int SlotMask<0>::next(int from) const {
+  return SlotWords::next(this->words.data(), this->slots, from);
+}
+
+int SlotMask<0>::nextUnset(int from) const {
+  return SlotWords::nextUnset(this->words.data(), this->slots, from);
+}
+
+int SlotMask<0>::last(void) const {
+  return SlotWords::last(this->words.data(), this->slots);
+}
+
+int SlotMask<0>::count(void) const {
+  return SlotWords::count(this->words.data(), this->slots);
+}
+
+int SlotMask<0>::nth(int n) const {
+  return SlotWords::nth(this->words.data(), this->slots, n);
+}
+
+template <class Try>
+bool GivenOrderRoute::forEach(const std::vector<std::vector<Link *>> &routes,
+                              Try tryRoute) {
+  for (unsigned int r = 0; r < routes.size(); r++) {
+    if (tryRoute(routes[r])) return true;
+  }
+  return false;
+}
+
+std::vector<int> ShortestFirstRoute::order(
+    const std::vector<std::vector<Link *>> &routes) {
+  std::vector<std::pair<double, int>> keys(routes.size());
+  for (unsigned int r = 0; r < routes.size(); r++) {
+    double length = 0;
+    for (unsigned int l = 0; l < routes[r].size(); l++) {
+      length += routes[r][l]->getLength();
+    }
+    keys[r] = std::make_pair(length, r);
+  }
+  // Ties keep the order of the routes file
+  std::sort(keys.begin(), keys.end());
+  std::vector<int> order(routes.size());
+  for (unsigned int i = 0; i < keys.size(); i++) order[i] = keys[i].second;
+  return order;
+}
+
+template <class Try>
+bool ShortestFirstRoute::forEach(
+    const std::vector<std::vector<Link *>> &routes, Try tryRoute) {
+  std::vector<int> order = ShortestFirstRoute::order(routes);
+  for (unsigned int i = 0; i < order.size(); i++) {
+    if (tryRoute(routes[order[i]])) return true;
+  }
+  return false;
+}
+
+std::vector<int> LeastLoadedRoute::order(
+    const std::vector<std::vector<Link *>> &routes) {
+  std::vector<std::pair<int, int>> keys(routes.size());
+  for (unsigned int r = 0; r < routes.size(); r++) {
+    int load = 0;
+    for (unsigned int l = 0; l < routes[r].size(); l++) {
+      Link *link = routes[r][l];
+      load = std::max(load, link->getSlots() - link->getFreeSlots());
+    }
+    keys[r] = std::make_pair(load, r);
+  }
+  // Ties keep the order of the routes file
+  std::sort(keys.begin(), keys.end());
+  std::vector<int> order(routes.size());
+  for (unsigned int i = 0; i < keys.size(); i++) order[i] = keys[i].second;
+  return order;
+}
+
+template <class Try>
+bool LeastLoadedRoute::forEach(const std::vector<std::vector<Link *>> &routes,
+                               Try tryRoute) {
+  std::vector<int> order = LeastLoadedRoute::order(routes);
+  for (unsigned int i = 0; i < order.size(); i++) {
+    if (tryRoute(routes[order[i]])) return true;
+  }
+  return false;
+}
+
+int MostEfficientModulation::select(const std::vector<Link *> &route,
+                                    BitRate &bitRate) {
+  double length = 0;
+  for (unsigned int l = 0; l < route.size(); l++) {
+    length += route[l]->getLength();
+  }
+  // If fewer slots don't fit on the route, more slots don't either, so the
+  // other feasible modulations don't need to be tried
+  int best = -1;
+  for (int m = 0; m < bitRate.getNumberOfModulations(); m++) {
+    if (length > bitRate.getReach(m)) continue;
+    if (best == -1 ||
+        bitRate.getNumberOfSlots(m) < bitRate.getNumberOfSlots(best)) {
+      best = m;
+    }
+  }
+  return best;
+}
+
+template <int M>
+int FixedModulation<M>::select(const std::vector<Link *> & /* route */,
+                               BitRate &bitRate, int modulation) {
+  if (modulation >= bitRate.getNumberOfModulations()) {
+    throw std::runtime_error("The bit rate " + bitRate.getBitRateStr() +
+                             " has no modulation " +
+                             std::to_string(modulation) + ".");
+  }
+  return modulation;
+}
+
+template <int Slots>
+int FirstFitSpectrum::select(const SlotMask<Slots> &free, int length,
+                             int /* hops */) {
+  SlotMask<Slots> starts = free;
+  starts.fitting(length);
+  return starts.next();
+}
+
+template <int Slots>
+int LastFitSpectrum::select(const SlotMask<Slots> &free, int length,
+                            int /* hops */) {
+  SlotMask<Slots> starts = free;
+  starts.fitting(length);
+  return starts.last();
+}
+
+template <int Slots>
+int BestFitSpectrum::select(const SlotMask<Slots> &free, int length,
+                            int /* hops */) {
+  int best = -1;
+  int bestLength = 0;
+  for (int first = free.next(); first != -1;) {
+    int end = free.nextUnset(first);
+    if (end - first >= length && (best == -1 || end - first < bestLength)) {
+      best = first;
+      bestLength = end - first;
+    }
+    first = free.next(end);
+  }
+  return best;
+}
+
+template <int Slots>
+int ExactFitSpectrum::select(const SlotMask<Slots> &free, int length,
+                             int /* hops */) {
+  int fit = -1;
+  for (int first = free.next(); first != -1;) {
+    int end = free.nextUnset(first);
+    if (end - first == length) return first;
+    if (end - first > length && fit == -1) fit = first;
+    first = free.next(end);
+  }
+  return fit;
+}
+
+template <int Slots>
+int FirstLastFitSpectrum::select(const SlotMask<Slots> &free, int length,
+                                 int hops) {
+  return hops % 2 == 1 ? FirstFitSpectrum::select(free, length, hops)
+                       : LastFitSpectrum::select(free, length, hops);
+}
+
+#ifndef __SPECTRUM_ALLOCATOR_H__
+#define __SPECTRUM_ALLOCATOR_H__
+
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// #include "allocator.hpp"
+// #include "slot_mask.hpp"
+// #include "spectrum_index.hpp"
+
+typedef enum spectrumPolicy {
+  FIRST_FIT,
+  LAST_FIT,
+  BEST_FIT,
+  EXACT_FIT,
+  RANDOM_FIT,
+  MOST_USED,
+  FIRST_LAST_FIT
+} spectrumPolicy;
+
+typedef enum routePolicy {
+  GIVEN_ORDER,
+  SHORTEST_FIRST,
+  LEAST_LOADED_FIRST
+} routePolicy;
+
+typedef enum modulationPolicy {
+  MOST_EFFICIENT,
+  FIXED_MODULATION
+} modulationPolicy;
+
+/**
+ * @brief Class "SpectrumAllocator" which extends class father "Allocator".
+ *
+ * A library of the usual allocation algorithms, made of three policies:
+ * -The spectrum policy chooses the slots among the free intervals common to
+ * every link of a route: First Fit (lowest slots), Last Fit (highest slots),
+ * Best Fit (smallest interval that fits), Exact Fit (an interval of exactly
+ * the required slots, or First Fit), Random Fit (a uniformly random feasible
+ * position), Most Used (the position whose slots are the most used on the
+ * whole network) and First-Last Fit (First Fit on routes with an odd number
+ * of links, Last Fit on the others).
+ * -The route policy gives the order in which the routes are tried: the
+ * order of the routes file, the shortest (in length) first, or the least
+ * loaded first, the load of a route being the used slots of its busiest link.
+ * -The modulation policy chooses the modulation of the request on a route:
+ * the one that needs the fewest slots among those that reach the length of
+ * the route, or a fixed modulation, used regardless of its reach.
+ *
+ * Every combination works on the same kernel: routes whose links don't have
+ * a free block large enough are skipped in O(1) per link (see
+ * Link::getLargestFreeBlock), and the free slots of the others are combined
+ * on a SlotMask of the size of the route. The route, modulation and
+ * spectrum policies are the ones of PolicyAllocator, chosen at runtime;
+ * only Random Fit and Most Used, which need more than the route, are its
+ * own.
+ *
+ * An allocator can be selected by name, as "Spectrum/Route/Modulation",
+ * for example "BestFit/LeastLoaded/MostEfficient" or "FirstFit/GivenOrder/
+ * Fixed0". The route and modulation can be left out, and default to
+ * GivenOrder and MostEfficient.
+ *
+ * Random Fit draws from a Philox stream of the connection, keyed by the seed
+ * and the replication (see Allocator::setReplication), so its choices don't
+ * depend on the order of the allocations. Most Used reads the slots of every
+ * link of the network, so it's the only policy that can't be used on the
+ * parallel events mode of the simulator (see isParallelSafe). Its starts
+ * are scored with bestCandidate, so on links with many slots they can be
+ * scored in parallel (see setParallelCandidates).
+ */
+class SpectrumAllocator : public Allocator {
+ public:
+  /**
+   * @brief Constructs a new SpectrumAllocator object from its policies.
+   *
+   * @param spectrum the spectrum policy.
+   * @param route the route policy.
+   * @param modulation the modulation policy.
+   * @param fixedModulation the index of the modulation used by the
+   * FIXED_MODULATION policy.
+   */
+  SpectrumAllocator(spectrumPolicy spectrum, routePolicy route = GIVEN_ORDER,
+                    modulationPolicy modulation = MOST_EFFICIENT,
+                    int fixedModulation = 0);
+  /**
+   * @brief Constructs a new SpectrumAllocator object from its name, as
+   * "Spectrum/Route/Modulation" (see getSpectrumPolicies, getRoutePolicies
+   * and getModulationPolicies).
+   *
+   * @param name the name of the allocator.
+   */
+  SpectrumAllocator(std::string name);
+  /**
+   * @brief Delete the object SpectrumAllocator.
+   */
+  ~SpectrumAllocator();
+  /**
+   * @brief Allocates the connection on the first route of the route policy
+   * where the spectrum policy finds room.
+   *
+   * @param src start node, type integer.
+   * @param dst destiny node, type integer.
+   * @param bitRate the bit rate of the connection.
+   * @param con the Connection object. It's passed by reference.
+   *
+   * @return allocationStatus ALLOCATED or NOT_ALLOCATED.
+   */
+  allocationStatus exec(int src, int dst, BitRate bitRate, Connection &con);
+  /**
+   * @brief Tells if the allocator can run concurrently on disjoint routes:
+   * every policy but Most Used.
+   *
+   * @return true if the spectrum policy isn't MOST_USED.
+   */
+  bool isParallelSafe(void);
+  /**
+   * @brief Set the seed of the random numbers of the Random Fit policy. The
+   * default seed is 12345.
+   *
+   * @param seed the seed.
+   */
+  void setSeed(unsigned int seed);
+  /**
+   * @brief Get the spectrum policy.
+   *
+   * @return spectrumPolicy the spectrum policy.
+   */
+  spectrumPolicy getSpectrumPolicy(void) const;
+  /**
+   * @brief Get the route policy.
+   *
+   * @return routePolicy the route policy.
+   */
+  routePolicy getRoutePolicy(void) const;
+  /**
+   * @brief Get the modulation policy.
+   *
+   * @return modulationPolicy the modulation policy.
+   */
+  modulationPolicy getModulationPolicy(void) const;
+  /**
+   * @brief Get the names of the spectrum policies, in the order of
+   * spectrumPolicy.
+   *
+   * @return std::vector<std::string> the names.
+   */
+  static std::vector<std::string> getSpectrumPolicies(void);
+  /**
+   * @brief Get the names of the route policies, in the order of routePolicy.
+   *
+   * @return std::vector<std::string> the names.
+   */
+  static std::vector<std::string> getRoutePolicies(void);
+  /**
+   * @brief Get the names of the modulation policies. The fixed modulation is
+   * named "Fixed" followed by the index of the modulation.
+   *
+   * @return std::vector<std::string> the names, with the fixed modulation 0.
+   */
+  static std::vector<std::string> getModulationPolicies(void);
+
+ private:
+  spectrumPolicy spectrum;
+  routePolicy route;
+  modulationPolicy modulation;
+  int fixedModulation;
+  unsigned int seed;
+
+  void setName(void);
+  std::vector<int> routeOrder(
+      const std::vector<std::vector<Link *>> &routes);
+  int selectModulation(const std::vector<Link *> &route, BitRate &bitRate);
+  int selectSlot(const SlotMask<0> &free, int length, int hops,
+                 PhiloxEngine &random, std::vector<int> &usage);
+  int mostUsed(const SlotMask<0> &free, int length, std::vector<int> &usage);
+  int randomFit(const SlotMask<0> &free, int length, PhiloxEngine &random);
+};
+
+#endif
+// #include "spectrum_allocator.hpp"
+
+SpectrumAllocator::SpectrumAllocator(spectrumPolicy spectrum,
+                                     routePolicy route,
+                                     modulationPolicy modulation,
+                                     int fixedModulation)
+    : Allocator() {
+  if (fixedModulation < 0) {
+    throw std::runtime_error("Cannot use the fixed modulation " +
+                             std::to_string(fixedModulation) + ".");
+  }
+  this->spectrum = spectrum;
+  this->route = route;
+  this->modulation = modulation;
+  this->fixedModulation = fixedModulation;
+  this->seed = 12345;
+  this->setName();
+}
+
+SpectrumAllocator::SpectrumAllocator(std::string name) : Allocator() {
+  std::vector<std::string> parts;
+  size_t begin = 0;
+  while (true) {
+    size_t end = name.find('/', begin);
+    parts.push_back(name.substr(begin, end - begin));
+    if (end == std::string::npos) break;
+    begin = end + 1;
+  }
+  if (parts.size() > 3) {
+    throw std::runtime_error("Allocator name " + name +
+                             " must be Spectrum/Route/Modulation.");
+  }
+
+  std::vector<std::string> names = SpectrumAllocator::getSpectrumPolicies();
+  std::vector<std::string>::iterator found =
+      std::find(names.begin(), names.end(), parts[0]);
+  if (found == names.end()) {
+    throw std::runtime_error("Unknown spectrum policy " + parts[0] + ".");
+  }
+  this->spectrum = static_cast<spectrumPolicy>(found - names.begin());
+
+  this->route = GIVEN_ORDER;
+  if (parts.size() > 1) {
+    names = SpectrumAllocator::getRoutePolicies();
+    found = std::find(names.begin(), names.end(), parts[1]);
+    if (found == names.end()) {
+      throw std::runtime_error("Unknown route policy " + parts[1] + ".");
+    }
+    this->route = static_cast<routePolicy>(found - names.begin());
+  }
+
+  this->modulation = MOST_EFFICIENT;
+  this->fixedModulation = 0;
+  if (parts.size() > 2 && parts[2] != "MostEfficient") {
+    std::string index = parts[2].substr(std::min<size_t>(5, parts[2].size()));
+    if (parts[2].compare(0, 5, "Fixed") != 0 || index.empty() ||
+        index.find_first_not_of("0123456789") != std::string::npos) {
+      throw std::runtime_error("Unknown modulation policy " + parts[2] + ".");
+    }
+    this->modulation = FIXED_MODULATION;
+    this->fixedModulation = std::stoi(index);
+  }
+
+  this->seed = 12345;
+  this->setName();
+}
+
+SpectrumAllocator::~SpectrumAllocator() {}
+
+void SpectrumAllocator::setName(void) {
+  this->name = SpectrumAllocator::getSpectrumPolicies()[this->spectrum] +
+               "/" + SpectrumAllocator::getRoutePolicies()[this->route] + "/" +
+               (this->modulation == MOST_EFFICIENT
+                    ? std::string("MostEfficient")
+                    : "Fixed" + std::to_string(this->fixedModulation));
+}
+
+bool SpectrumAllocator::isParallelSafe(void) {
+  return this->spectrum != MOST_USED;
+}
+
+void SpectrumAllocator::setSeed(unsigned int seed) { this->seed = seed; }
+
+spectrumPolicy SpectrumAllocator::getSpectrumPolicy(void) const {
+  return this->spectrum;
+}
+
+routePolicy SpectrumAllocator::getRoutePolicy(void) const {
+  return this->route;
+}
+
+modulationPolicy SpectrumAllocator::getModulationPolicy(void) const {
+  return this->modulation;
+}
+
+std::vector<std::string> SpectrumAllocator::getSpectrumPolicies(void) {
+  return {"FirstFit", "LastFit",  "BestFit",     "ExactFit",
+          "RandomFit", "MostUsed", "FirstLastFit"};
+}
+
+std::vector<std::string> SpectrumAllocator::getRoutePolicies(void) {
+  return {"GivenOrder", "ShortestFirst", "LeastLoaded"};
+}
+
+std::vector<std::string> SpectrumAllocator::getModulationPolicies(void) {
+  return {"MostEfficient", "Fixed0"};
+}
+
+allocationStatus SpectrumAllocator::exec(int src, int dst, BitRate bitRate,
+                                         Connection &con) {
+  const std::vector<std::vector<Link *>> &routes = (*this->path)[src][dst];
+  std::vector<int> order = this->routeOrder(routes);
+  // State of the policies that need more than the route, local to the call
+  // so concurrent allocations don't share it: the Random Fit stream of the
+  // connection, and the Most Used table, computed on its first use
+  PhiloxEngine random(
+      (static_cast<uint64_t>(this->replication) << 32) | this->seed,
+      con.getId());
+  std::vector<int> usage;
+  for (unsigned int i = 0; i < order.size(); i++) {
+    const std::vector<Link *> &route = routes[order[i]];
+    int m = this->selectModulation(route, bitRate);
+    if (m == -1) continue;
+    int length = bitRate.getNumberOfSlots(m);
+    if (length > this->routeLargestFreeBlock(route)) continue;
+    int slots = route[0]->getSlots();
+    for (unsigned int l = 1; l < route.size(); l++) {
+      slots = std::min(slots, route[l]->getSlots());
+    }
+    SlotMask<0> free(slots);
+    for (unsigned int l = 0; l < route.size(); l++) {
+      free.remove(route[l]->getSlotWords());
+    }
+    int slot = this->selectSlot(free, length, route.size(), random, usage);
+    if (slot == -1) continue;
+    for (unsigned int l = 0; l < route.size(); l++) {
+      con.addLink(route[l]->getId(), slot, slot + length);
+    }
+    return ALLOCATED;
+  }
+  return NOT_ALLOCATED;
+}
+
+std::vector<int> SpectrumAllocator::routeOrder(
+    const std::vector<std::vector<Link *>> &routes) {
+  switch (this->route) {
+    case SHORTEST_FIRST:
+      return ShortestFirstRoute::order(routes);
+    case LEAST_LOADED_FIRST:
+      return LeastLoadedRoute::order(routes);
+    default:
+      break;
+  }
+  std::vector<int> order(routes.size());
+  for (unsigned int r = 0; r < routes.size(); r++) order[r] = r;
+  return order;
+}
+
+int SpectrumAllocator::selectModulation(const std::vector<Link *> &route,
+                                        BitRate &bitRate) {
+  if (this->modulation == FIXED_MODULATION) {
+    return FixedModulation<0>::select(route, bitRate, this->fixedModulation);
+  }
+  return MostEfficientModulation::select(route, bitRate);
+}
+
+int SpectrumAllocator::selectSlot(const SlotMask<0> &free, int length,
+                                  int hops, PhiloxEngine &random,
+                                  std::vector<int> &usage) {
+  switch (this->spectrum) {
+    case FIRST_FIT:
+      return FirstFitSpectrum::select(free, length, hops);
+    case LAST_FIT:
+      return LastFitSpectrum::select(free, length, hops);
+    case BEST_FIT:
+      return BestFitSpectrum::select(free, length, hops);
+    case EXACT_FIT:
+      return ExactFitSpectrum::select(free, length, hops);
+    case RANDOM_FIT:
+      return this->randomFit(free, length, random);
+    case MOST_USED:
+      return this->mostUsed(free, length, usage);
+    case FIRST_LAST_FIT:
+      return FirstLastFitSpectrum::select(free, length, hops);
+  }
+  return -1;
+}
+
+int SpectrumAllocator::randomFit(const SlotMask<0> &free, int length,
+                                 PhiloxEngine &random) {
+  SlotMask<0> starts = free;
+  starts.fitting(length);
+  int positions = starts.count();
+  if (positions == 0) return -1;
+  return starts.nth(
+      std::uniform_int_distribution<int>(0, positions - 1)(random));
+}
+
+int SpectrumAllocator::mostUsed(const SlotMask<0> &free, int length,
+                                std::vector<int> &usage) {
+  if (usage.empty()) {
+    // Every run of used slots of every link is added up with a difference
+    // array, so it costs O(words + runs) per link instead of O(slots), and
+    // only reads the links
+    int slots = 0;
+    for (int i = 0; i < this->network->getNumberOfLinks(); i++) {
+      slots = std::max(slots, this->network->getLink(i)->getSlots());
+    }
+    std::vector<int> difference(slots + 1, 0);
+    for (int i = 0; i < this->network->getNumberOfLinks(); i++) {
+      Link *link = this->network->getLink(i);
+      const uint64_t *words = link->getSlotWords();
+      int size = link->getSlots();
+      for (int first = SlotWords::next(words, size, 0); first != -1;) {
+        int end = SlotWords::nextUnset(words, size, first);
+        difference[first]++;
+        difference[end]--;
+        first = SlotWords::next(words, size, end);
+      }
+    }
+    // usage[s] is the number of used (link, slot) pairs before slot s
+    usage.assign(slots + 1, 0);
+    int used = 0;
+    for (int s = 0; s < slots; s++) {
+      used += difference[s];
+      usage[s + 1] = usage[s] + used;
+    }
+  }
+  SlotMask<0> starts = free;
+  starts.fitting(length);
+  std::vector<int> candidates;
+  for (int s = starts.next(); s != -1; s = starts.next(s + 1)) {
+    candidates.push_back(s);
+  }
+  // The most used start has the lowest score, and ties keep the first one
+  long long best = this->bestCandidate(candidates.size(), [&](long long i) {
+    int s = candidates[i];
+    return -static_cast<double>(usage[s + length] - usage[s]);
+  });
+  return best == -1 ? -1 : candidates[best];
+}
+
+#ifndef __POLICY_ALLOCATOR_H__
+#define __POLICY_ALLOCATOR_H__
+
+#include <string>
+#include <vector>
+
+// #include "allocator.hpp"
+// #include "slot_mask.hpp"
+
+/**
+ * @brief Class "PolicyAllocator" which extends class father "Allocator".
+ *
+ * The compile time counterpart of SpectrumAllocator: the route, modulation
+ * and spectrum policies are template parameters, so the only runtime
+ * dispatch left is the call to exec. The policies are inlined into it, and
+ * the free slots of a route are combined on a SlotMask of Slots positions,
+ * whose loops have constant bounds. Every link of the routes must have
+ * exactly Slots slots.
+ *
+ * Since it's an Allocator, it's used as any other, for example:
+ * \code
+ * sim.setAllocator(new PolicyAllocator<GivenOrderRoute,
+ *                                      MostEfficientModulation,
+ *                                      BestFitSpectrum, 320>());
+ * \endcode
+ *
+ * A policy is a struct with a static name method and the static method of
+ * its kind (forEach for routes, select for modulations and spectrum), so new
+ * ones can be written along the ones above.
+ */
+template <class RoutePolicy, class ModulationPolicy, class SpectrumPolicy,
+          int Slots = DEFAULT_SLOTS>
+class PolicyAllocator : public Allocator {
+ public:
+  /**
+   * @brief Constructs a new PolicyAllocator object, named as
+   * "Spectrum/Route/Modulation<Slots>".
+   */
+  PolicyAllocator(void);
+  /**
+   * @brief Delete the object PolicyAllocator.
+   */
+  ~PolicyAllocator();
+  /**
+   * @brief Allocates the connection on the first route of the route policy
+   * where the spectrum policy finds room.
+   *
+   * @param src start node, type integer.
+   * @param dst destiny node, type integer.
+   * @param bitRate the bit rate of the connection.
+   * @param con the Connection object. It's passed by reference.
+   *
+   * @return allocationStatus ALLOCATED or NOT_ALLOCATED.
+   */
+  allocationStatus exec(int src, int dst, BitRate bitRate, Connection &con);
+  /**
+   * @brief Tells if the allocator can run concurrently on disjoint routes.
+   * The policies only read the candidate routes, so it always can.
+   *
+   * @return true.
+   */
+  bool isParallelSafe(void);
+};
+
+#endif
+// #include "policy_allocator.hpp"
+
+template <class RoutePolicy, class ModulationPolicy, class SpectrumPolicy,
+          int Slots>
+PolicyAllocator<RoutePolicy, ModulationPolicy, SpectrumPolicy,
+                Slots>::PolicyAllocator(void)
+    : Allocator() {
+  this->name = SpectrumPolicy::name() + "/" + RoutePolicy::name() + "/" +
+               ModulationPolicy::name() + "<" + std::to_string(Slots) + ">";
+}
+
+template <class RoutePolicy, class ModulationPolicy, class SpectrumPolicy,
+          int Slots>
+PolicyAllocator<RoutePolicy, ModulationPolicy, SpectrumPolicy,
+                Slots>::~PolicyAllocator() {}
+
+template <class RoutePolicy, class ModulationPolicy, class SpectrumPolicy,
+          int Slots>
+bool PolicyAllocator<RoutePolicy, ModulationPolicy, SpectrumPolicy,
+                     Slots>::isParallelSafe(void) {
+  return true;
+}
+
+template <class RoutePolicy, class ModulationPolicy, class SpectrumPolicy,
+          int Slots>
+allocationStatus
+PolicyAllocator<RoutePolicy, ModulationPolicy, SpectrumPolicy, Slots>::exec(
+    int src, int dst, BitRate bitRate, Connection &con) {
+  bool allocated = RoutePolicy::forEach(
+      (*this->path)[src][dst], [&](const std::vector<Link *> &route) {
+        int m = ModulationPolicy::select(route, bitRate);
+        if (m == -1) return false;
+        int length = bitRate.getNumberOfSlots(m);
+        if (length > this->routeLargestFreeBlock(route)) return false;
+        SlotMask<Slots> free;
+        for (unsigned int l = 0; l < route.size(); l++) {
+          if (route[l]->getSlots() != Slots) {
+            throw std::runtime_error(
+                "Link " + std::to_string(route[l]->getId()) + " has " +
+                std::to_string(route[l]->getSlots()) +
+                " slots, but the allocator works on " +
+                std::to_string(Slots) + ".");
+          }
+          free.remove(route[l]->getSlotWords());
+        }
+        int slot = SpectrumPolicy::select(free, length, route.size());
+        if (slot == -1) return false;
+        for (unsigned int l = 0; l < route.size(); l++) {
+          con.addLink(route[l]->getId(), slot, slot + length);
+        }
+        return true;
+      });
+  return allocated ? ALLOCATED : NOT_ALLOCATED;
+}
+
+#ifndef __SDM_ALLOCATOR_H__
+#define __SDM_ALLOCATOR_H__
+
+#include <cstdint>
+#include <vector>
+
+// #include "allocator.hpp"
+// #include "policy_allocator.hpp"
+// #include "slot_mask.hpp"
+
+typedef enum spatialPolicy { SPATIAL_CONTINUITY, CORE_SWITCHING } spatialPolicy;
+
+/**
+ * @brief Class "SDMAllocator" which extends class father "Allocator".
+ *
+ * First fit allocator for multi-core/multi-mode (SDM) networks. Every core
+ * and mode of a link is a spatial channel, and the channels of a route are
+ * searched at once on the packed slots of the links (see
+ * Link::getSlotWords): the free slots of every channel are a single loop over
+ * channels * words, and the positions where the request fits on every channel
+ * come from the shift-and passes of SlotWords::fitting, all plain loops over
+ * contiguous words that the compiler vectorizes.
+ *
+ * With SPATIAL_CONTINUITY the connection uses the same core and mode on
+ * every link of the route. With CORE_SWITCHING it can change of core or mode
+ * from one link to the next, keeping the same slots (spectrum continuity).
+ * In both cases the lowest channel (core, then mode) is preferred, and
+ * within it the lowest slots. The modulation is the most efficient one that
+ * reaches the length of the route (see MostEfficientModulation).
+ *
+ * With a crosstalk threshold (see setCrosstalkThreshold), candidates are
+ * also checked against the adjacent cores of the fibre declared on the
+ * links (see Link::setCoreAdjacency), in O(1) per slot and adjacent core.
+ */
+class SDMAllocator : public Allocator {
+ public:
+  /**
+   * @brief Constructs a new SDMAllocator object.
+   *
+   * @param policy SPATIAL_CONTINUITY or CORE_SWITCHING.
+   */
+  SDMAllocator(spatialPolicy policy = SPATIAL_CONTINUITY);
+  /**
+   * @brief Delete the object SDMAllocator.
+   */
+  ~SDMAllocator();
+  /**
+   * @brief Allocates the connection on the first route of the routes file
+   * where it fits.
+   *
+   * @param src start node, type integer.
+   * @param dst destiny node, type integer.
+   * @param bitRate the bit rate of the connection.
+   * @param con the Connection object. It's passed by reference.
+   *
+   * @return allocationStatus ALLOCATED or NOT_ALLOCATED.
+   */
+  allocationStatus exec(int src, int dst, BitRate bitRate, Connection &con);
+  /**
+   * @brief Get the spatial policy.
+   *
+   * @return spatialPolicy the spatial policy.
+   */
+  spatialPolicy getSpatialPolicy(void) const;
+  /**
+   * @brief Limits the inter-core crosstalk: a slot can be used only if at
+   * most threshold adjacent cores use it on the same mode, both for the new
+   * connection and for the connections already on the adjacent cores.
+   *
+   * @param threshold the maximum number of adjacent cores using a slot, -1
+   * (the default) to ignore crosstalk.
+   */
+  void setCrosstalkThreshold(int threshold);
+  /**
+   * @brief Get the crosstalk threshold.
+   *
+   * @return int the maximum number of adjacent cores using a slot, -1 if
+   * crosstalk is ignored.
+   */
+  int getCrosstalkThreshold(void) const;
+
+ private:
+  spatialPolicy policy;
+  int crosstalkThreshold;
+  // Scratch words, kept between calls to avoid allocations
+  std::vector<uint64_t> free;
+  std::vector<uint64_t> linkFree;
+  std::vector<uint64_t> fit;
+
+  void freeWords(Link *link, int modes, int channels, int stride,
+                 uint64_t *words);
+  bool spatialContinuity(const std::vector<Link *> &route, int length,
+                         Connection &con);
+  bool coreSwitching(const std::vector<Link *> &route, int length,
+                     Connection &con);
+  bool crosstalkFeasible(Link *link, int core, int mode, int slot,
+                         int length);
+};
+
+#endif
+// #include "sdm_allocator.hpp"
+
+SDMAllocator::SDMAllocator(spatialPolicy policy) : Allocator() {
+  this->policy = policy;
+  this->crosstalkThreshold = -1;
+  this->name = policy == SPATIAL_CONTINUITY
+                   ? std::string("SDM First Fit (spatial continuity)")
+                   : std::string("SDM First Fit (core switching)");
+}
+
+SDMAllocator::~SDMAllocator() {}
+
+spatialPolicy SDMAllocator::getSpatialPolicy(void) const {
+  return this->policy;
+}
+
+void SDMAllocator::setCrosstalkThreshold(int threshold) {
+  if (threshold < -1) {
+    throw std::runtime_error("Cannot set a crosstalk threshold of " +
+                             std::to_string(threshold) + ".");
+  }
+  this->crosstalkThreshold = threshold;
+}
+
+int SDMAllocator::getCrosstalkThreshold(void) const {
+  return this->crosstalkThreshold;
+}
+
+bool SDMAllocator::crosstalkFeasible(Link *link, int core, int mode, int slot,
+                                     int length) {
+  if (this->crosstalkThreshold < 0) return true;
+  const std::vector<std::vector<int>> &adjacency = link->getCoreAdjacency();
+  if (adjacency.empty()) return true;
+  const std::vector<int> &adjacent = adjacency[core];
+  for (int s = slot; s < slot + length; s++) {
+    if (link->getOccupiedNeighbors(core, mode, s) > this->crosstalkThreshold)
+      return false;
+    // The connections of the adjacent cores get one more neighbor
+    for (unsigned int i = 0; i < adjacent.size(); i++) {
+      if (s < link->getSlots(adjacent[i], mode) &&
+          link->getSlot(adjacent[i], mode, s) &&
+          link->getOccupiedNeighbors(adjacent[i], mode, s) >=
+              this->crosstalkThreshold)
+        return false;
+    }
+  }
+  return true;
+}
+
+allocationStatus SDMAllocator::exec(int src, int dst, BitRate bitRate,
+                                    Connection &con) {
+  const std::vector<std::vector<Link *>> &routes = (*this->path)[src][dst];
+  for (unsigned int r = 0; r < routes.size(); r++) {
+    int m = MostEfficientModulation::select(routes[r], bitRate);
+    if (m == -1) continue;
+    int length = bitRate.getNumberOfSlots(m);
+    bool allocated = this->policy == SPATIAL_CONTINUITY
+                         ? this->spatialContinuity(routes[r], length, con)
+                         : this->coreSwitching(routes[r], length, con);
+    if (allocated) return ALLOCATED;
+  }
+  return NOT_ALLOCATED;
+}
+
+void SDMAllocator::freeWords(Link *link, int modes, int channels, int stride,
+                             uint64_t *words) {
+  for (int c = 0; c < channels; c++) {
+    int core = c / modes;
+    int mode = c % modes;
+    const uint64_t *used = link->getSlotWords(core, mode);
+    int slots = link->getSlots(core, mode);
+    for (int w = 0; w < stride; w++) {
+      // The bits after the last slot of the channel aren't free
+      uint64_t valid = w < slots / 64 ? ~uint64_t(0)
+                       : w == slots / 64 ? (uint64_t(1) << (slots % 64)) - 1
+                                         : 0;
+      words[c * stride + w] = w * 64 < slots ? ~used[w] & valid : 0;
+    }
+  }
+}
+
+bool SDMAllocator::spatialContinuity(const std::vector<Link *> &route,
+                                     int length, Connection &con) {
+  int cores = route[0]->getCores();
+  int modes = route[0]->getModes();
+  int stride = route[0]->getWordStride();
+  for (unsigned int l = 1; l < route.size(); l++) {
+    cores = std::min(cores, route[l]->getCores());
+    modes = std::min(modes, route[l]->getModes());
+    stride = std::min(stride, route[l]->getWordStride());
+  }
+  int channels = cores * modes;
+  int total = channels * stride;
+  this->free.resize(total);
+  this->linkFree.resize(total);
+
+  this->freeWords(route[0], modes, channels, stride, this->free.data());
+  for (unsigned int l = 1; l < route.size(); l++) {
+    this->freeWords(route[l], modes, channels, stride, this->linkFree.data());
+    uint64_t *free = this->free.data();
+    const uint64_t *linkFree = this->linkFree.data();
+    for (int i = 0; i < total; i++) free[i] &= linkFree[i];
+  }
+  SlotWords::fitting(this->free.data(), channels, stride, length);
+
+  for (int i = 0; i < total; i++) {
+    for (uint64_t word = this->free[i]; word != 0; word &= word - 1) {
+      int c = i / stride;
+      int slot = (i % stride) * 64 + __builtin_ctzll(word);
+      bool feasible = true;
+      for (unsigned int l = 0; l < route.size() && feasible; l++) {
+        feasible = this->crosstalkFeasible(route[l], c / modes, c % modes,
+                                           slot, length);
+      }
+      if (!feasible) continue;
+      for (unsigned int l = 0; l < route.size(); l++) {
+        con.addLink(route[l]->getId(), c / modes, c % modes, slot,
+                    slot + length);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SDMAllocator::coreSwitching(const std::vector<Link *> &route, int length,
+                                 Connection &con) {
+  int stride = route[0]->getWordStride();
+  for (unsigned int l = 1; l < route.size(); l++) {
+    stride = std::min(stride, route[l]->getWordStride());
+  }
+  // Positions where the request fits on some channel of every link. The
+  // fitting positions of every link are kept to choose its channel later
+  std::vector<int> begin(route.size() + 1, 0);
+  for (unsigned int l = 0; l < route.size(); l++) {
+    begin[l + 1] =
+        begin[l] + route[l]->getCores() * route[l]->getModes() * stride;
+  }
+  this->linkFree.resize(begin.back());
+  this->fit.assign(stride, ~uint64_t(0));
+  for (unsigned int l = 0; l < route.size(); l++) {
+    int modes = route[l]->getModes();
+    int channels = route[l]->getCores() * modes;
+    uint64_t *words = this->linkFree.data() + begin[l];
+    this->freeWords(route[l], modes, channels, stride, words);
+    SlotWords::fitting(words, channels, stride, length);
+    for (int w = 0; w < stride; w++) {
+      uint64_t any = 0;
+      for (int c = 0; c < channels; c++) any |= words[c * stride + w];
+      this->fit[w] &= any;
+    }
+  }
+
+  std::vector<int> channel(route.size());
+  for (int w = 0; w < stride; w++) {
+    for (uint64_t word = this->fit[w]; word != 0; word &= word - 1) {
+      int bit = __builtin_ctzll(word);
+      int slot = w * 64 + bit;
+      // The first channel of every link where it fits
+      bool feasible = true;
+      for (unsigned int l = 0; l < route.size() && feasible; l++) {
+        int modes = route[l]->getModes();
+        int channels = route[l]->getCores() * modes;
+        const uint64_t *words = this->linkFree.data() + begin[l];
+        channel[l] = -1;
+        for (int c = 0; c < channels && channel[l] == -1; c++) {
+          if (((words[c * stride + w] >> bit) & 1) &&
+              this->crosstalkFeasible(route[l], c / modes, c % modes, slot,
+                                      length)) {
+            channel[l] = c;
+          }
+        }
+        feasible = channel[l] != -1;
+      }
+      if (!feasible) continue;
+      for (unsigned int l = 0; l < route.size(); l++) {
+        int modes = route[l]->getModes();
+        con.addLink(route[l]->getId(), channel[l] / modes, channel[l] % modes,
+                    slot, slot + length);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifndef __K_SHORTEST_PATHS_H__
+#define __K_SHORTEST_PATHS_H__
+
+#include <limits>
+#include <string>
+#include <vector>
+
+// #include "network.hpp"
+// #include "thread_pool.hpp"
+
+typedef enum pathWeight { LENGTH, HOPS } pathWeight;
+/**
+ * @brief Class that computes the k shortest loopless paths of a Network.
+ *
+ * The KShortestPaths class implements Yen's algorithm over the Links of a
+ * Network, weighting them by their length (LENGTH) or counting hops (HOPS).
+ * Every shortest path search is an A* search over a binary heap, guided by
+ * the exact distance to the destination obtained from a reverse Dijkstra run
+ * per destination node. Since Yen's spur searches only remove nodes and links,
+ * those distances remain a valid lower bound, and most searches only expand
+ * the nodes of the path they end up returning.
+ *
+ * The computation is split by source node between the threads of a
+ * ThreadPool. Paths with the same cost are ordered by number of hops and then
+ * by their Link ids, so the result doesn't depend on the number of threads.
+ *
+ * Paths are stored as Link ids, and can be saved to (and read from) a binary
+ * cache file to skip the computation on later runs.
+ */
+class KShortestPaths {
+ public:
+  /**
+   * @brief Constructs a new KShortestPaths object over the given Network.
+   *
+   * @param network the pointer to the Network whose paths will be computed.
+   * @param weight the metric used to weight the Links, LENGTH or HOPS.
+   */
+  KShortestPaths(Network *network, pathWeight weight = LENGTH);
+  /**
+   * @brief Computes the k shortest loopless paths between every pair of
+   * different nodes of the Network.
+   *
+   * @param k the maximum number of paths between each pair of nodes.
+   * @param pool the ThreadPool used to split the work between source nodes.
+   */
+  void compute(int k, ThreadPool &pool);
+  /**
+   * @brief Get the paths between two nodes, ordered from the shortest to the
+   * longest. Each path is a vector with the Link ids from src to dst.
+   *
+   * @param src the id of the source node.
+   * @param dst the id of the destination node.
+   * @return the vector of paths between src and dst.
+   */
+  const std::vector<std::vector<int>> &getPaths(int src, int dst) const;
+  /**
+   * @brief Writes the computed paths to a binary cache file.
+   *
+   * @param filename the name of the cache file.
+   */
+  void write(std::string filename) const;
+  /**
+   * @brief Reads the paths from a binary cache file. The cache is only used if
+   * it was generated with the same k and weight for a network whose links
+   * have the same endpoints and lengths, and every cached path is a chain of
+   * existing links between its nodes.
+   *
+   * @param filename the name of the cache file.
+   * @param k the maximum number of paths between each pair of nodes.
+   * @return bool true if the cache was valid and has been loaded, false
+   * otherwise.
+   */
+  bool read(std::string filename, int k);
+
+ private:
+  struct Path {
+    double cost;
+    unsigned int deviation;
+    std::vector<int> nodes;
+    std::vector<int> links;
+    bool operator<(const Path &p) const;
+  };
+  struct Workspace {
+    std::vector<double> g;
+    std::vector<int> parentLink;
+    std::vector<unsigned int> seen;
+    std::vector<unsigned int> closed;
+    std::vector<unsigned int> removedNode;
+    std::vector<unsigned int> removedLink;
+    std::vector<std::pair<double, int>> heap;
+    unsigned int stamp;
+    unsigned int removedStamp;
+  };
+
+  Network *network;
+  pathWeight weight;
+  int numberOfNodes;
+  int k;
+  // Out links of every node in CSR format: outStart[n] .. outStart[n + 1]
+  std::vector<int> outStart;
+  std::vector<int> outLink;
+  // Same for the in links, used by the reverse Dijkstra
+  std::vector<int> inStart;
+  std::vector<int> inLink;
+  std::vector<int> linkSrc;
+  std::vector<int> linkDst;
+  std::vector<double> linkWeight;
+  // distanceTo[dst][n]: shortest distance from n to dst
+  std::vector<std::vector<double>> distanceTo;
+  // paths[src][dst][k]: Link ids of the k-th path
+  std::vector<std::vector<std::vector<std::vector<int>>>> paths;
+
+  void buildGraph(void);
+  void reverseDijkstra(int dst);
+  void yen(int src, int dst, Workspace &ws);
+  bool search(int src, int dst, Workspace &ws, Path &path);
+};
+
+#endif
+// #include "k_shortest_paths.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <set>
+
+static const char K_SHORTEST_PATHS_MAGIC[8] = {'B', 'E', 'O', 'N',
+                                               'K', 'S', 'P', '2'};
+
+bool KShortestPaths::Path::operator<(const Path &p) const {
+  if (this->cost != p.cost) return this->cost < p.cost;
+  if (this->links.size() != p.links.size())
+    return this->links.size() < p.links.size();
+  return this->links < p.links;
+}
+
+KShortestPaths::KShortestPaths(Network *network, pathWeight weight) {
+  if (network == nullptr)
+    throw std::runtime_error("Cannot compute paths without a network.");
+  this->network = network;
+  this->weight = weight;
+  this->numberOfNodes = network->getNumberOfNodes();
+  this->k = 0;
+  this->buildGraph();
+}
+
+void KShortestPaths::buildGraph(void) {
+  int numberOfLinks = this->network->getNumberOfLinks();
+  this->linkSrc = std::vector<int>(numberOfLinks);
+  this->linkDst = std::vector<int>(numberOfLinks);
+  this->linkWeight = std::vector<double>(numberOfLinks);
+  this->outStart = std::vector<int>(this->numberOfNodes + 1, 0);
+  this->inStart = std::vector<int>(this->numberOfNodes + 1, 0);
+
+  for (int l = 0; l < numberOfLinks; l++) {
+    Link *link = this->network->getLink(l);
+    if (link->getSrc() < 0 || link->getDst() < 0)
+      throw std::runtime_error("Cannot compute paths with link " +
+                               std::to_string(l) + " not connected.");
+    this->linkSrc[l] = link->getSrc();
+    this->linkDst[l] = link->getDst();
+    this->linkWeight[l] = this->weight == HOPS ? 1.0 : link->getLength();
+    this->outStart[this->linkSrc[l] + 1]++;
+    this->inStart[this->linkDst[l] + 1]++;
+  }
+  for (int n = 0; n < this->numberOfNodes; n++) {
+    this->outStart[n + 1] += this->outStart[n];
+    this->inStart[n + 1] += this->inStart[n];
+  }
+
+  this->outLink = std::vector<int>(numberOfLinks);
+  this->inLink = std::vector<int>(numberOfLinks);
+  std::vector<int> outPos(this->outStart.begin(), this->outStart.end() - 1);
+  std::vector<int> inPos(this->inStart.begin(), this->inStart.end() - 1);
+  for (int l = 0; l < numberOfLinks; l++) {
+    this->outLink[outPos[this->linkSrc[l]]++] = l;
+    this->inLink[inPos[this->linkDst[l]]++] = l;
+  }
+}
+
+void KShortestPaths::reverseDijkstra(int dst) {
+  std::vector<double> &dist = this->distanceTo[dst];
+  dist = std::vector<double>(this->numberOfNodes,
+                             std::numeric_limits<double>::infinity());
+  std::priority_queue<std::pair<double, int>,
+                      std::vector<std::pair<double, int>>,
+                      std::greater<std::pair<double, int>>>
+      heap;
+  dist[dst] = 0;
+  heap.push(std::make_pair(0.0, dst));
+  while (!heap.empty()) {
+    std::pair<double, int> top = heap.top();
+    heap.pop();
+    int n = top.second;
+    if (top.first > dist[n]) continue;
+    for (int i = this->inStart[n]; i < this->inStart[n + 1]; i++) {
+      int l = this->inLink[i];
+      double d = top.first + this->linkWeight[l];
+      if (d < dist[this->linkSrc[l]]) {
+        dist[this->linkSrc[l]] = d;
+        heap.push(std::make_pair(d, this->linkSrc[l]));
+      }
+    }
+  }
+}
+
+bool KShortestPaths::search(int src, int dst, Workspace &ws, Path &path) {
+  const std::vector<double> &h = this->distanceTo[dst];
+  if (h[src] == std::numeric_limits<double>::infinity()) return false;
+
+  // New stamp instead of clearing the workspace arrays
+  ws.stamp++;
+  std::vector<std::pair<double, int>> &heap = ws.heap;
+  std::greater<std::pair<double, int>> order;
+  heap.clear();
+  ws.g[src] = 0;
+  ws.parentLink[src] = -1;
+  ws.seen[src] = ws.stamp;
+  heap.push_back(std::make_pair(h[src], src));
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), order);
+    int n = heap.back().second;
+    heap.pop_back();
+    if (ws.closed[n] == ws.stamp) continue;
+    ws.closed[n] = ws.stamp;
+    if (n == dst) break;
+    for (int i = this->outStart[n]; i < this->outStart[n + 1]; i++) {
+      int l = this->outLink[i];
+      int m = this->linkDst[l];
+      if (ws.removedLink[l] == ws.removedStamp ||
+          ws.removedNode[m] == ws.removedStamp || ws.closed[m] == ws.stamp ||
+          h[m] == std::numeric_limits<double>::infinity())
+        continue;
+      double g = ws.g[n] + this->linkWeight[l];
+      if (ws.seen[m] != ws.stamp || g < ws.g[m] ||
+          (g == ws.g[m] && l < ws.parentLink[m])) {
+        ws.seen[m] = ws.stamp;
+        ws.g[m] = g;
+        ws.parentLink[m] = l;
+        heap.push_back(std::make_pair(g + h[m], m));
+        std::push_heap(heap.begin(), heap.end(), order);
+      }
+    }
+  }
+  if (ws.closed[dst] != ws.stamp) return false;
+
+  path.cost = ws.g[dst];
+  path.links.clear();
+  path.nodes.clear();
+  for (int n = dst; n != src; n = this->linkSrc[ws.parentLink[n]]) {
+    path.links.push_back(ws.parentLink[n]);
+    path.nodes.push_back(n);
+  }
+  path.nodes.push_back(src);
+  std::reverse(path.links.begin(), path.links.end());
+  std::reverse(path.nodes.begin(), path.nodes.end());
+  return true;
+}
+
+void KShortestPaths::yen(int src, int dst, Workspace &ws) {
+  std::vector<Path> found;
+  std::set<Path> candidates;
+  Path path;
+
+  ws.removedStamp++;
+  if (!this->search(src, dst, ws, path)) return;
+  path.deviation = 0;
+  found.push_back(path);
+
+  while (static_cast<int>(found.size()) < this->k) {
+    const Path &last = found.back();
+    // Spur nodes before the deviation node were already explored when
+    // the last path was generated (Lawler's refinement)
+    double rootCost = 0;
+    for (unsigned int i = 0; i < last.deviation; i++) {
+      rootCost += this->linkWeight[last.links[i]];
+    }
+    for (unsigned int i = last.deviation; i + 1 < last.nodes.size(); i++) {
+      int spur = last.nodes[i];
+      ws.removedStamp++;
+      // Links leaving the spur node on paths sharing this root
+      for (unsigned int p = 0; p < found.size(); p++) {
+        if (found[p].links.size() > i &&
+            std::equal(last.links.begin(), last.links.begin() + i,
+                       found[p].links.begin()))
+          ws.removedLink[found[p].links[i]] = ws.removedStamp;
+      }
+      // The root nodes can't be visited again (loopless paths)
+      for (unsigned int n = 0; n < i; n++) {
+        ws.removedNode[last.nodes[n]] = ws.removedStamp;
+      }
+
+      if (this->search(spur, dst, ws, path)) {
+        Path candidate;
+        candidate.cost = rootCost + path.cost;
+        candidate.deviation = i;
+        candidate.nodes.assign(last.nodes.begin(), last.nodes.begin() + i);
+        candidate.nodes.insert(candidate.nodes.end(), path.nodes.begin(),
+                               path.nodes.end());
+        candidate.links.assign(last.links.begin(), last.links.begin() + i);
+        candidate.links.insert(candidate.links.end(), path.links.begin(),
+                               path.links.end());
+        candidates.insert(candidate);
+      }
+      rootCost += this->linkWeight[last.links[i]];
+    }
+    if (candidates.empty()) break;
+    found.push_back(*candidates.begin());
+    candidates.erase(candidates.begin());
+  }
+
+  std::vector<std::vector<int>> &result = this->paths[src][dst];
+  result.resize(found.size());
+  for (unsigned int p = 0; p < found.size(); p++) {
+    result[p] = found[p].links;
+  }
+}
+
+void KShortestPaths::compute(int k, ThreadPool &pool) {
+  if (k < 1)
+    throw std::runtime_error("Cannot compute " + std::to_string(k) +
+                             " shortest paths.");
+  this->k = k;
+  this->paths = std::vector<std::vector<std::vector<std::vector<int>>>>(
+      this->numberOfNodes,
+      std::vector<std::vector<std::vector<int>>>(this->numberOfNodes));
+  this->distanceTo = std::vector<std::vector<double>>(this->numberOfNodes);
+
+  pool.parallelFor(0, this->numberOfNodes,
+                   [this](int dst) { this->reverseDijkstra(dst); });
+
+  pool.parallelFor(0, this->numberOfNodes, [this](int src) {
+    Workspace ws;
+    ws.g = std::vector<double>(this->numberOfNodes);
+    ws.parentLink = std::vector<int>(this->numberOfNodes);
+    ws.seen = std::vector<unsigned int>(this->numberOfNodes, 0);
+    ws.closed = std::vector<unsigned int>(this->numberOfNodes, 0);
+    ws.removedNode = std::vector<unsigned int>(this->numberOfNodes, 0);
+    ws.removedLink = std::vector<unsigned int>(this->linkSrc.size(), 0);
+    ws.stamp = 0;
+    ws.removedStamp = 0;
+    for (int dst = 0; dst < this->numberOfNodes; dst++) {
+      if (dst != src) this->yen(src, dst, ws);
+    }
+  });
+
+  // The distances are only needed while computing
+  this->distanceTo = std::vector<std::vector<double>>();
+}
+
+const std::vector<std::vector<int>> &KShortestPaths::getPaths(int src,
+                                                              int dst) const {
+  if (src < 0 || src >= static_cast<int>(this->paths.size()) || dst < 0 ||
+      dst >= static_cast<int>(this->paths.size()))
+    throw std::runtime_error("Cannot get paths of nodes out of bounds.");
+  return this->paths[src][dst];
+}
+
+void KShortestPaths::write(std::string filename) const {
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+  if (!file)
+    throw std::runtime_error("Cannot open paths cache file " + filename +
+                             ".");
+  int header[4] = {this->numberOfNodes, static_cast<int>(this->linkSrc.size()),
+                   this->k, static_cast<int>(this->weight)};
+  file.write(K_SHORTEST_PATHS_MAGIC, sizeof(K_SHORTEST_PATHS_MAGIC));
+  file.write(reinterpret_cast<const char *>(header), sizeof(header));
+  // Topology of every link, so the cache is rejected if the network changed
+  for (unsigned int l = 0; l < this->linkSrc.size(); l++) {
+    int ends[2] = {this->linkSrc[l], this->linkDst[l]};
+    float length = this->network->getLink(l)->getLength();
+    file.write(reinterpret_cast<const char *>(ends), sizeof(ends));
+    file.write(reinterpret_cast<const char *>(&length), sizeof(float));
+  }
+  for (int src = 0; src < this->numberOfNodes; src++) {
+    for (int dst = 0; dst < this->numberOfNodes; dst++) {
+      int numberOfPaths = this->paths[src][dst].size();
+      file.write(reinterpret_cast<const char *>(&numberOfPaths), sizeof(int));
+      for (int p = 0; p < numberOfPaths; p++) {
+        const std::vector<int> &links = this->paths[src][dst][p];
+        int numberOfLinks = links.size();
+        file.write(reinterpret_cast<const char *>(&numberOfLinks),
+                   sizeof(int));
+        file.write(reinterpret_cast<const char *>(links.data()),
+                   numberOfLinks * sizeof(int));
+      }
+    }
+  }
+}
+
+bool KShortestPaths::read(std::string filename, int k) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  if (!file) return false;
+
+  char magic[sizeof(K_SHORTEST_PATHS_MAGIC)];
+  int header[4];
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char *>(header), sizeof(header));
+  if (!file ||
+      !std::equal(magic, magic + sizeof(magic), K_SHORTEST_PATHS_MAGIC) ||
+      header[0] != this->numberOfNodes ||
+      header[1] != static_cast<int>(this->linkSrc.size()) || header[2] != k ||
+      header[3] != static_cast<int>(this->weight))
+    return false;
+  for (unsigned int l = 0; l < this->linkSrc.size(); l++) {
+    int ends[2];
+    float length;
+    file.read(reinterpret_cast<char *>(ends), sizeof(ends));
+    file.read(reinterpret_cast<char *>(&length), sizeof(float));
+    if (!file || ends[0] != this->linkSrc[l] || ends[1] != this->linkDst[l] ||
+        length != this->network->getLink(l)->getLength())
+      return false;
+  }
+
+  int numberOfLinks = this->linkSrc.size();
+  std::vector<std::vector<std::vector<std::vector<int>>>> cached(
+      this->numberOfNodes,
+      std::vector<std::vector<std::vector<int>>>(this->numberOfNodes));
+  for (int src = 0; src < this->numberOfNodes; src++) {
+    for (int dst = 0; dst < this->numberOfNodes; dst++) {
+      int numberOfPaths;
+      file.read(reinterpret_cast<char *>(&numberOfPaths), sizeof(int));
+      if (!file || numberOfPaths < 0 || numberOfPaths > k) return false;
+      cached[src][dst].resize(numberOfPaths);
+      for (int p = 0; p < numberOfPaths; p++) {
+        int pathLength;
+        file.read(reinterpret_cast<char *>(&pathLength), sizeof(int));
+        if (!file || pathLength < 1 || pathLength > numberOfLinks)
+          return false;
+        std::vector<int> &links = cached[src][dst][p];
+        links.resize(pathLength);
+        file.read(reinterpret_cast<char *>(links.data()),
+                  pathLength * sizeof(int));
+        if (!file) return false;
+        // Every path must be a chain of valid links from src to dst
+        int node = src;
+        for (int l = 0; l < pathLength; l++) {
+          if (links[l] < 0 || links[l] >= numberOfLinks ||
+              this->linkSrc[links[l]] != node)
+            return false;
+          node = this->linkDst[links[l]];
+        }
+        if (node != dst) return false;
+      }
+    }
+  }
+  this->k = k;
+  this->paths = cached;
+  return true;
+}
+
+#ifndef __CONTROLLER_H__
+#define __CONTROLLER_H__
+
+// #include "allocator.hpp"
+// #include "connection.hpp"
+// #include "k_shortest_paths.hpp"
+// #include "network.hpp"
+
+#include <ctime>
+
+/**
+ * @brief Events that trigger a defragmentation of the spectrum (see
+ * Controller::setDefragmentation).
+ *
+ * -NO_DEFRAGMENTATION: the spectrum is never defragmented.
+ * -DEFRAGMENT_ON_BLOCK: when a connection is blocked, the links of its
+ * candidate routes are defragmented and the allocation is retried once.
+ * -DEFRAGMENT_PERIODICALLY: the whole network is defragmented every time
+ * the given period elapses.
+ * -DEFRAGMENT_ON_THRESHOLD: the whole network is defragmented when its
+ * external fragmentation (see Network::getExternalFragmentation) rises above
+ * the given threshold.
+ */
+typedef enum defragmentationTrigger {
+  NO_DEFRAGMENTATION,
+  DEFRAGMENT_ON_BLOCK,
+  DEFRAGMENT_PERIODICALLY,
+  DEFRAGMENT_ON_THRESHOLD
+} defragmentationTrigger;
+
+/**
+ * @brief Class with the controller information.
+ *
+ * This class allows you to create the object Controller and manipulate it by
+ * its methods. The importance of this object is that it handles connection
+ * requests generated inside the Simulator by executing an allocation algorithm
+ * from the Allocator object on the network. Once the process is completed, it
+ * returns the result to the simulator. The Controller is the link between the
+ * Simulator and the Network.
+ *
+ */
+class Controller {
+ public:
+  /**
+   * @brief Constructs a new Controller object. The attribute connections is
+   * assigned to an empty Connection vector. This object does not have a network
+   * or connections registered.
+   *
+   */
+  Controller();
+  /**
+   * @brief Constructs a new Controller object. It takes a Network object and
+   * stores it as an attribute. An empty Connection vector is created and
+   * stored as well.
+   *
+   * @param network The pointer type Network object. This contains all
+   * the information about the network, nodes, routes, path length and slots.
+   */
+  Controller(Network *network);
+  /**
+   * @brief Delete the Controller object.
+   *
+   */
+  ~Controller();
+  /**
+   * @brief Assigns a connection between a source and a destination node through
+   * an allocation method from the allocator. It creates a connection object
+   * with idConnection as its id, upon which the connections between nodes are
+   * generated.
+   *
+   * @param src the source node of the connection.
+   * @param dst the destination node of the connection.
+   * @param bitRate the bitRate object of the connection.
+   * @param idConnection the id of the new connection object. It serves to
+   * identify the connection within the attribute connections.
+   * @return the result of the allocation process, whether the
+   * allocation was succesful or not. This is type allocationStatus, there are
+   * three states: ALLOCATED, NOT_ALLOCATED, N_A (not assigned).
+   */
+  allocationStatus assignConnection(int src, int dst, BitRate bitRate,
+                                    long long idConnection, double time);
+  /**
+   * @brief Unnasigns the requested connection making the resources that were
+   * being used become available again. It deactivates the slots that were
+   * taken in the connection.
+   *
+   * @param idConnection the id of the Connection object. It serves to
+   * identify the connection within the attribute connections.
+   * @return int number zero if unsuccessful.
+   */
+  int (Controller::*unassignConnection)(long long idConnection, double time);
+  /**
+   * @brief Sets the paths vector from the routes on the JSON file. From this
+   file, the method creates the paths vector based on an array of routes. This
+   array contains the source and destination nodes, as well as an array with all
+   the existing paths between them. The path vector is important because it is
+   all the nodes and the respective routes that link them
+   *
+   *
+   * In the example below, the network consists of three nodes: 0, 1 and 2. Node
+   0 is connected to node 1 directly and through node 2, to which it's directly
+   connected as well. Node 2 is connected directly to node one. All the
+   connections are unidirectional.
+   *
+   *
+   * @param filename name of the JSON file that contains the routes. Example of
+   this: "routes.json"
+   * \code{.json}
+     {
+      "name": "Example routes between 3 nodes",
+      "alias": "example",
+      "routes": [
+        {
+          "src": 0,
+          "dst": 1,
+          "paths": [
+            [
+              0,
+              1
+            ],
+            [
+              0,
+              2,
+              1
+            ]
+          ]
+        },
+        {
+          "src": 0,
+          "dst": 2,
+          "paths": [
+            [
+              0,
+              2
+            ]
+          ]
+        },
+        {
           "src": 2,
           "dst": 1,
           "paths": [
@@ -28018,343 +32664,1744 @@ class Controller {
             ]
           ]
         }
-      ]
-     };
-    \endcode
+      ]
+     };
+    \endcode
+   *
+   */
+  void setPaths(std::string filename);
+  /**
+   * @brief Sets the paths vector computing the k shortest loopless paths
+   * between every pair of nodes of the network, instead of reading them from a
+   * routes JSON file. The computation uses Yen's algorithm (see the
+   * KShortestPaths class) and is split between all the hardware threads.
+   *
+   * If a cache file name is given and the file holds the paths of a network
+   * with the same links (endpoints and lengths), for the same k and weight,
+   * the paths are read from it. Otherwise, they are computed and written to it.
+   *
+   * @param k the maximum number of paths between each pair of nodes.
+   * @param weight the metric used to weight the links, LENGTH or HOPS.
+   * @param cacheFilename name of the binary cache file. If empty, the paths
+   * are always computed and not cached.
+   */
+  void setPaths(int k, pathWeight weight = LENGTH,
+                std::string cacheFilename = std::string());
+  /**
+   * @brief Sets the Network object as the network attribute of the controller.
+   * This is the network that the controller will now handle and who will
+   * interact with the simulator
+   *
+   * @param network The pointer type Network object. This contains all
+   * the information about the network, nodes, routes, path length and slots.
+   */
+  void setNetwork(Network *network);
+  /**
+   * @brief Get the Network in the controller. The return contains all
+   * the information about the network, nodes, routes, path length and slots.
+   *
+   * @return Network. a pointer to the network object from the controller. This
+   * is the network the controller is currently using
+   */
+  Network *getNetwork(void);
+  /**
+   * @brief Set the allocator of the controller. The allocator determines how
+   * the connections will be assigned in the network.
+   *
+   * @param allocator A pointer to the allocator object.
+   */
+  void setAllocator(Allocator *allocator);
+  /**
+   * @brief Get the Allocator object of the controller. The allocator determines
+   * how the connections will be assigned in the network.
+   *
+   * @return Allocator* a pointer to the allocator object.
+   */
+  Allocator *getAllocator(void);
+  /**
+   * @brief Get the Paths vector. This vector represents all the routes present
+   * in the network between the source and destination nodes.
+   *
+   * @return a pointer to the four dimensional vector which represents the
+   * paths.
+   */
+  std::vector<std::vector<std::vector<std::vector<Link *>>>> *getPaths();
+
+  void setUnassignCallback(void (*callbackFunction)(Connection, double,
+                                                    Network *));
+  /**
+   * @brief Releases the slots of every active connection, without calling
+   * the unassign callback, leaving the network empty for a new replication.
+   * The storage of the connections of the run, active or recycled, is freed
+   * at once.
+   *
+   */
+  void reset(void);
+  /**
+   * @brief Executes the allocator for a connection and uses the slots it
+   * chose, without registering it as an active connection (see
+   * addConnection). The controller itself isn't modified, so connections
+   * whose candidate routes share no link can be allocated concurrently, as
+   * long as the allocator only reads the links of those routes and keeps no
+   * mutable state of its own.
+   *
+   * @param src the source node of the connection.
+   * @param dst the destination node of the connection.
+   * @param bitRate the bit rate of the connection.
+   * @param connection the connection, where the allocator adds the links and
+   * slots it uses.
+   * @return allocationStatus ALLOCATED or NOT_ALLOCATED.
+   */
+  allocationStatus allocate(int src, int dst, BitRate bitRate,
+                            Connection &connection);
+  /**
+   * @brief Registers an allocated connection as active, so it can be
+   * unassigned later.
+   *
+   * @param connection the allocated connection.
+   */
+  void addConnection(Connection connection);
+  /**
+   * @brief Unregisters an active connection, without releasing its slots
+   * (see release).
+   *
+   * @param idConnection the id of the connection.
+   * @param connection where the removed connection is copied.
+   * @return true if the connection was active, false otherwise.
+   */
+  bool removeConnection(long long idConnection, Connection &connection);
+  /**
+   * @brief Releases the slots used by a connection. Like allocate, it can run
+   * concurrently for connections on different links.
+   *
+   * The connection must have been placed by this Controller: its slots were
+   * validated then, so they are only checked again on builds that define
+   * BUFFEREON_CHECKED.
+   *
+   * @param connection the connection.
+   */
+  void release(const Connection &connection);
+  /**
+   * @brief Takes back the slots of a released connection, as when it was
+   * allocated. Used by the parallel events mode to roll back a window.
+   *
+   * @param connection the connection.
+   */
+  void occupy(const Connection &connection);
+  /**
+   * @brief Enables the defragmentation of the spectrum, which is run by
+   * assignConnection before or after allocating a connection, depending on
+   * the trigger. The parallel events mode of the Simulator doesn't
+   * defragment.
+   *
+   * @param trigger the event that triggers a defragmentation.
+   * @param parameter the period between defragmentations for
+   * DEFRAGMENT_PERIODICALLY, or the external fragmentation between 0 and 1
+   * above which the network is defragmented for DEFRAGMENT_ON_THRESHOLD.
+   */
+  void setDefragmentation(defragmentationTrigger trigger,
+                          double parameter = 0);
+  /**
+   * @brief Get the event that triggers a defragmentation of the spectrum.
+   *
+   * @return defragmentationTrigger the trigger, NO_DEFRAGMENTATION if it's
+   * disabled.
+   */
+  defragmentationTrigger getDefragmentationTrigger(void);
+  /**
+   * @brief Defragments the spectrum of the whole network. Every active
+   * connection, from the lowest slots to the highest, is moved to the lowest
+   * slots below its own that are free on all of its links, keeping its route,
+   * cores and modes. If the new slots overlap the old ones, the connection is
+   * slid down (push-pull); otherwise the new slots are used before the old
+   * ones are released (make-before-break hop tuning). Each move is applied as
+   * one range update per link.
+   *
+   * Connections whose slots aren't contiguous or aren't the same on all of
+   * their links are not moved. The crosstalk between cores isn't checked on
+   * the new slots.
+   *
+   * @return int the number of connections moved.
+   */
+  int defragment(void);
+  /**
+   * @brief Get the number of defragmentations run since the last reset.
+   *
+   * @return long long the number of defragmentations.
+   */
+  long long getDefragmentations(void);
+  /**
+   * @brief Get the number of connections moved by the defragmentations run
+   * since the last reset.
+   *
+   * @return long long the number of connections moved.
+   */
+  long long getMovedConnections(void);
+  /**
+   * @brief Get the CPU time spent on the defragmentations run since the last
+   * reset.
+   *
+   * @return double the CPU time in seconds.
+   */
+  double getDefragmentationTime(void);
+  /**
+   * @brief Opens a transaction. Until it's committed or rolled back, every
+   * connection assigned through assignConnection is placed on the network
+   * right away, so the next allocations of the transaction see it, and the
+   * ranges of slots it changed are kept on an undo log. This way a group of
+   * connections, like the working and protection paths of a 1+1 connection
+   * or the requests drained from a buffer, is placed all or nothing.
+   *
+   * Connections can't be unassigned and the spectrum isn't defragmented
+   * while a transaction is open. Transactions aren't thread safe, so the
+   * parallel events mode doesn't use them.
+   *
+   */
+  void beginTransaction(void);
+  /**
+   * @brief Closes the open transaction keeping the connections placed on it.
+   *
+   */
+  void commitTransaction(void);
+  /**
+   * @brief Closes the open transaction undoing every change of the spectrum
+   * made on it, in reverse order, and unregistering the connections placed
+   * on it.
+   *
+   */
+  void rollbackTransaction(void);
+  /**
+   * @brief Tells if there is an open transaction.
+   *
+   * @return true if a transaction was begun and not committed or rolled back
+   * yet.
+   */
+  bool hasOpenTransaction(void);
+
+ private:
+  Network *network;
+  Allocator *allocator;
+  std::vector<std::vector<std::vector<std::vector<Link *>>>> path;
+  std::vector<Connection> connections;
+  // Connections already unassigned or blocked, whose vectors are reused by
+  // the next arrivals instead of allocating new ones
+  std::vector<Connection> connectionPool;
+  allocationStatus rtnAllocation;
+  defragmentationTrigger defragmentationMode;
+  double defragmentationParameter;
+  double nextDefragmentation;
+  bool aboveThreshold;
+  long long defragmentations;
+  long long movedConnections;
+  std::clock_t defragmentationClock;
+  std::vector<uint64_t> usedWords;
+  // Ranges of slots changed inside the open transaction, and the number of
+  // active connections when it began
+  struct SpectrumChange {
+    int link;
+    int core;
+    int mode;
+    int from;
+    int to;
+    bool used;
+  };
+  bool transactionOpen;
+  unsigned int transactionStart;
+  std::vector<SpectrumChange> undoLog;
+
+  int unassignConnectionNormal(long long idConnection, double time);
+  int unassignConnectionWCallback(long long idConnection, double time);
+  Connection newConnection(long long id, double time, BitRate *bitRate);
+  void recycleConnection(Connection &connection);
+  void validateSlots(const Connection &connection, bool used);
+  void changeSlots(const Connection &connection, bool used);
+  void changeRange(int link, int core, int mode, int from, int to, bool used);
+  static unsigned int runEnd(const std::vector<int> &slots, unsigned int from);
+  int defragment(const std::vector<int> &links);
+  bool moveDown(Connection &connection);
+  void (*unassignCallback)(Connection c, double time, Network *n);
+};
+
+#endif
+// #include "controller.hpp"
+
+#include <fstream>
+
+Controller::Controller() {
+  this->connections = std::vector<Connection>();
+  this->network = nullptr;
+  this->allocator = new Allocator;
+  this->unassignConnection = &Controller::unassignConnectionNormal;
+  this->setDefragmentation(NO_DEFRAGMENTATION);
+  this->transactionOpen = false;
+  this->transactionStart = 0;
+};
+
+Controller::Controller(Network *network) {
+  this->network = network;
+  this->connections = std::vector<Connection>();
+  this->allocator = new Allocator;
+  this->unassignConnection = &Controller::unassignConnectionNormal;
+  this->setDefragmentation(NO_DEFRAGMENTATION);
+  this->transactionOpen = false;
+  this->transactionStart = 0;
+};
+
+Controller::~Controller() {
+  if (this->network != nullptr) {
+    for (int i = 0; i < this->network->getNumberOfLinks(); i++) {
+      delete this->network->getLink(i);
+    }
+    for (int i = 0; i < this->network->getNumberOfNodes(); i++) {
+      delete this->network->getNode(i);
+    }
+  }
+  delete this->allocator;
+};
+
+allocationStatus Controller::assignConnection(int src, int dst, BitRate bitRate,
+                                              long long idConnection,
+                                              double time) {
+  if (this->transactionOpen) {
+    // The spectrum isn't defragmented inside a transaction
+  } else if (this->defragmentationMode == DEFRAGMENT_PERIODICALLY &&
+             time >= this->nextDefragmentation) {
+    this->defragment();
+    while (this->nextDefragmentation <= time)
+      this->nextDefragmentation += this->defragmentationParameter;
+  } else if (this->defragmentationMode == DEFRAGMENT_ON_THRESHOLD) {
+    // Only a crossing of the threshold triggers a defragmentation, so a
+    // network that stays fragmented isn't defragmented on every arrival
+    bool above = this->network->getExternalFragmentation() >
+                 this->defragmentationParameter;
+    if (above && !this->aboveThreshold) {
+      this->defragment();
+      above = this->network->getExternalFragmentation() >
+              this->defragmentationParameter;
+    }
+    this->aboveThreshold = above;
+  }
+  Connection con = this->newConnection(idConnection, time, &bitRate);
+  this->rtnAllocation = this->allocator->exec(src, dst, bitRate, con);
+  if (this->rtnAllocation != ALLOCATED && !this->transactionOpen &&
+      this->defragmentationMode == DEFRAGMENT_ON_BLOCK) {
+    std::vector<int> links;
+    std::vector<bool> added(this->network->getNumberOfLinks(), false);
+    for (unsigned int r = 0; r < this->path[src][dst].size(); r++) {
+      for (unsigned int l = 0; l < this->path[src][dst][r].size(); l++) {
+        int id = this->path[src][dst][r][l]->getId();
+        if (!added[id]) links.push_back(id);
+        added[id] = true;
+      }
+    }
+    if (this->defragment(links) > 0) {
+      con.recycle(idConnection, time, &bitRate);
+      this->rtnAllocation = this->allocator->exec(src, dst, bitRate, con);
+    }
+  }
+  if (this->rtnAllocation == ALLOCATED) {
+    this->occupy(con);
+    this->connections.push_back(std::move(con));
+  } else {
+    this->recycleConnection(con);
+  }
+  return this->rtnAllocation;
+}
+
+Connection Controller::newConnection(long long id, double time,
+                                     BitRate *bitRate) {
+  if (this->connectionPool.empty()) return Connection(id, time, bitRate);
+  Connection connection = std::move(this->connectionPool.back());
+  this->connectionPool.pop_back();
+  connection.recycle(id, time, bitRate);
+  return connection;
+}
+
+void Controller::recycleConnection(Connection &connection) {
+  this->connectionPool.push_back(std::move(connection));
+}
+
+int Controller::unassignConnectionNormal(long long idConnection, double time) {
+  if (this->transactionOpen)
+    throw std::runtime_error(
+        "Cannot unassign a connection inside a transaction.");
+  for (unsigned int i = 0; i < this->connections.size(); i++) {
+    if (this->connections[i].id == idConnection) {
+      this->release(this->connections[i]);
+      this->recycleConnection(this->connections[i]);
+      this->connections.erase(this->connections.begin() + i);
+      break;
+    }
+  }
+  return 0;
+}
+
+int Controller::unassignConnectionWCallback(long long idConnection,
+                                            double time) {
+  if (this->transactionOpen)
+    throw std::runtime_error(
+        "Cannot unassign a connection inside a transaction.");
+  for (unsigned int i = 0; i < this->connections.size(); i++) {
+    if (this->connections[i].id == idConnection) {
+      this->unassignCallback(this->connections[i], time, this->network);
+      this->release(this->connections[i]);
+      this->recycleConnection(this->connections[i]);
+      this->connections.erase(this->connections.begin() + i);
+      break;
+    }
+  }
+  return 0;
+}
+
+void Controller::setPaths(std::string filename) {
+  // open JSON file
+  std::ifstream file(filename);
+  nlohmann::json filePaths;
+  file >> filePaths;
+
+  int numberOfNodes;
+  numberOfNodes = this->network->getNumberOfNodes();
+
+  // allocate space for path[src]
+  this->path.resize(numberOfNodes);
+
+  // allocate space for path[src][dst]
+  for (int t = 0; t < numberOfNodes; t++) {
+    this->path[t].resize(numberOfNodes);
+  }
+
+  int routesNumber;
+  routesNumber = filePaths["routes"].size();
+
+  for (int i = 0; i < routesNumber; i++) {
+    int pathsNumber;
+    pathsNumber = filePaths["routes"][i]["paths"].size();
+    int src, dst;
+    src = filePaths["routes"][i]["src"];
+    dst = filePaths["routes"][i]["dst"];
+
+    // allocate path[src][dst][pathsNumber]
+    int linksInPath;
+    linksInPath = pathsNumber - 1;
+    // because 3 nodes has 2 links
+    this->path[src][dst].resize(pathsNumber);
+
+    // go through available routes
+    for (int b = 0; b < pathsNumber; b++) {
+      int nodesPathNumber;
+      nodesPathNumber = filePaths["routes"][i]["paths"][b].size();
+      int lastNode = nodesPathNumber - 1;
+
+      for (int c = 0; c < lastNode; c++) {
+        int actNode, nextNode;
+        actNode = filePaths["routes"][i]["paths"][b][c];
+        nextNode = filePaths["routes"][i]["paths"][b][c + 1];
+
+        int idLink;
+        idLink = this->network->isConnected(actNode, nextNode);
+
+        this->path[src][dst][b].push_back(this->network->getLink(idLink));
+      }
+    }
+  }
+}
+
+void Controller::setPaths(int k, pathWeight weight,
+                          std::string cacheFilename) {
+  KShortestPaths routes(this->network, weight);
+  if (cacheFilename.empty() || !routes.read(cacheFilename, k)) {
+    ThreadPool pool;
+    routes.compute(k, pool);
+    if (!cacheFilename.empty()) routes.write(cacheFilename);
+  }
+
+  int numberOfNodes = this->network->getNumberOfNodes();
+  this->path = std::vector<std::vector<std::vector<std::vector<Link *>>>>(
+      numberOfNodes, std::vector<std::vector<std::vector<Link *>>>(
+                         numberOfNodes));
+  for (int src = 0; src < numberOfNodes; src++) {
+    for (int dst = 0; dst < numberOfNodes; dst++) {
+      const std::vector<std::vector<int>> &paths = routes.getPaths(src, dst);
+      this->path[src][dst].resize(paths.size());
+      for (unsigned int b = 0; b < paths.size(); b++) {
+        for (unsigned int l = 0; l < paths[b].size(); l++) {
+          this->path[src][dst][b].push_back(
+              this->network->getLink(paths[b][l]));
+        }
+      }
+    }
+  }
+}
+
+void Controller::setNetwork(Network *network) { this->network = network; }
+
+Network *Controller::getNetwork(void) { return this->network; }
+
+void Controller::setAllocator(Allocator *allocator) {
+  this->allocator = allocator;
+}
+
+Allocator *Controller::getAllocator(void) { return this->allocator; }
+
+std::vector<std::vector<std::vector<std::vector<Link *>>>>
+    *Controller::getPaths() {
+  return &(this->path);
+}
+
+void Controller::setUnassignCallback(void (*callbackFunction)(Connection,
+                                                              double,
+                                                              Network *)) {
+  this->unassignConnection = &Controller::unassignConnectionWCallback;
+  this->unassignCallback = callbackFunction;
+}
+
+allocationStatus Controller::allocate(int src, int dst, BitRate bitRate,
+                                      Connection &connection) {
+  allocationStatus status = this->allocator->exec(src, dst, bitRate, connection);
+  if (status == ALLOCATED) this->occupy(connection);
+  return status;
+}
+
+void Controller::addConnection(Connection connection) {
+  this->connections.push_back(std::move(connection));
+}
+
+bool Controller::removeConnection(long long idConnection,
+                                  Connection &connection) {
+  for (unsigned int i = 0; i < this->connections.size(); i++) {
+    if (this->connections[i].id == idConnection) {
+      connection = std::move(this->connections[i]);
+      this->connections.erase(this->connections.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Controller::occupy(const Connection &connection) {
+  this->changeSlots(connection, true);
+}
+
+void Controller::release(const Connection &connection) {
+  this->changeSlots(connection, false);
+}
+
+unsigned int Controller::runEnd(const std::vector<int> &slots,
+                                unsigned int from) {
+  unsigned int end = from + 1;
+  while (end < slots.size() && slots[end] == slots[end - 1] + 1) end++;
+  return end;
+}
+
+void Controller::validateSlots(const Connection &connection, bool used) {
+  // The only check of the slots of a connection on builds without
+  // BUFFEREON_CHECKED: every run of consecutive slots must be in bounds, in
+  // the opposite state and apart from the other runs of its core and mode
+  for (unsigned int j = 0; j < connection.links.size(); j++) {
+    int link = connection.links[j];
+    if (link < 0 || link >= this->network->getNumberOfLinks())
+      throw std::runtime_error("Link position out of bounds.");
+    const std::vector<int> &slots = connection.slots[j];
+    for (unsigned int k = 0; k < slots.size(); k = runEnd(slots, k)) {
+      int from = slots[k];
+      int to = slots[runEnd(slots, k) - 1] + 1;
+      if (!this->network->getLink(link)->isRangeInState(
+              connection.cores[j], connection.modes[j], from, to, !used))
+        throw std::runtime_error("Slot already setted in desired state.");
+      for (unsigned int i = 0; i <= j; i++) {
+        if (connection.links[i] != link ||
+            connection.cores[i] != connection.cores[j] ||
+            connection.modes[i] != connection.modes[j])
+          continue;
+        const std::vector<int> &other = connection.slots[i];
+        unsigned int last = i < j ? other.size() : k;
+        for (unsigned int r = 0; r < last; r = runEnd(other, r)) {
+          if (other[r] < to && other[runEnd(other, r) - 1] + 1 > from)
+            throw std::runtime_error("Slot used twice by the connection.");
+        }
+      }
+    }
+  }
+}
+
+void Controller::changeSlots(const Connection &connection, bool used) {
+  // The consecutive slots of every link are changed as one range, and if a
+  // range fails the ones changed before are reverted, so the connection is
+  // placed or released whole or not at all. The slots of a released
+  // connection were validated when it was placed, and every move of the
+  // defragmentation keeps them in use, so they are only checked on placement
+  if (used || CHECK_SLOTS) this->validateSlots(connection, used);
+  unsigned int mark = this->undoLog.size();
+  unsigned int j = 0;
+  unsigned int k = 0;
+  try {
+    for (j = 0; j < connection.links.size(); j++) {
+      const std::vector<int> &slots = connection.slots[j];
+      for (k = 0; k < slots.size(); k = runEnd(slots, k)) {
+        this->changeRange(connection.links[j], connection.cores[j],
+                          connection.modes[j], slots[k],
+                          slots[runEnd(slots, k) - 1] + 1, used);
+      }
+    }
+  } catch (...) {
+    for (unsigned int i = 0; i <= j && i < connection.links.size(); i++) {
+      const std::vector<int> &slots = connection.slots[i];
+      unsigned int last = i < j ? slots.size() : k;
+      for (unsigned int r = 0; r < last; r = runEnd(slots, r)) {
+        this->changeRange(connection.links[i], connection.cores[i],
+                          connection.modes[i], slots[r],
+                          slots[runEnd(slots, r) - 1] + 1, !used);
+      }
+    }
+    if (this->transactionOpen) this->undoLog.resize(mark);
+    throw;
+  }
+}
+
+void Controller::changeRange(int link, int core, int mode, int from, int to,
+                             bool used) {
+  if (core == 0 && mode == 0) {
+    if (used) {
+      this->network->useSlot(link, from, to);
+    } else {
+      this->network->unuseSlot(link, from, to);
+    }
+  } else {
+    if (used) {
+      this->network->useSlot(link, core, mode, from, to);
+    } else {
+      this->network->unuseSlot(link, core, mode, from, to);
+    }
+  }
+  if (this->transactionOpen) {
+    SpectrumChange change = {link, core, mode, from, to, used};
+    this->undoLog.push_back(change);
+  }
+}
+
+void Controller::beginTransaction(void) {
+  if (this->transactionOpen)
+    throw std::runtime_error("A transaction is already open.");
+  this->transactionOpen = true;
+  this->transactionStart = this->connections.size();
+}
+
+void Controller::commitTransaction(void) {
+  if (!this->transactionOpen)
+    throw std::runtime_error("There is no open transaction.");
+  this->undoLog.clear();
+  this->transactionOpen = false;
+}
+
+void Controller::rollbackTransaction(void) {
+  if (!this->transactionOpen)
+    throw std::runtime_error("There is no open transaction.");
+  this->transactionOpen = false;
+  for (int i = this->undoLog.size() - 1; i >= 0; i--) {
+    const SpectrumChange &change = this->undoLog[i];
+    this->changeRange(change.link, change.core, change.mode, change.from,
+                      change.to, !change.used);
+  }
+  this->undoLog.clear();
+  for (unsigned int i = this->transactionStart; i < this->connections.size();
+       i++)
+    this->recycleConnection(this->connections[i]);
+  this->connections.erase(this->connections.begin() + this->transactionStart,
+                          this->connections.end());
+}
+
+bool Controller::hasOpenTransaction(void) { return this->transactionOpen; }
+
+void Controller::reset(void) {
+  for (unsigned int i = 0; i < this->connections.size(); i++) {
+    this->release(this->connections[i]);
+  }
+  // The connections of the run are freed at once, instead of keeping the
+  // storage of its busiest moment for the next one
+  std::vector<Connection>().swap(this->connections);
+  std::vector<Connection>().swap(this->connectionPool);
+  this->undoLog.clear();
+  this->transactionOpen = false;
+  this->setDefragmentation(this->defragmentationMode,
+                           this->defragmentationParameter);
+}
+
+void Controller::setDefragmentation(defragmentationTrigger trigger,
+                                    double parameter) {
+  if (trigger == DEFRAGMENT_PERIODICALLY && parameter <= 0)
+    throw std::runtime_error("The defragmentation period must be positive.");
+  if (trigger == DEFRAGMENT_ON_THRESHOLD && (parameter < 0 || parameter > 1))
+    throw std::runtime_error(
+        "The fragmentation threshold must be between 0 and 1.");
+  this->defragmentationMode = trigger;
+  this->defragmentationParameter = parameter;
+  this->nextDefragmentation =
+      trigger == DEFRAGMENT_PERIODICALLY ? parameter : 0;
+  this->aboveThreshold = false;
+  this->defragmentations = 0;
+  this->movedConnections = 0;
+  this->defragmentationClock = 0;
+}
+
+defragmentationTrigger Controller::getDefragmentationTrigger(void) {
+  return this->defragmentationMode;
+}
+
+int Controller::defragment(void) {
+  if (this->transactionOpen)
+    throw std::runtime_error(
+        "Cannot defragment the spectrum inside a transaction.");
+  std::vector<int> links(this->network->getNumberOfLinks());
+  for (unsigned int i = 0; i < links.size(); i++) links[i] = i;
+  return this->defragment(links);
+}
+
+int Controller::defragment(const std::vector<int> &links) {
+  std::clock_t start = std::clock();
+  std::vector<bool> defragmented(this->network->getNumberOfLinks(), false);
+  for (unsigned int l = 0; l < links.size(); l++) defragmented[links[l]] = true;
+
+  // Connections on the defragmented links, from the lowest first slot to
+  // the highest, so every move makes room for the next ones. They are
+  // found in a single pass over the active connections, each added once
+  std::vector<std::pair<int, int>> candidates;
+  for (unsigned int i = 0; i < this->connections.size(); i++) {
+    const Connection &con = this->connections[i];
+    if (con.links.empty() || con.slots[0].empty()) continue;
+    for (unsigned int j = 0; j < con.links.size(); j++) {
+      if (defragmented[con.links[j]]) {
+        candidates.push_back(std::make_pair(con.slots[0][0], i));
+        break;
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  int moved = 0;
+  for (unsigned int c = 0; c < candidates.size(); c++) {
+    if (this->moveDown(this->connections[candidates[c].second])) moved++;
+  }
+  this->defragmentations++;
+  this->movedConnections += moved;
+  this->defragmentationClock += std::clock() - start;
+  return moved;
+}
+
+bool Controller::moveDown(Connection &connection) {
+  int from = connection.slots[0][0];
+  int length = connection.slots[0].size();
+  if (from == 0) return false;
+  for (unsigned int j = 0; j < connection.links.size(); j++) {
+    const std::vector<int> &slots = connection.slots[j];
+    if (static_cast<int>(slots.size()) != length || slots[0] != from ||
+        slots[length - 1] != from + length - 1)
+      return false;
+  }
+
+  // Slots used on any link of the connection, except its own ones, up to
+  // the last slot of the connection
+  int words = (from + length + 63) / 64;
+  this->usedWords.assign(words, 0);
+  for (unsigned int j = 0; j < connection.links.size(); j++) {
+    const uint64_t *linkWords =
+        this->network->getLink(connection.links[j])
+            ->getSlotWords(connection.cores[j], connection.modes[j]);
+    for (int w = 0; w < words; w++) this->usedWords[w] |= linkWords[w];
+  }
+  for (int s = from; s < from + length; s++)
+    this->usedWords[s / 64] &= ~(uint64_t(1) << (s % 64));
+
+  int target = -1;
+  int run = 0;
+  for (int s = 0; s < from + length - 1 && target < 0; s++) {
+    run = (this->usedWords[s / 64] >> (s % 64)) & 1 ? 0 : run + 1;
+    if (run == length) target = s - length + 1;
+  }
+  if (target < 0 || target >= from) return false;
+
+  // The new slots that aren't used yet are taken before the old slots that
+  // aren't used anymore are released
+  int useTo = std::min(target + length, from);
+  int unuseFrom = std::max(target + length, from);
+  unsigned int j = 0;
+  bool moved = false;
+  try {
+    for (j = 0; j < connection.links.size(); j++) {
+      int link = connection.links[j];
+      moved = false;
+      this->changeRange(link, connection.cores[j], connection.modes[j],
+                        target, useTo, true);
+      moved = true;
+      this->changeRange(link, connection.cores[j], connection.modes[j],
+                        unuseFrom, from + length, false);
+    }
+  } catch (...) {
+    // The links moved before are moved back, so the move is atomic
+    for (unsigned int i = 0; i <= j && i < connection.links.size(); i++) {
+      int link = connection.links[i];
+      if (i < j || moved)
+        this->changeRange(link, connection.cores[i], connection.modes[i],
+                          target, useTo, false);
+      if (i < j)
+        this->changeRange(link, connection.cores[i], connection.modes[i],
+                          unuseFrom, from + length, true);
+    }
+    throw;
+  }
+  for (j = 0; j < connection.links.size(); j++) {
+    for (int k = 0; k < length; k++) connection.slots[j][k] = target + k;
+  }
+  return true;
+}
+
+long long Controller::getDefragmentations(void) {
+  return this->defragmentations;
+}
+
+long long Controller::getMovedConnections(void) {
+  return this->movedConnections;
+}
+
+double Controller::getDefragmentationTime(void) {
+  return static_cast<double>(this->defragmentationClock) / CLOCKS_PER_SEC;
+}
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+// #include "controller.hpp"
+
+typedef enum eventType { ARRIVE, DEPARTURE } eventType;
+/**
+ * @brief Class Event
+ *
+ * The Event class represents the event that happens inside the digital
+ * transmission system or computer network of the Simulator in terms of
+ * clients requesting to establish connections (thus needing resources) known as
+ * an "arrival" or closing the connection thereafter (thus freeing resources)
+ * known as a "departure".
+ *
+ * Note that, as the Simulator uses Event Based Simulation, this class'
+ * implementation is a key-piece for the simulator's execution.
+ *
+ * The Event class contains 3 attributes: an EventType variable which describes
+ * the kind of Event taking two possible values: ARRIVE or DEPARTURE, the Id
+ * (identifier) of the Connection regarding the current Event represented as a
+ * long long, and the time at which the current Event has occurred represented
+ * as a double.
+ *
+ * The Event class contains two main methods for setting it's variables' values,
+ * both being exclusively constructors: one (void constructor) for using default
+ * initialized values and other for receiving their values as arguments. Each
+ * attribute has it's own getter.
+ */
+class Event {
+ public:
+  /**
+   * @brief Constructs a new Event object with default values for it's
+   * attributes: (Event Type: ARRIVE, Id Connection: -1, Time: -1)
+   */
+  Event(void);
+  /**
+   * @brief Constructs a new Event object setting it's attributes using the
+   * values given through it's arguments: (Event Type: type, Id Connection:
+   * idConnection, Time: time)
+   *
+   * @param type (eventType): the type of current Event object, whether it's
+   * ARRIVE or DEPARTURE.
+   *
+   * @param time (double): the actual time at which the current Event has
+   * occured.
+   *
+   * @param idConnection (long long): Connection Identifier (Id).
+   */
+  Event(eventType type, double time, long long idConnection);
+
+  /**
+   * @brief Delete the Event object.
+   */
+
+  ~Event();
+
+  /**
+   * @brief Gets the type attribute of the Event object. This represents the
+   * kind of Event of the current Event object.
+   *
+   * @return (eventType): the type of Event (ARRIVE or DEPARTURE).
+   */
+
+  eventType getType();
+
+  /**
+   * @brief Gets the time attribute of the Event object. This represents the
+   * time at which the current Event object has occurred.
+   *
+   * @return (double): the actual time at which the Event has occurred.
+   */
+
+  double getTime();
+
+  /**
+   * @brief Gets the idConnection attribute of the Event object. This represents
+   * the Identifier (Id) of the Connection concerning the current Event.
+   *
+   * @return (long long): the identifier of the Connection related to the Event.
+   */
+
+  long long getIdConnection();
+
+ private:
+  eventType type;
+  double time;
+  long long idConnection;
+};
+
+#endif
+// #include "event.hpp"
+Event::Event(void) {
+  this->type = ARRIVE;
+  this->time = -1;
+  this->idConnection = -1;
+}
+
+Event::Event(eventType type, double time, long long idConnection) {
+  this->type = type;
+  this->time = time;
+  this->idConnection = idConnection;
+}
+
+Event::~Event() {}
+
+eventType Event::getType() { return this->type; }
+
+double Event::getTime() { return this->time; }
+
+long long Event::getIdConnection() { return this->idConnection; }
+
+#ifndef __BATCH_MEANS_H__
+#define __BATCH_MEANS_H__
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @brief Class that estimates the mean of a correlated series of
+ * observations, and the half width of its confidence interval, with the
+ * method of batch means.
+ *
+ * Consecutive observations are grouped in batches, and the batch means,
+ * nearly independent when the batches are long enough, are used to compute
+ * a Student t interval. The estimator is streaming and uses constant memory:
+ * it keeps between numberOfBatches and 2 * numberOfBatches complete batches,
+ * and each time it reaches 2 * numberOfBatches, pairs of adjacent batches are
+ * merged and the batch size is doubled.
+ *
+ * Observations can be weighted, for example by the time a state lasted to
+ * estimate a time average. In that case the mean of a batch is the weighted
+ * mean of its observations.
+ */
+class BatchMeans {
+ public:
+  /**
+   * @brief Constructs a new BatchMeans object with 32 batches.
+   *
+   */
+  BatchMeans(void);
+  /**
+   * @brief Constructs a new BatchMeans object.
+   *
+   * @param numberOfBatches the minimum amount of complete batches once the
+   * batch size starts to grow. It must be at least 2.
+   */
+  BatchMeans(int numberOfBatches);
+  /**
+   * @brief Adds an observation to the series.
+   *
+   * @param value the observed value.
+   * @param weight the weight of the observation, by default 1.
+   */
+  void addValue(double value, double weight = 1.0);
+  /**
+   * @brief Get the mean of every observation of the series (including the
+   * ones of the incomplete batch).
+   *
+   * @return double the weighted mean, 0 if there are no observations.
+   */
+  double getMean(void) const;
+  /**
+   * @brief Get the half width of the confidence interval of the mean, based
+   * on the complete batches:
+   *
+   * \f[
+          \pm t_{k-1} \cdot \frac{s_k}{\sqrt{k}}
+     \f]
+   *
+   * @param confidence the confidence of the interval, between 0 and 1.
+   * @return double the half width, infinity if there are less than two
+   * complete batches.
+   */
+  double halfWidth(double confidence) const;
+  /**
+   * @brief Get the amount of observations of the series.
+   *
+   * @return long long the amount of observations.
+   */
+  long long getNumberOfObservations(void) const;
+  /**
+   * @brief Get the amount of complete batches.
+   *
+   * @return int the amount of complete batches.
+   */
+  int getNumberOfBatches(void) const;
+  /**
+   * @brief Get the amount of observations of each batch.
+   *
+   * @return long long the batch size.
+   */
+  long long getBatchSize(void) const;
+  /**
+   * @brief Get the means of the complete batches.
+   *
+   * @return std::vector<double> the batch means, on order.
+   */
+  std::vector<double> getBatchMeans(void) const;
+  /**
+   * @brief Deletes every observation, keeping the number of batches.
+   *
+   */
+  void reset(void);
+  /**
+   * @brief Computes the quantile of the Student t distribution. Up to 30
+   * degrees of freedom the exact distribution function is inverted by
+   * bisection; above, where it's accurate, the Cornish-Fisher expansion
+   * around the normal quantile is used.
+   *
+   * @param p the probability, between 0.5 and 1.
+   * @param degrees the degrees of freedom.
+   * @return double the quantile.
+   */
+  static double tQuantile(double p, int degrees);
+
+ private:
+  /**
+   * @brief Computes the exact distribution function of the Student t
+   * distribution with an integer number of degrees of freedom, with the
+   * finite trigonometric series of P(|T| <= t).
+   *
+   * @param t the value, at least 0.
+   * @param degrees the degrees of freedom.
+   * @return double P(T <= t).
+   */
+  static double tDistribution(double t, int degrees);
+
+  int numberOfBatches;
+  long long batchSize;
+  long long observations;
+  std::vector<double> sums;
+  std::vector<double> weights;
+  double currentSum;
+  double currentWeight;
+  long long currentCount;
+  double totalSum;
+  double totalWeight;
+};
+
+#endif
+// #include "batch_means.hpp"
+
+BatchMeans::BatchMeans(void) : BatchMeans(32) {}
+
+BatchMeans::BatchMeans(int numberOfBatches) {
+  if (numberOfBatches < 2) {
+    throw std::runtime_error("Number of batches must be at least 2.");
+  }
+  this->numberOfBatches = numberOfBatches;
+  this->reset();
+}
+
+void BatchMeans::reset(void) {
+  this->batchSize = 1;
+  this->observations = 0;
+  this->sums.clear();
+  this->weights.clear();
+  this->currentSum = 0;
+  this->currentWeight = 0;
+  this->currentCount = 0;
+  this->totalSum = 0;
+  this->totalWeight = 0;
+}
+
+void BatchMeans::addValue(double value, double weight) {
+  this->currentSum += value * weight;
+  this->currentWeight += weight;
+  this->currentCount++;
+  this->observations++;
+  this->totalSum += value * weight;
+  this->totalWeight += weight;
+  if (this->currentCount < this->batchSize) return;
+  this->sums.push_back(this->currentSum);
+  this->weights.push_back(this->currentWeight);
+  this->currentSum = 0;
+  this->currentWeight = 0;
+  this->currentCount = 0;
+  if (static_cast<int>(this->sums.size()) == 2 * this->numberOfBatches) {
+    for (int i = 0; i < this->numberOfBatches; i++) {
+      this->sums[i] = this->sums[2 * i] + this->sums[2 * i + 1];
+      this->weights[i] = this->weights[2 * i] + this->weights[2 * i + 1];
+    }
+    this->sums.resize(this->numberOfBatches);
+    this->weights.resize(this->numberOfBatches);
+    this->batchSize *= 2;
+  }
+}
+
+double BatchMeans::getMean(void) const {
+  if (this->totalWeight == 0) return 0;
+  return this->totalSum / this->totalWeight;
+}
+
+std::vector<double> BatchMeans::getBatchMeans(void) const {
+  std::vector<double> means;
+  for (unsigned int i = 0; i < this->sums.size(); i++) {
+    means.push_back(this->weights[i] == 0 ? 0 : this->sums[i] / this->weights[i]);
+  }
+  return means;
+}
+
+double BatchMeans::halfWidth(double confidence) const {
+  int k = this->sums.size();
+  if (k < 2) return std::numeric_limits<double>::infinity();
+  std::vector<double> means = this->getBatchMeans();
+  double mean = 0;
+  for (int i = 0; i < k; i++) mean += means[i];
+  mean /= k;
+  double variance = 0;
+  for (int i = 0; i < k; i++) variance += (means[i] - mean) * (means[i] - mean);
+  variance /= k - 1;
+  return BatchMeans::tQuantile((1 + confidence) / 2, k - 1) * sqrt(variance / k);
+}
+
+long long BatchMeans::getNumberOfObservations(void) const {
+  return this->observations;
+}
+
+int BatchMeans::getNumberOfBatches(void) const { return this->sums.size(); }
+
+long long BatchMeans::getBatchSize(void) const { return this->batchSize; }
+
+double BatchMeans::tDistribution(double t, int degrees) {
+  double theta = atan(t / sqrt(static_cast<double>(degrees)));
+  double c2 = cos(theta) * cos(theta);
+  double sum = 0;
+  double term = 1;
+  if (degrees % 2 == 1) {
+    // (2/pi) (theta + sin cos (1 + 2/3 cos^2 + 2*4/(3*5) cos^4 + ...))
+    for (int k = 1; k <= degrees - 2; k += 2) {
+      sum += term;
+      term *= c2 * (k + 1) / (k + 2);
+    }
+    double a = 2 / acos(-1.0) * (theta + sin(theta) * cos(theta) * sum);
+    return (1 + a) / 2;
+  }
+  // sin (1 + 1/2 cos^2 + 1*3/(2*4) cos^4 + ...)
+  for (int k = 0; k <= degrees - 2; k += 2) {
+    sum += term;
+    term *= c2 * (k + 1) / (k + 2);
+  }
+  return (1 + sin(theta) * sum) / 2;
+}
+
+double BatchMeans::tQuantile(double p, int degrees) {
+  if (degrees <= 30) {
+    // With few degrees of freedom the expansion is badly wrong, and few
+    // batches or replications are common
+    double low = 0;
+    double high = 1;
+    while (BatchMeans::tDistribution(high, degrees) < p) high *= 2;
+    for (int i = 0; i < 100; i++) {
+      double middle = (low + high) / 2;
+      if (BatchMeans::tDistribution(middle, degrees) < p) {
+        low = middle;
+      } else {
+        high = middle;
+      }
+    }
+    return (low + high) / 2;
+  }
+  // Normal quantile by bisection on the cumulative distribution
+  double low = 0;
+  double high = 40;
+  for (int i = 0; i < 100; i++) {
+    double middle = (low + high) / 2;
+    if ((1 + erf(middle / sqrt(2))) / 2 < p) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  double z = (low + high) / 2;
+  double v = degrees;
+  double z2 = z * z;
+  double z3 = z2 * z;
+  double z5 = z3 * z2;
+  double z7 = z5 * z2;
+  double z9 = z7 * z2;
+  return z + (z3 + z) / (4 * v) + (5 * z5 + 16 * z3 + 3 * z) / (96 * v * v) +
+         (3 * z7 + 19 * z5 + 17 * z3 - 15 * z) / (384 * v * v * v) +
+         (79 * z9 + 776 * z7 + 1482 * z5 - 1920 * z3 - 945 * z) /
+             (92160 * v * v * v * v);
+}
+
+#ifndef __PAIRED_DIFFERENCE_H__
+#define __PAIRED_DIFFERENCE_H__
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// #include "batch_means.hpp"
+/**
+ * @brief Class that estimates the difference between the means of two
+ * configurations from paired observations.
+ *
+ * When both configurations are simulated with Common Random Numbers (see
+ * Simulator::setCommonRandomNumbers), the i-th observation of each one (for
+ * example the blocking of the i-th batch of arrivals) is positively
+ * correlated, and the variance of the difference is
+ *
+ * \f[
+        Var(X - Y) = Var(X) + Var(Y) - 2 Cov(X, Y)
+   \f]
+ *
+ * which is much lower than the variance of independent runs. The interval
+ * is a Student t interval over the differences of the pairs.
+ */
+class PairedDifference {
+ public:
+  /**
+   * @brief Constructs a new PairedDifference object without pairs.
    *
    */
-  void setPaths(std::string filename);
+  PairedDifference(void);
   /**
-   * @brief Sets the Network object as the network attribute of the controller.
-   * This is the network that the controller will now handle and who will
-   * interact with the simulator
+   * @brief Constructs a new PairedDifference object from two series of
+   * observations, for example the batch means of two simulations with the
+   * same goal connections.
    *
-   * @param network The pointer type Network object. This contains all
-   * the information about the network, nodes, routes, path length and slots.
+   * @param first the observations of the first configuration.
+   * @param second the observations of the second configuration. It must have
+   * the same length of the first one.
    */
-  void setNetwork(Network *network);
+  PairedDifference(std::vector<double> first, std::vector<double> second);
   /**
-   * @brief Get the Network in the controller. The return contains all
-   * the information about the network, nodes, routes, path length and slots.
+   * @brief Adds a pair of observations.
    *
-   * @return Network. a pointer to the network object from the controller. This
-   * is the network the controller is currently using
+   * @param first the observation of the first configuration.
+   * @param second the observation of the second configuration.
    */
-  Network *getNetwork(void);
+  void addPair(double first, double second);
   /**
-   * @brief Set the allocator of the controller. The allocator determines how
-   * the connections will be assigned in the network.
+   * @brief Get the mean of the differences (first - second).
    *
-   * @param allocator A pointer to the allocator object.
+   * @return double the mean difference.
    */
-  void setAllocator(Allocator *allocator);
+  double getMean(void) const;
   /**
-   * @brief Get the Allocator object of the controller. The allocator determines
-   * how the connections will be assigned in the network.
+   * @brief Get the half width of the confidence interval of the mean
+   * difference.
    *
-   * @return Allocator* a pointer to the allocator object.
+   * @param confidence the confidence of the interval, between 0 and 1.
+   * @return double the half width, infinity if there are less than two
+   * pairs.
    */
-  Allocator *getAllocator(void);
+  double halfWidth(double confidence) const;
   /**
-   * @brief Get the Paths vector. This vector represents all the routes present
-   * in the network between the source and destination nodes.
+   * @brief Get the correlation between the observations of both
+   * configurations.
    *
-   * @return a pointer to the four dimensional vector which represents the
-   * paths.
+   * @return double the correlation coefficient, 0 if it's undefined.
    */
-  std::vector<std::vector<std::vector<std::vector<Link *>>>> *getPaths();
-
-  void setUnassignCallback(void (*callbackFunction)(Connection, double,
-                                                    Network *));
+  double getCorrelation(void) const;
+  /**
+   * @brief Get the variance reduction factor of pairing, that is, the
+   * variance of the difference of independent observations, Var(X) + Var(Y),
+   * over the variance of the paired differences. A factor of 10 means the
+   * same precision is reached with 10 times fewer observations.
+   *
+   * @return double the variance reduction factor.
+   */
+  double varianceReduction(void) const;
+  /**
+   * @brief Get the number of pairs.
+   *
+   * @return long long the number of pairs.
+   */
+  long long getNumberOfPairs(void) const;
 
  private:
-  Network *network;
-  Allocator *allocator;
-  std::vector<std::vector<std::vector<std::vector<Link *>>>> path;
-  std::vector<Connection> connections;
-  allocationStatus rtnAllocation;
-
-  int unassignConnectionNormal(long long idConnection, double time);
-  int unassignConnectionWCallback(long long idConnection, double time);
-  void (*unassignCallback)(Connection c, double time, Network *n);
+  long long pairs;
+  double meanFirst;
+  double meanSecond;
+  double squaresFirst;
+  double squaresSecond;
+  double coMoment;
 };
 
 #endif
-// #include "controller.hpp"
-
-#include <fstream>
-
-Controller::Controller() {
-  this->connections = std::vector<Connection>();
-  this->network = nullptr;
-  this->allocator = new Allocator;
-  this->unassignConnection = &Controller::unassignConnectionNormal;
-};
+// #include "paired_difference.hpp"
 
-Controller::Controller(Network *network) {
-  this->network = network;
-  this->connections = std::vector<Connection>();
-  this->allocator = new Allocator;
-  this->unassignConnection = &Controller::unassignConnectionNormal;
-};
+PairedDifference::PairedDifference(void) {
+  this->pairs = 0;
+  this->meanFirst = 0;
+  this->meanSecond = 0;
+  this->squaresFirst = 0;
+  this->squaresSecond = 0;
+  this->coMoment = 0;
+}
 
-Controller::~Controller() {
-  if (this->network != nullptr) {
-    for (int i = 0; i < this->network->getNumberOfLinks(); i++) {
-      delete this->network->getLink(i);
-    }
-    for (int i = 0; i < this->network->getNumberOfNodes(); i++) {
-      delete this->network->getNode(i);
-    }
+PairedDifference::PairedDifference(std::vector<double> first,
+                                   std::vector<double> second)
+    : PairedDifference() {
+  if (first.size() != second.size()) {
+    throw std::runtime_error(
+        "Both series of a paired difference must have the same length.");
   }
-  delete this->allocator;
-};
-
-allocationStatus Controller::assignConnection(int src, int dst, BitRate bitRate,
-                                              long long idConnection,
-                                              double time) {
-  Connection con = Connection(idConnection, time, &bitRate);
-  this->rtnAllocation = this->allocator->exec(src, dst, bitRate, con);
-  if (this->rtnAllocation == ALLOCATED) {
-    this->connections.push_back(con);
-    for (unsigned int j = 0; j < con.links.size(); j++) {
-      for (unsigned int k = 0; k < con.slots[j].size(); k++) {
-        this->network->useSlot(con.links[j], con.slots[j][k]);
-      }
-    }
+  for (unsigned int i = 0; i < first.size(); i++) {
+    this->addPair(first[i], second[i]);
   }
-  return this->rtnAllocation;
 }
 
-int Controller::unassignConnectionNormal(long long idConnection, double time) {
-  for (unsigned int i = 0; i < this->connections.size(); i++) {
-    if (this->connections[i].id == idConnection) {
-      for (unsigned int j = 0; j < this->connections[i].links.size(); j++) {
-        for (unsigned int k = 0; k < this->connections[i].slots[j].size();
-             k++) {
-          this->network->unuseSlot(this->connections[i].links[j],
-                                   this->connections[i].slots[j][k]);
-        }
-      }
-      this->connections.erase(this->connections.begin() + i);
-      break;
-    }
-  }
-  return 0;
+void PairedDifference::addPair(double first, double second) {
+  // Welford's update of the means and (co)moments
+  this->pairs++;
+  double deltaFirst = first - this->meanFirst;
+  double deltaSecond = second - this->meanSecond;
+  this->meanFirst += deltaFirst / this->pairs;
+  this->meanSecond += deltaSecond / this->pairs;
+  this->squaresFirst += deltaFirst * (first - this->meanFirst);
+  this->squaresSecond += deltaSecond * (second - this->meanSecond);
+  this->coMoment += deltaFirst * (second - this->meanSecond);
 }
 
-int Controller::unassignConnectionWCallback(long long idConnection,
-                                            double time) {
-  for (unsigned int i = 0; i < this->connections.size(); i++) {
-    if (this->connections[i].id == idConnection) {
-      this->unassignCallback(this->connections[i], time, this->network);
-      for (unsigned int j = 0; j < this->connections[i].links.size(); j++) {
-        for (unsigned int k = 0; k < this->connections[i].slots[j].size();
-             k++) {
-          this->network->unuseSlot(this->connections[i].links[j],
-                                   this->connections[i].slots[j][k]);
-        }
-      }
-      this->connections.erase(this->connections.begin() + i);
-      break;
-    }
-  }
-  return 0;
+double PairedDifference::getMean(void) const {
+  return this->meanFirst - this->meanSecond;
 }
 
-void Controller::setPaths(std::string filename) {
-  // open JSON file
-  std::ifstream file(filename);
-  nlohmann::json filePaths;
-  file >> filePaths;
-
-  int numberOfNodes;
-  numberOfNodes = this->network->getNumberOfNodes();
+double PairedDifference::halfWidth(double confidence) const {
+  if (this->pairs < 2) return std::numeric_limits<double>::infinity();
+  double variance =
+      (this->squaresFirst + this->squaresSecond - 2 * this->coMoment) /
+      (this->pairs - 1);
+  if (variance < 0) variance = 0;
+  return BatchMeans::tQuantile((1 + confidence) / 2, this->pairs - 1) *
+         sqrt(variance / this->pairs);
+}
 
-  // allocate space for path[src]
-  this->path.resize(numberOfNodes);
+double PairedDifference::getCorrelation(void) const {
+  if (this->squaresFirst == 0 || this->squaresSecond == 0) return 0;
+  return this->coMoment / sqrt(this->squaresFirst * this->squaresSecond);
+}
 
-  // allocate space for path[src][dst]
-  for (int t = 0; t < numberOfNodes; t++) {
-    this->path[t].resize(numberOfNodes);
-  }
+double PairedDifference::varianceReduction(void) const {
+  double paired =
+      this->squaresFirst + this->squaresSecond - 2 * this->coMoment;
+  if (paired <= 0) return std::numeric_limits<double>::infinity();
+  return (this->squaresFirst + this->squaresSecond) / paired;
+}
 
-  int routesNumber;
-  routesNumber = filePaths["routes"].size();
+long long PairedDifference::getNumberOfPairs(void) const {
+  return this->pairs;
+}
 
-  for (int i = 0; i < routesNumber; i++) {
-    int pathsNumber;
-    pathsNumber = filePaths["routes"][i]["paths"].size();
-    int src, dst;
-    src = filePaths["routes"][i]["src"];
-    dst = filePaths["routes"][i]["dst"];
+#ifndef __ANTITHETIC_AVERAGE_H__
+#define __ANTITHETIC_AVERAGE_H__
 
-    // allocate path[src][dst][pathsNumber]
-    int linksInPath;
-    linksInPath = pathsNumber - 1;
-    // because 3 nodes has 2 links
-    this->path[src][dst].resize(pathsNumber);
+#include <cmath>
+#include <limits>
 
-    // go through available routes
-    for (int b = 0; b < pathsNumber; b++) {
-      int nodesPathNumber;
-      nodesPathNumber = filePaths["routes"][i]["paths"][b].size();
-      int lastNode = nodesPathNumber - 1;
+// #include "batch_means.hpp"
+/**
+ * @brief Class that estimates a mean from pairs of antithetic observations.
+ *
+ * Each pair is formed by an observation of a simulation and the one of the
+ * same simulation with antithetic random variables (see
+ * Simulator::setAntithetic). The estimate is the mean of the pair averages,
+ * whose variance
+ *
+ * \f[
+        Var\left(\frac{X + Y}{2}\right) = \frac{Var(X) + Var(Y) + 2 Cov(X, Y)}{4}
+   \f]
+ *
+ * is lower than the one of independent pairs when X and Y are negatively
+ * correlated.
+ */
+class AntitheticAverage {
+ public:
+  /**
+   * @brief Constructs a new AntitheticAverage object without pairs.
+   *
+   */
+  AntitheticAverage(void);
+  /**
+   * @brief Adds a pair of observations.
+   *
+   * @param value the observation of the simulation.
+   * @param antitheticValue the observation of the antithetic simulation.
+   */
+  void addPair(double value, double antitheticValue);
+  /**
+   * @brief Get the mean of the pair averages.
+   *
+   * @return double the estimate.
+   */
+  double getMean(void) const;
+  /**
+   * @brief Get the half width of the confidence interval of the estimate.
+   *
+   * @param confidence the confidence of the interval, between 0 and 1.
+   * @return double the half width, infinity if there are less than two
+   * pairs.
+   */
+  double halfWidth(double confidence) const;
+  /**
+   * @brief Get the correlation between the observations of each pair.
+   *
+   * @return double the correlation coefficient, 0 if it's undefined.
+   */
+  double getCorrelation(void) const;
+  /**
+   * @brief Get the variance reduction factor, the variance of the average of
+   * independent pairs over the one of the antithetic pairs.
+   *
+   * @return double the variance reduction factor.
+   */
+  double varianceReduction(void) const;
+  /**
+   * @brief Get the number of pairs.
+   *
+   * @return long long the number of pairs.
+   */
+  long long getNumberOfPairs(void) const;
 
-      for (int c = 0; c < lastNode; c++) {
-        int actNode, nextNode;
-        actNode = filePaths["routes"][i]["paths"][b][c];
-        nextNode = filePaths["routes"][i]["paths"][b][c + 1];
+ private:
+  long long pairs;
+  double meanFirst;
+  double meanSecond;
+  double squaresFirst;
+  double squaresSecond;
+  double coMoment;
+};
 
-        int idLink;
-        idLink = this->network->isConnected(actNode, nextNode);
+#endif
+// #include "antithetic_average.hpp"
 
-        this->path[src][dst][b].push_back(this->network->getLink(idLink));
-      }
-    }
-  }
+AntitheticAverage::AntitheticAverage(void) {
+  this->pairs = 0;
+  this->meanFirst = 0;
+  this->meanSecond = 0;
+  this->squaresFirst = 0;
+  this->squaresSecond = 0;
+  this->coMoment = 0;
 }
 
-void Controller::setNetwork(Network *network) { this->network = network; }
+void AntitheticAverage::addPair(double value, double antitheticValue) {
+  this->pairs++;
+  double deltaFirst = value - this->meanFirst;
+  double deltaSecond = antitheticValue - this->meanSecond;
+  this->meanFirst += deltaFirst / this->pairs;
+  this->meanSecond += deltaSecond / this->pairs;
+  this->squaresFirst += deltaFirst * (value - this->meanFirst);
+  this->squaresSecond += deltaSecond * (antitheticValue - this->meanSecond);
+  this->coMoment += deltaFirst * (antitheticValue - this->meanSecond);
+}
 
-Network *Controller::getNetwork(void) { return this->network; }
+double AntitheticAverage::getMean(void) const {
+  return (this->meanFirst + this->meanSecond) / 2;
+}
 
-void Controller::setAllocator(Allocator *allocator) {
-  this->allocator = allocator;
+double AntitheticAverage::halfWidth(double confidence) const {
+  if (this->pairs < 2) return std::numeric_limits<double>::infinity();
+  double variance =
+      (this->squaresFirst + this->squaresSecond + 2 * this->coMoment) /
+      (4 * (this->pairs - 1));
+  if (variance < 0) variance = 0;
+  return BatchMeans::tQuantile((1 + confidence) / 2, this->pairs - 1) *
+         sqrt(variance / this->pairs);
 }
 
-Allocator *Controller::getAllocator(void) { return this->allocator; }
+double AntitheticAverage::getCorrelation(void) const {
+  if (this->squaresFirst == 0 || this->squaresSecond == 0) return 0;
+  return this->coMoment / sqrt(this->squaresFirst * this->squaresSecond);
+}
 
-std::vector<std::vector<std::vector<std::vector<Link *>>>>
-    *Controller::getPaths() {
-  return &(this->path);
+double AntitheticAverage::varianceReduction(void) const {
+  double antithetic =
+      this->squaresFirst + this->squaresSecond + 2 * this->coMoment;
+  if (antithetic <= 0) return std::numeric_limits<double>::infinity();
+  return (this->squaresFirst + this->squaresSecond) / antithetic;
 }
 
-void Controller::setUnassignCallback(void (*callbackFunction)(Connection,
-                                                              double,
-                                                              Network *)) {
-  this->unassignConnection = &Controller::unassignConnectionWCallback;
-  this->unassignCallback = callbackFunction;
+long long AntitheticAverage::getNumberOfPairs(void) const {
+  return this->pairs;
 }
-#ifndef __EVENT_H__
-#define __EVENT_H__
 
-// #include "controller.hpp"
+#ifndef __CONTROL_VARIATES_H__
+#define __CONTROL_VARIATES_H__
 
-typedef enum eventType { ARRIVE, DEPARTURE } eventType;
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// #include "batch_means.hpp"
 /**
- * @brief Class Event
- *
- * The Event class represents the event that happens inside the digital
- * transmission system or computer network of the Simulator in terms of
- * clients requesting to establish connections (thus needing resources) known as
- * an "arrival" or closing the connection thereafter (thus freeing resources)
- * known as a "departure".
+ * @brief Class that estimates a mean with control variates.
  *
- * Note that, as the Simulator uses Event Based Simulation, this class'
- * implementation is a key-piece for the simulator's execution.
+ * Together with each observation Y, the values of some controls C, whose
+ * means are known analytically, are observed. The deviation of the controls
+ * from their means is used to correct the estimate:
  *
- * The Event class contains 3 attributes: an EventType variable which describes
- * the kind of Event taking two possible values: ARRIVE or DEPARTURE, the Id
- * (identifier) of the Connection regarding the current Event represented as a
- * long long, and the time at which the current Event has occurred represented
- * as a double.
+ * \f[
+        \hat{Y}_{cv} = \bar{Y} - \hat{\beta}^T (\bar{C} - \mu_C)
+   \f]
  *
- * The Event class contains two main methods for setting it's variables' values,
- * both being exclusively constructors: one (void constructor) for using default
- * initialized values and other for receiving their values as arguments. Each
- * attribute has it's own getter.
+ * where the coefficients are the least squares regression of Y on C. The
+ * stronger the correlation between Y and the controls, the larger the
+ * variance reduction. The estimator is streaming: only the means and the
+ * centered cross products of the observations are kept.
  */
-class Event {
+class ControlVariates {
  public:
   /**
-   * @brief Constructs a new Event object with default values for it's
-   * attributes: (Event Type: ARRIVE, Id Connection: -1, Time: -1)
+   * @brief Constructs a new ControlVariates object without controls.
+   *
    */
-  Event(void);
+  ControlVariates(void);
   /**
-   * @brief Constructs a new Event object setting it's attributes using the
-   * values given through it's arguments: (Event Type: type, Id Connection:
-   * idConnection, Time: time)
+   * @brief Constructs a new ControlVariates object.
    *
-   * @param type (eventType): the type of current Event object, whether it's
-   * ARRIVE or DEPARTURE.
+   * @param controlMeans the known means of the controls.
+   */
+  ControlVariates(std::vector<double> controlMeans);
+  /**
+   * @brief Adds an observation.
    *
-   * @param time (double): the actual time at which the current Event has
-   * occured.
+   * @param value the observed value.
+   * @param controls the observed value of each control, on the same order of
+   * the means.
+   */
+  void addObservation(double value, std::vector<double> controls);
+  /**
+   * @brief Get the controlled estimate of the mean.
    *
-   * @param idConnection (long long): Connection Identifier (Id).
+   * @return double the estimate, the plain mean if there are not enough
+   * observations to fit the coefficients.
    */
-  Event(eventType type, double time, long long idConnection);
-
+  double getMean(void) const;
   /**
-   * @brief Delete the Event object.
+   * @brief Get the plain mean of the observations.
+   *
+   * @return double the mean.
    */
-
-  ~Event();
-
+  double getUncontrolledMean(void) const;
+  /**
+   * @brief Get the half width of the confidence interval of the controlled
+   * estimate, with n - q - 1 degrees of freedom for q controls.
+   *
+   * @param confidence the confidence of the interval, between 0 and 1.
+   * @return double the half width, infinity if there are not enough
+   * observations.
+   */
+  double halfWidth(double confidence) const;
+  /**
+   * @brief Get the variance reduction factor, the variance of the plain mean
+   * over the one of the controlled estimate.
+   *
+   * @return double the variance reduction factor.
+   */
+  double varianceReduction(void) const;
   /**
-   * @brief Gets the type attribute of the Event object. This represents the
-   * kind of Event of the current Event object.
+   * @brief Get the fitted coefficients of the controls.
    *
-   * @return (eventType): the type of Event (ARRIVE or DEPARTURE).
+   * @return std::vector<double> one coefficient per control.
    */
-
-  eventType getType();
-
+  std::vector<double> getCoefficients(void) const;
   /**
-   * @brief Gets the time attribute of the Event object. This represents the
-   * time at which the current Event object has occurred.
+   * @brief Get the number of observations.
    *
-   * @return (double): the actual time at which the Event has occurred.
+   * @return long long the number of observations.
    */
-
-  double getTime();
-
+  long long getNumberOfObservations(void) const;
   /**
-   * @brief Gets the idConnection attribute of the Event object. This represents
-   * the Identifier (Id) of the Connection concerning the current Event.
+   * @brief Deletes every observation, keeping the controls.
    *
-   * @return (long long): the identifier of the Connection related to the Event.
    */
-
-  long long getIdConnection();
+  void reset(void);
 
  private:
-  eventType type;
-  double time;
-  long long idConnection;
+  std::vector<double> controlMeans;
+  long long observations;
+  // Position 0 is the value, the next ones the controls
+  std::vector<double> means;
+  std::vector<std::vector<double>> coMoments;
+  /**
+   * @brief Solves the system of the centered cross products of the controls
+   * with the given right hand side. Controls without variance get 0.
+   */
+  std::vector<double> solve(std::vector<double> rightSide) const;
+  double variance(void) const;
 };
 
 #endif
-// #include "event.hpp"
-Event::Event(void) {
-  this->type = ARRIVE;
-  this->time = -1;
-  this->idConnection = -1;
+// #include "control_variates.hpp"
+
+ControlVariates::ControlVariates(void) : ControlVariates(std::vector<double>()) {}
+
+ControlVariates::ControlVariates(std::vector<double> controlMeans) {
+  this->controlMeans = controlMeans;
+  this->reset();
 }
 
-Event::Event(eventType type, double time, long long idConnection) {
-  this->type = type;
-  this->time = time;
-  this->idConnection = idConnection;
+void ControlVariates::reset(void) {
+  unsigned int d = this->controlMeans.size() + 1;
+  this->observations = 0;
+  this->means = std::vector<double>(d, 0.0);
+  this->coMoments =
+      std::vector<std::vector<double>>(d, std::vector<double>(d, 0.0));
 }
 
-Event::~Event() {}
+void ControlVariates::addObservation(double value,
+                                     std::vector<double> controls) {
+  if (controls.size() != this->controlMeans.size()) {
+    throw std::runtime_error(
+        "The number of controls must match the number of control means.");
+  }
+  unsigned int d = this->means.size();
+  std::vector<double> x(d);
+  x[0] = value;
+  for (unsigned int i = 1; i < d; i++) x[i] = controls[i - 1];
+  // Multivariate Welford's update
+  this->observations++;
+  std::vector<double> delta(d);
+  for (unsigned int i = 0; i < d; i++) {
+    delta[i] = x[i] - this->means[i];
+    this->means[i] += delta[i] / this->observations;
+  }
+  for (unsigned int i = 0; i < d; i++) {
+    for (unsigned int j = 0; j < d; j++) {
+      this->coMoments[i][j] += delta[i] * (x[j] - this->means[j]);
+    }
+  }
+}
 
-eventType Event::getType() { return this->type; }
+std::vector<double> ControlVariates::solve(
+    std::vector<double> rightSide) const {
+  unsigned int q = this->controlMeans.size();
+  std::vector<std::vector<double>> a(q, std::vector<double>(q + 1));
+  for (unsigned int i = 0; i < q; i++) {
+    for (unsigned int j = 0; j < q; j++) a[i][j] = this->coMoments[i + 1][j + 1];
+    a[i][q] = rightSide[i];
+  }
+  // Gaussian elimination with partial pivoting
+  std::vector<bool> used(q, false);
+  for (unsigned int c = 0; c < q; c++) {
+    unsigned int pivot = c;
+    for (unsigned int r = c + 1; r < q; r++) {
+      if (fabs(a[r][c]) > fabs(a[pivot][c])) pivot = r;
+    }
+    if (fabs(a[pivot][c]) <= 1e-12 * (1 + fabs(this->coMoments[c + 1][c + 1]))) {
+      continue;
+    }
+    std::swap(a[c], a[pivot]);
+    used[c] = true;
+    for (unsigned int r = 0; r < q; r++) {
+      if (r == c || a[r][c] == 0) continue;
+      double factor = a[r][c] / a[c][c];
+      for (unsigned int k = c; k <= q; k++) a[r][k] -= factor * a[c][k];
+    }
+  }
+  std::vector<double> solution(q, 0.0);
+  for (unsigned int c = 0; c < q; c++) {
+    if (used[c]) solution[c] = a[c][q] / a[c][c];
+  }
+  return solution;
+}
 
-double Event::getTime() { return this->time; }
+std::vector<double> ControlVariates::getCoefficients(void) const {
+  unsigned int q = this->controlMeans.size();
+  std::vector<double> covariances(q);
+  for (unsigned int i = 0; i < q; i++) covariances[i] = this->coMoments[i + 1][0];
+  return this->solve(covariances);
+}
 
-long long Event::getIdConnection() { return this->idConnection; }
+double ControlVariates::getMean(void) const {
+  unsigned int q = this->controlMeans.size();
+  if (this->observations <= static_cast<long long>(q) + 1) return this->means[0];
+  std::vector<double> beta = this->getCoefficients();
+  double mean = this->means[0];
+  for (unsigned int i = 0; i < q; i++) {
+    mean -= beta[i] * (this->means[i + 1] - this->controlMeans[i]);
+  }
+  return mean;
+}
+
+double ControlVariates::getUncontrolledMean(void) const { return this->means[0]; }
+
+double ControlVariates::variance(void) const {
+  unsigned int q = this->controlMeans.size();
+  long long n = this->observations;
+  std::vector<double> beta = this->getCoefficients();
+  double residual = this->coMoments[0][0];
+  for (unsigned int i = 0; i < q; i++) residual -= beta[i] * this->coMoments[i + 1][0];
+  if (residual < 0) residual = 0;
+  residual /= n - q - 1;
+  // Var = s^2 (1/n + d' S^-1 d), with d the deviation of the controls
+  std::vector<double> deviation(q);
+  for (unsigned int i = 0; i < q; i++) {
+    deviation[i] = this->means[i + 1] - this->controlMeans[i];
+  }
+  std::vector<double> scaled = this->solve(deviation);
+  double quadratic = 0;
+  for (unsigned int i = 0; i < q; i++) quadratic += deviation[i] * scaled[i];
+  return residual * (1.0 / n + quadratic);
+}
+
+double ControlVariates::halfWidth(double confidence) const {
+  unsigned int q = this->controlMeans.size();
+  if (this->observations <= static_cast<long long>(q) + 2) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return BatchMeans::tQuantile((1 + confidence) / 2,
+                               this->observations - q - 1) *
+         sqrt(this->variance());
+}
+
+double ControlVariates::varianceReduction(void) const {
+  unsigned int q = this->controlMeans.size();
+  long long n = this->observations;
+  if (n <= static_cast<long long>(q) + 2) return 1;
+  double controlled = this->variance();
+  double plain = this->coMoments[0][0] / (n - 1) / n;
+  if (controlled <= 0) return std::numeric_limits<double>::infinity();
+  return plain / controlled;
+}
+
+long long ControlVariates::getNumberOfObservations(void) const {
+  return this->observations;
+}
 
 #ifndef __SIMULATOR_H__
 #define __SIMULATOR_H__
 
+// The class of an allocation function has no state of its own, so it's
+// parallel safe as long as the function only reads the links of its routes
 #define BEGIN_ALLOC_FUNCTION(name__)                                  \
   class f_##name__ : public Allocator {                               \
    public:                                                            \
     f_##name__() : Allocator() { this->name = std::string(#name__); } \
+    bool isParallelSafe(void) { return true; }                        \
     allocationStatus exec(int src, int dst, BitRate bitRate, Connection &con)
 #define END_ALLOC_FUNCTION \
   }                        \
@@ -28378,7 +34425,12 @@ long long Event::getIdConnection() { return this->idConnection; }
   (*this->path)[src][dst][route][link]->getId()
 #define NUMBER_OF_ROUTES (*this->path)[src][dst].size()
 #define NUMBER_OF_LINKS(route) (*this->path)[src][dst][route].size()
+#define ROUTE_LARGEST_FREE_BLOCK(route) \
+  this->routeLargestFreeBlock((*this->path)[src][dst][route])
+#define ROUTE_GAPS(route) this->routeGaps((*this->path)[src][dst][route])
 #define ALLOC_SLOTS(link, from, to) con.addLink(link, from, from + to);
+#define ALLOC_SLOTS_SDM(link, core, mode, from, to) \
+  con.addLink(link, core, mode, from, from + to);
 
 #define BEGIN_UNALLOC_CALLBACK_FUNCTION \
   void _f_unallocate_function(Connection c, double t, Network *n)
@@ -28389,10 +34441,54 @@ long long Event::getIdConnection() { return this->idConnection; }
 #define TIME_DISCONNECTION t
 #define NETWORK n
 
+// ROUTE_GAPS(route) gives the slots free on every link of a route, from the
+// spectrum indexes of its links (see SpectrumIndex), so a driver can place a
+// request with the fits of SpectrumIndex without scanning the slots. For
+// example, best fit on the first route that reaches:
+//
+// BEGIN_ALLOC_FUNCTION(IndexedBestFit) {
+//   for (unsigned int r = 0; r < NUMBER_OF_ROUTES; r++) {
+//     std::vector<std::pair<int, int>> gaps = ROUTE_GAPS(r);
+//     double routeLength = 0;
+//     for (unsigned int l = 0; l < NUMBER_OF_LINKS(r); l++) {
+//       routeLength += LINK_IN_ROUTE(r, l)->getLength();
+//     }
+//     for (int m = 0; m < NUMBER_OF_MODULATIONS; m++) {
+//       if (routeLength > REQ_REACH(m)) continue;
+//       int slot = SpectrumIndex::bestFit(gaps, REQ_SLOTS(m));
+//       if (slot == -1) continue;
+//       for (unsigned int l = 0; l < NUMBER_OF_LINKS(r); l++) {
+//         ALLOC_SLOTS(LINK_IN_ROUTE_ID(r, l), slot, REQ_SLOTS(m))
+//       }
+//       return ALLOCATED;
+//     }
+//   }
+//   return NOT_ALLOCATED;
+// }
+// END_ALLOC_FUNCTION
+
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 #include <list>
-
+#include <memory>
+
+typedef enum variableStream {
+  ARRIVE_STREAM,
+  DEPARTURE_STREAM,
+  SRC_STREAM,
+  DST_STREAM,
+  BITRATE_STREAM
+} variableStream;
+
+typedef enum ciType {
+  WALD_CI,
+  AGRESTI_COULL_CI,
+  WILSON_CI,
+  BATCH_MEANS_CI
+} ciType;
+
+// #include "batch_means.hpp"
 // #include "controller.hpp"
 // #include "event.hpp"
 // #include "exp_variable.hpp"
@@ -28417,7 +34513,7 @@ class Simulator {
    * between nodes.
    * @param networkType (int) that defines the type of network, eg. EON (equal 1), SDM (equal 2).
    */
-  Simulator(std::string networkFilename, std::string pathFilename, int networkType = EON);
+  Simulator(std::string networkFilename, std::string pathFilename, int networkType = DEFAULT_NETWORK_TYPE);
   /**
    * @brief Construct the object Simulator from three JSON files, this files
    * contains the network configuration the routes and the bit rates.
@@ -28432,7 +34528,27 @@ class Simulator {
    * @param networkType (int) that defines the type of network, eg. EON (equal 1), SDM (equal 2).
    */
   Simulator(std::string networkFilename, std::string pathFilename,
-            std::string bitrateFilename, int networkType = EON);
+            std::string bitrateFilename, int networkType = DEFAULT_NETWORK_TYPE);
+  /**
+   * @brief Construct the object Simulator from two JSON files, the network
+   * configuration and the bit rates. Instead of reading the routes from a
+   * file, the k shortest paths (by length) between every pair of nodes are
+   * computed from the network.
+   *
+   * @param networkFilename Source of network file. This file is the
+   * configuration of the network, nodes information (id, destiny, source,
+   * lenght, slots).
+   * @param k the maximum number of routes between each pair of nodes.
+   * @param bitrateFilename Source of bit rates file. This file contains the
+   * differents bit rates configurations.
+   * @param networkType (int) that defines the type of network, eg. EON (equal 1), SDM (equal 2).
+   * @param weight the metric used to weight the links, LENGTH or HOPS.
+   * @param cacheFilename name of the binary file where the paths are cached.
+   * If empty, the paths are always computed and not cached.
+   */
+  Simulator(std::string networkFilename, int k, std::string bitrateFilename,
+            int networkType = DEFAULT_NETWORK_TYPE, pathWeight weight = LENGTH,
+            std::string cacheFilename = std::string());
   /**
    * @brief Deletes the object Simulator.
    */
@@ -28446,6 +34562,15 @@ class Simulator {
    * @brief Start the simulator processes.
    */
   void run(void);
+  /**
+   * @brief Leaves the simulator ready to run a new independent replication:
+   * the network is emptied (see Controller::reset), the clock and every
+   * statistic restart, and the random variables move to the next
+   * replication (new PHILOX streams, or the continuation of the MT19937
+   * ones). The estimators of importance sampling keep accumulating across
+   * replications.
+   */
+  void reset(void);
   /**
    * @brief Assign the lambda for simulation.
    *
@@ -28494,6 +34619,143 @@ class Simulator {
    * @param seed Param type unsigned integer.
    */
   void setSeedDst(unsigned int seed);
+  /**
+   * @brief Set the engine used by the random variables of the simulation.
+   *
+   * With MT19937 (default) every variable gets its own std::mt19937 seeded
+   * with its seed. With PHILOX every variable draws from the stream of a
+   * counter based generator identified by the replication and the variable
+   * (see variableStream), so variables sharing a seed are still independent
+   * and every replication is reproducible on its own.
+   *
+   * @param engine MT19937 or PHILOX.
+   */
+  void setRandomEngine(int engine);
+  /**
+   * @brief Set the replication index. With the PHILOX engine, each
+   * replication draws from its own independent streams for the same seeds.
+   *
+   * @param replication Param type unsigned integer.
+   */
+  void setReplication(unsigned int replication);
+  /**
+   * @brief Set the size of the blocks in which the random variables of the
+   * simulation pre-generate their values (see RandomVariable::setBatchSize).
+   * With a positive size the source and destination of a connection are also
+   * drawn as a single number in [0, N(N-1)) and mapped to an ordered pair of
+   * different nodes, so no draws are rejected. With 0 (default) the values
+   * are generated one by one, as in previous versions.
+   *
+   * @param batchSize Param type int, the amount of values of each block.
+   */
+  void setBatchSize(int batchSize);
+  /**
+   * @brief Enables the Common Random Numbers (CRN) mode. Every connection
+   * draws its interarrival time, holding time, (source, destination) pair
+   * and bit rate from its own substream, indexed by its id, of the PHILOX
+   * engine. Two simulations with the same seeds and replication then see
+   * exactly the same traffic, even if their blocking changes the order of
+   * the events (e.g. a connection reallocated from a buffer keeps its holding
+   * time), so their difference can be estimated with paired observations
+   * (see PairedDifference). The engine is set to PHILOX, and init throws if
+   * another engine was chosen with setRandomEngine. The batch size is
+   * ignored.
+   *
+   * @param commonRandomNumbers Param type bool.
+   */
+  void setCommonRandomNumbers(bool commonRandomNumbers);
+  /**
+   * @brief Makes every random variable of the simulation antithetic (see
+   * RandomVariable::setAntithetic). A simulation and its antithetic, with the
+   * same seeds and replication, form an antithetic pair whose observations
+   * are combined with AntitheticAverage. The correlation is strongest with
+   * Common Random Numbers, where the i-th connection of both simulations
+   * uses the same substream.
+   *
+   * The exponential values must be drawn by inversion, so init throws if the
+   * variables are batched (see setBatchSize), which use the ziggurat, unless
+   * Common Random Numbers are on.
+   *
+   * @param antithetic Param type bool.
+   */
+  void setAntithetic(bool antithetic);
+  /**
+   * @brief Enables the control variates estimator of the Blocking
+   * Probability (see getControlVariates). The arrivals are grouped in
+   * batches of batchSize, and for every batch the blocking ratio is observed
+   * along with three controls whose means are known:
+   * -The mean Erlang B blocking of the (source, destination) pairs of the
+   * batch, computed per link on the first route of each pair with the
+   * offered load of an uniform traffic (see erlangBApproximation).
+   * -The mean interarrival time, 1 / lambda.
+   * -The mean number of slots requested, with the first modulation of each
+   * bit rate.
+   *
+   * @param batchSize Param type long long, the amount of arrivals of each
+   * observation.
+   */
+  void setControlVariates(long long batchSize = 1000);
+  /**
+   * @brief Enables the importance sampling mode, meant for very low blocking
+   * probabilities. The arrivals and departures are simulated with the
+   * tilted rates (e.g. a higher lambda or a lower mu, so blocking is
+   * frequent), while the estimates refer to the nominal ones set with
+   * setLambda and setMu. Each interarrival time x and holding time h
+   * multiplies the likelihood ratio of the replication by
+   *
+   * \f[
+          \frac{\lambda e^{-\lambda x}}{\lambda' e^{-\lambda' x}}, \quad
+          \frac{\mu e^{-\mu h}}{\mu' e^{-\mu' h}}
+     \f]
+   *
+   * and every blocked arrival is weighted by the likelihood ratio at its
+   * arrival. Each run is a replication of goal connections from an empty
+   * network, and gives an unbiased estimate of the BP and BBP of those
+   * arrivals under the nominal rates; run replications with reset() and
+   * run() to get their confidence intervals. The likelihood ratio degenerates
+   * on long replications, so many short ones work better (check the
+   * effective sample size). The plain statistics (e.g.
+   * getBlockingProbability) refer to the tilted rates. For the same reason
+   * it can't be combined with the stopping rule or warm-up detection, which
+   * would change the length or the start of the replication depending on the
+   * tilted observations.
+   *
+   * @param lambdaTilted the arrival rate used to simulate.
+   * @param muTilted the departure rate used to simulate.
+   */
+  void setImportanceSampling(double lambdaTilted, double muTilted);
+  /**
+   * @brief Enables the parallel discrete event mode, meant for large
+   * topologies. Arrivals are processed in windows of windowSize arrivals;
+   * the events of a window (arrivals and departures) are ordered by time and
+   * every event is placed on the first level after the last earlier event
+   * that touches one of its links (the links of every candidate route of an
+   * arrival, or the links of a departing connection). The events of a level
+   * touch disjoint links, so they run concurrently on a thread pool, and
+   * the statistics are updated afterwards in time order.
+   *
+   * Conflicting events always keep their order, so the mode is conservative:
+   * it gives exactly the same statistics as the sequential engine with
+   * common random numbers (see setCommonRandomNumbers), which it enables.
+   * When the run stops in the middle of a window, the events of the window
+   * after the last arrival are undone, so the network and the pending events
+   * are also the ones of the sequential engine. The speedup depends on how
+   * many arrivals of a window have disjoint candidate routes, so it grows
+   * with the size of the topology.
+   *
+   * The allocator must only read the links of the candidate routes of the
+   * connection and keep no mutable state, which init checks with
+   * Allocator::isParallelSafe. PolicyAllocator, the allocators declared with
+   * BEGIN_ALLOC_FUNCTION and SpectrumAllocator (except Most Used) qualify;
+   * SDMAllocator doesn't, because it reuses scratch members between calls.
+   * Unassign callbacks, the defragmentation and the fragmentation statistics
+   * are not supported.
+   *
+   * @param numberOfThreads the threads of the pool. If it's lower than 1,
+   * the number of hardware threads is used.
+   * @param windowSize the amount of arrivals of each window.
+   */
+  void setParallelEvents(int numberOfThreads = 0, int windowSize = 4096);
   /**
    * @brief Set connections goal.
    *
@@ -28501,6 +34763,89 @@ class Simulator {
    * connections to be simulated.
    */
   void setGoalConnections(long long goal);
+  /**
+   * @brief Enables the sequential stopping rule. The run ends as soon as the
+   * half width of the confidence interval of the Blocking Probability (BP)
+   * and of the Bandwidth Blocking Probability (BBP) are both within the
+   * target, instead of always simulating the goal connections, which become
+   * the maximum number of arrivals.
+   *
+   * The target is checked every check interval arrivals (see
+   * setCheckInterval), once the minimum number of arrivals has been reached
+   * (see setMinConnections). While no connection has been blocked, the upper
+   * bound of the Wilson interval, z^2 / (n + z^2), is used instead: with a
+   * relative precision the run ends once it falls below the blocking floor,
+   * with an absolute precision once it falls below the precision.
+   *
+   * @param type the interval used for the BP: WALD_CI, AGRESTI_COULL_CI or
+   * WILSON_CI, and then the BBP uses a normal interval whose variance is
+   * obtained with the delta method over the blocking of each bit rate. With
+   * BATCH_MEANS_CI both use the batch means intervals, which also account
+   * for the correlation between consecutive arrivals.
+   * @param precision the maximum half width of the intervals.
+   * @param relative if true, the precision is relative to the estimate (e.g.
+   * 0.05 is 5% of the BP), otherwise it's absolute.
+   * @param blockingFloor the blocking probability below which a load without
+   * blocked connections is considered blocking free.
+   */
+  void setStoppingRule(ciType type, double precision, bool relative = true,
+                       double blockingFloor = 1e-5);
+  /**
+   * @brief Set the amount of arrivals between two checks of the stopping
+   * rule. By default 10000.
+   *
+   * @param interval Param type long long.
+   */
+  void setCheckInterval(long long interval);
+  /**
+   * @brief Set the minimum amount of arrivals to simulate before the stopping
+   * rule can end the run. By default 10000.
+   *
+   * @param minConnections Param type long long.
+   */
+  void setMinConnections(long long minConnections);
+  /**
+   * @brief Set the weight of each bit rate on the Bandwidth Blocking
+   * Probability. By default the weight of a bit rate is its magnitude in Gbps.
+   *
+   * @param weights one weight per bit rate, on the same order of the bit
+   * rates.
+   */
+  void setBBPWeights(std::vector<double> weights);
+  /**
+   * @brief Enables the automatic detection of the warm-up period with the
+   * MSER-5 rule (White, 1997). Every observation is the blocking ratio of
+   * observationSize consecutive arrivals, and the observations are grouped
+   * in batches of 5. Each time the amount of batches grows by 10%, the
+   * truncation point d that minimizes
+   *
+   * \f[
+          MSER(d) = \frac{1}{(n-d)^2} \sum_{i=d+1}^{n} (Y_i - \bar{Y}_{n,d})^2
+     \f]
+   *
+   * is computed over every d that leaves at least two batches. Once it falls
+   * on the first half, the network is considered on steady state: every
+   * arrival so far is deleted from every statistic of the simulator (BP,
+   * BBP and their intervals), and the warm-up callback is called. Deleting
+   * up to the detection instead of only the first d batches loses some
+   * arrivals, but keeps the statistics of the simulator on the same window
+   * as the ones the callback resets. While the minimum falls on the second
+   * half the series is still drifting, and the run goes on. The stopping
+   * rule isn't checked until the warm-up is detected.
+   *
+   * @param observationSize Param type long long, the amount of arrivals of
+   * each observation.
+   */
+  void setWarmupDetection(long long observationSize = 100);
+  /**
+   * @brief Sets the function called when the warm-up is detected, so the
+   * statistics collected outside the simulator (e.g. by the allocation
+   * function) can be reset at the same point as the ones of the simulator.
+   *
+   * @param callbackFunction the function, that receives the amount of
+   * arrivals deleted from the statistics of the simulator.
+   */
+  void setWarmupCallback(void (*callbackFunction)(long long));
   /**
    * @brief Set type of Bit Rates.
    *
@@ -28542,6 +34887,183 @@ class Simulator {
    * @return double The allocation probability.
    */
   double getAllocatedProbability(void);
+  /**
+   * @brief Get the Bandwidth Blocking Probability of the simulation, the
+   * weighted average of the blocking probability of each bit rate:
+   *
+   * \f[
+          BBP = \frac{\sum_b w_b \hat{p}_b}{\sum_b w_b}
+     \f]
+   *
+   * @return double the Bandwidth Blocking Probability.
+   */
+  double getBandwidthBlockingProbability(void);
+  /**
+   * @brief Get the number of arrivals simulated so far. If the stopping rule
+   * ended the run, it's lower than the goal connections.
+   *
+   * @return long long the number of arrivals.
+   */
+  long long getNumberOfConnections(void);
+  /**
+   * @brief Tells if the run was ended by the stopping rule, that is, the
+   * target precision was reached before the goal connections.
+   *
+   * @return true if the target was reached.
+   */
+  bool targetReached(void);
+  /**
+   * @brief Tells if the warm-up period was detected (see setWarmupDetection).
+   *
+   * @return true if the statistics are on steady state.
+   */
+  bool getWarmupDetected(void);
+  /**
+   * @brief Get the amount of arrivals deleted from the statistics of the
+   * simulator as warm-up.
+   *
+   * @return long long the amount of arrivals of the warm-up period.
+   */
+  long long getWarmupConnections(void);
+  /**
+   * @brief Get the batch means estimator of the Blocking Probability, fed
+   * with the blocking indicator of every arrival.
+   *
+   * @return BatchMeans the estimator.
+   */
+  BatchMeans getBPBatchMeans(void);
+  /**
+   * @brief Get the batch means estimator of the Bandwidth Blocking
+   * Probability. Bit rates are drawn uniformly, so every arrival of the bit
+   * rate b adds its blocking indicator scaled by B w_b / sum(w), whose mean
+   * is the BBP.
+   *
+   * @return BatchMeans the estimator.
+   */
+  BatchMeans getBBPBatchMeans(void);
+  /**
+   * @brief Get the batch means estimator of the Blocking Probability of a
+   * bit rate, fed with the blocking indicator of its arrivals.
+   *
+   * @param bitRate the position of the bit rate.
+   * @return BatchMeans the estimator.
+   */
+  BatchMeans getBitRateBatchMeans(int bitRate);
+  /**
+   * @brief Set if the simulator samples the fragmentation of the network on
+   * every event, for getMeanExternalFragmentation, getMeanSpectrumEntropy and
+   * getMeanFreeBlocks. It's off by default, and init throws if it's on
+   * along with the parallel events mode, which doesn't sample it.
+   *
+   * @param fragmentationStatistics true to sample the fragmentation.
+   */
+  void setFragmentationStatistics(bool fragmentationStatistics);
+  /**
+   * @brief Get if the simulator samples the fragmentation of the network (see
+   * setFragmentationStatistics).
+   *
+   * @return bool true if the fragmentation is sampled.
+   */
+  bool getFragmentationStatistics(void);
+  /**
+   * @brief Get the time-weighted average of the external fragmentation of
+   * the network (see Network::getExternalFragmentation) over the simulated
+   * time, sampled on every event when setFragmentationStatistics is on.
+   *
+   * @return double the mean external fragmentation between 0 and 1.
+   */
+  double getMeanExternalFragmentation(void);
+  /**
+   * @brief Get the time-weighted average of the spectrum entropy of the
+   * network (see Network::getSpectrumEntropy) over the simulated time.
+   *
+   * @return double the mean spectrum entropy in nats.
+   */
+  double getMeanSpectrumEntropy(void);
+  /**
+   * @brief Get the time-weighted average of the mean number of free blocks
+   * of the links of the network (see Network::getNumberOfFreeBlocks) over the
+   * simulated time.
+   *
+   * @return double the mean number of free blocks.
+   */
+  double getMeanFreeBlocks(void);
+  /**
+   * @brief Get the control variates estimator of the Blocking Probability.
+   * Its variance reduction factor tells how many times shorter a run can be
+   * to reach the precision of the plain estimate.
+   *
+   * @return ControlVariates the estimator.
+   */
+  ControlVariates getControlVariates(void);
+  /**
+   * @brief Get the importance sampling estimate of the Blocking Probability
+   * under the nominal rates, the mean of the estimates of the replications.
+   *
+   * @return double the estimate.
+   */
+  double getImportanceSamplingBP(void);
+  /**
+   * @brief Get the importance sampling estimate of the Bandwidth Blocking
+   * Probability under the nominal rates.
+   *
+   * @return double the estimate.
+   */
+  double getImportanceSamplingBBP(void);
+  /**
+   * @brief Half width of the confidence interval of the importance sampling
+   * BP, a Student t interval over the replications.
+   *
+   * @return double the half width, infinity with less than two replications.
+   */
+  double importanceSamplingBPCI(void);
+  /**
+   * @brief Half width of the confidence interval of the importance sampling
+   * BBP, a Student t interval over the replications.
+   *
+   * @return double the half width, infinity with less than two replications.
+   */
+  double importanceSamplingBBPCI(void);
+  /**
+   * @brief Get the amount of replications of the importance sampling
+   * estimates.
+   *
+   * @return long long the amount of replications.
+   */
+  long long getImportanceSamplingReplications(void);
+  /**
+   * @brief Get the likelihood ratio of the current replication.
+   *
+   * @return double the likelihood ratio.
+   */
+  double getLikelihoodRatio(void);
+  /**
+   * @brief Get the effective sample size of the weights of every arrival of
+   * the current replication, (sum w)^2 / sum w^2. If it's much lower than the amount of arrivals, a
+   * few of them dominate the estimate and the tilt is too strong.
+   *
+   * @return double the effective sample size.
+   */
+  double getEffectiveSampleSize(void);
+  /**
+   * @brief Computes the Erlang B blocking probability of a group of servers.
+   *
+   * @param load the offered load in Erlangs.
+   * @param servers the number of servers.
+   * @return double the blocking probability.
+   */
+  static double erlangB(double load, int servers);
+  /**
+   * @brief Computes the Erlang B approximation of the Blocking Probability of
+   * the network. Every link is an independent group of slots / E[slots]
+   * servers offered the uniform traffic of the pairs whose first route uses
+   * it, and a connection is blocked if any link of its route is. It ignores
+   * the spectrum continuity and contiguity constraints, so it's only a
+   * reference.
+   *
+   * @return double the mean blocking over every (source, destination) pair.
+   */
+  double erlangBApproximation(void);
 
   /**
    * @brief Gets the Network type of the object.
@@ -28550,12 +35072,27 @@ class Simulator {
    */
   int getNetworkType();
 
+  /**
+   * @brief Set if the simulator shows its configuration and progress table
+   * on screen while running. Replications that run in parallel should be
+   * quiet, so their tables don't get mixed.
+   *
+   * @param verbose true to show the progress (default), false to run quietly.
+   */
+  void setVerbose(bool verbose);
+
   /**
    * @brief Set the Confidence of confidence interval.
    *
    * @param c Must be a number between 0.00 and 1.00
    */
   void setConfidence(double c);
+  /**
+   * @brief Get the Confidence of confidence intervals.
+   *
+   * @return double a number between 0.00 and 1.00
+   */
+  double getConfidence(void);
 
   /**
    * @brief Wald Confidence Interval
@@ -28600,6 +35137,18 @@ class Simulator {
    */
   double wilsonCI(void);
 
+  /**
+   * @brief Bandwidth Blocking Probability Confidence Interval. The blocking of
+   * each bit rate is an independent proportion, so by the delta method:
+   *
+   * \f[
+          \pm z \cdot \frac{\sqrt{\sum_b w_b^2 \frac{\hat{p}_b (1-\hat{p}_b)}
+   {n_b}}}{\sum_b w_b} \f]
+   *
+   * @return double The half width of the BBP confidence interval.
+   */
+  double bbpCI(void);
+
   /**
    * @brief Get the BitRates vector attribute of the Simulator object.
    *
@@ -28625,6 +35174,9 @@ class Simulator {
  private:
   double clock;
   std::list<Event> events;
+  // Nodes of events already processed, spliced back into events by the next
+  // insertions instead of allocating new ones
+  std::list<Event> spareEvents;
   ExpVariable arriveVariable;
   ExpVariable departVariable;
   UniformVariable srcVariable;
@@ -28646,6 +35198,74 @@ class Simulator {
   unsigned int seedSrc;
   unsigned int seedDst;
   unsigned int seedBitRate;
+  int randomEngine;
+  // Whether the engine was chosen with setRandomEngine, so init doesn't
+  // override it
+  bool randomEngineSet;
+  unsigned int replication;
+  int batchSize;
+  bool commonRandomNumbers;
+  bool antithetic;
+  bool controlVariates;
+  long long controlBatchSize;
+  ControlVariates bpControlVariates;
+  std::vector<double> pathBlocking;
+  std::vector<double> bitRateSlots;
+  double controlBlocked;
+  double controlPredicted;
+  double controlInterarrival;
+  double controlSlots;
+  long long controlCount;
+  bool importanceSampling;
+  double tiltedLambda;
+  double tiltedMu;
+  double logLikelihoodRatio;
+  double weightedBlocked;
+  double weightedBandwidth;
+  double weightSum;
+  double weightSquares;
+  bool replicationClosed;
+  long long isReplications;
+  double isSum;
+  double isSquares;
+  double isBandwidthSum;
+  double isBandwidthSquares;
+  bool parallelEvents;
+  int parallelThreads;
+  int windowSize;
+  std::shared_ptr<ThreadPool> pool;
+  std::vector<std::vector<int>> pairLinks;
+  bool unassignCallback;
+  int numberOfNodes;
+  bool stoppingRule;
+  ciType stoppingCI;
+  double precision;
+  bool relativePrecision;
+  double blockingFloor;
+  long long checkInterval;
+  long long minConnections;
+  long long nextCheck;
+  bool stopped;
+  std::vector<double> bbpWeights;
+  std::vector<double> bitRateArrivals;
+  std::vector<double> bitRateBlocked;
+  std::vector<double> bbpFactors;
+  BatchMeans bpBatchMeans;
+  BatchMeans bbpBatchMeans;
+  std::vector<BatchMeans> bitRateBatchMeans;
+  bool fragmentationStatistics;
+  double fragmentationTime;
+  double externalFragmentationArea;
+  double spectrumEntropyArea;
+  double freeBlocksArea;
+  bool warmupDetection;
+  bool warmupDetected;
+  long long warmupBatchSize;
+  long long warmupConnections;
+  unsigned int warmupNextCheck;
+  std::vector<double> warmupMeans;
+  double warmupAllocated;
+  void (*warmupCallback)(long long);
   long long numberOfConnections;
   long long numberOfEvents;
   long long goalConnections;
@@ -28656,6 +35276,7 @@ class Simulator {
   double allocatedConnections;
   double blockingProbability;
   int columnWidth;
+  bool verbose;
   std::chrono::high_resolution_clock::time_point startingTime;
   std::chrono::high_resolution_clock::time_point checkTime;
   std::chrono::duration<double> timeDuration;
@@ -28675,10 +35296,23 @@ class Simulator {
    * seedSrc = 12345
    * seedDst = 12345
    * seedBitRate = 12345
+   * randomEngine = MT19937
+   * replication = 0
+   * batchSize = 0
+   * commonRandomNumbers = false
+   * antithetic = false
+   * controlVariates = false
+   * importanceSampling = false
+   * parallelEvents = false
+   * stoppingRule = false
+   * checkInterval = 10000
+   * minConnections = 10000
+   * warmupDetection = false
    * numberOfConnections = 0
    * numberOfEvents = 0
    * goalConnections = 10000
    * columnWidth = 10
+   * verbose = true
    */
   void defaultValues();
   /**
@@ -28688,10 +35322,97 @@ class Simulator {
   /**
    * @brief Shows on screen the percentage of completion of the simulation.
    */
-  void printRow(double percentage);
-
-  void initZScore(void);
-  void initZScoreEven(void);
+  void printRow(double percentage);
+
+  void initZScore(void);
+  void initZScoreEven(void);
+  /**
+   * @brief Checks if the half widths of the BP and BBP intervals are within
+   * the target of the stopping rule.
+   */
+  bool checkStoppingRule(void);
+  /**
+   * @brief Closes a batch of the warm-up detection and, when it's time,
+   * applies the MSER-5 rule, deleting the warm-up from the statistics.
+   */
+  void warmupRoutine(void);
+  /**
+   * @brief Computes the Erlang B blocking of every (source, destination) pair
+   * and the means of the controls.
+   */
+  void initControlVariates(void);
+  /**
+   * @brief Deletes the observations of the control variates, including the
+   * arrivals of the incomplete batch.
+   */
+  void resetControlVariates(void);
+  /**
+   * @brief Adds an arrival to the current batch of the control variates,
+   * closing it if it's complete.
+   *
+   * @param interarrival the interarrival time drawn by the arrival.
+   */
+  void controlRoutine(double interarrival);
+  /**
+   * @brief Creates the random variables of the current replication.
+   */
+  void initVariables(void);
+  /**
+   * @brief Restarts every statistic of the current replication.
+   */
+  void resetStatistics(void);
+  /**
+   * @brief Schedules the first arrival of the replication.
+   */
+  void scheduleFirstArrival(void);
+  /**
+   * @brief Inserts an event in the event list, reusing a spare node if there
+   * is one.
+   *
+   * @param position the event before which it's inserted.
+   * @param event the event.
+   */
+  void insertEvent(std::list<Event>::iterator position, const Event &event);
+  /**
+   * @brief Removes an event from the event list, keeping its node as a spare
+   * one for the next insertions.
+   *
+   * @param position the event removed.
+   */
+  void removeEvent(std::list<Event>::iterator position);
+  /**
+   * @brief Adds the estimates of the finished replication to the importance
+   * sampling estimators.
+   */
+  void closeReplication(void);
+  /**
+   * @brief Updates the statistics with the arrival that was just processed
+   * (this->src, this->dst, this->bitRate and this->rtnAllocation).
+   *
+   * @param interarrival the time until the next arrival.
+   * @param weight the likelihood ratio of the arrival (importance sampling).
+   */
+  void arrivalStatistics(double interarrival, double weight);
+  /**
+   * @brief Adds the fragmentation metrics of the network, which haven't
+   * changed since the last event, to their time-weighted averages.
+   *
+   * @param elapsed the time since the last event.
+   */
+  void sampleFragmentation(double elapsed);
+  /**
+   * @brief Runs the simulation on the parallel discrete event mode.
+   */
+  void runParallel(void);
+  /**
+   * @brief Get the links of every candidate route between two nodes, without
+   * repetitions.
+   *
+   * @param src the source node.
+   * @param dst the destination node.
+   * @return const std::vector<int>& the ids of the links.
+   */
+  const std::vector<int> &candidateLinks(int src, int dst);
 };
 
 #endif
@@ -28760,6 +35481,18 @@ Simulator::Simulator(std::string networkFilename, std::string pathFilename,
   this->allocatedConnections = 0;
 }
 
+Simulator::Simulator(std::string networkFilename, int k,
+                     std::string bitrateFilename, int networkType,
+                     pathWeight weight, std::string cacheFilename) {
+  this->defaultValues();
+  this->controller = new Controller();
+  this->controller->setNetwork(new Network(networkFilename, networkType));
+  this->controller->setPaths(k, weight, cacheFilename);
+  this->events = std::list<Event>();
+  this->bitRatesDefault = BitRate::readBitRateFile(bitrateFilename);
+  this->allocatedConnections = 0;
+}
+
 Simulator::~Simulator() {}
 
 void Simulator::setLambda(double lambda) {
@@ -28826,6 +35559,170 @@ void Simulator::setSeedDst(unsigned int seed) {
   this->seedDst = seed;
 }
 
+void Simulator::setRandomEngine(int engine) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set random engine parameter AFTER calling init simulator "
+        "method.");
+  }
+  if (engine != MT19937 && engine != PHILOX) {
+    throw std::runtime_error("Unknown random engine " +
+                             std::to_string(engine) + ".");
+  }
+  this->randomEngine = engine;
+  this->randomEngineSet = true;
+}
+
+void Simulator::setReplication(unsigned int replication) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set replication parameter AFTER calling init simulator "
+        "method.");
+  }
+  this->replication = replication;
+}
+
+void Simulator::setBatchSize(int batchSize) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set batch size parameter AFTER calling init simulator "
+        "method.");
+  }
+  if (batchSize < 0) {
+    throw std::runtime_error("Batch size must be non negative.");
+  }
+  this->batchSize = batchSize;
+}
+
+void Simulator::setStoppingRule(ciType type, double precision, bool relative,
+                                double blockingFloor) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set stopping rule AFTER calling init simulator method.");
+  }
+  if (precision <= 0) {
+    throw std::runtime_error("Precision must be positive.");
+  }
+  if (blockingFloor <= 0 || blockingFloor >= 1) {
+    throw std::runtime_error("Blocking floor must be between 0 and 1.");
+  }
+  this->stoppingRule = true;
+  this->stoppingCI = type;
+  this->precision = precision;
+  this->relativePrecision = relative;
+  this->blockingFloor = blockingFloor;
+}
+
+void Simulator::setCheckInterval(long long interval) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set check interval parameter AFTER calling init "
+        "simulator method.");
+  }
+  if (interval <= 0) {
+    throw std::runtime_error("Check interval must be positive.");
+  }
+  this->checkInterval = interval;
+}
+
+void Simulator::setMinConnections(long long minConnections) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set min connections parameter AFTER calling init "
+        "simulator method.");
+  }
+  this->minConnections = minConnections;
+}
+
+void Simulator::setBBPWeights(std::vector<double> weights) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set BBP weights AFTER calling init simulator method.");
+  }
+  for (unsigned int i = 0; i < weights.size(); i++) {
+    if (weights[i] < 0) {
+      throw std::runtime_error("BBP weights must be non negative.");
+    }
+  }
+  this->bbpWeights = weights;
+}
+
+void Simulator::setWarmupDetection(long long observationSize) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set warm-up detection AFTER calling init simulator "
+        "method.");
+  }
+  if (observationSize <= 0) {
+    throw std::runtime_error("Observation size must be positive.");
+  }
+  this->warmupDetection = true;
+  this->warmupBatchSize = 5 * observationSize;
+}
+
+void Simulator::setWarmupCallback(void (*callbackFunction)(long long)) {
+  this->warmupCallback = callbackFunction;
+}
+
+void Simulator::setCommonRandomNumbers(bool commonRandomNumbers) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set common random numbers AFTER calling init simulator "
+        "method.");
+  }
+  this->commonRandomNumbers = commonRandomNumbers;
+}
+
+void Simulator::setAntithetic(bool antithetic) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set antithetic parameter AFTER calling init simulator "
+        "method.");
+  }
+  this->antithetic = antithetic;
+}
+
+void Simulator::setControlVariates(long long batchSize) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set control variates AFTER calling init simulator "
+        "method.");
+  }
+  if (batchSize <= 0) {
+    throw std::runtime_error("Batch size must be positive.");
+  }
+  this->controlVariates = true;
+  this->controlBatchSize = batchSize;
+}
+
+void Simulator::setImportanceSampling(double lambdaTilted, double muTilted) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set importance sampling AFTER calling init simulator "
+        "method.");
+  }
+  if (lambdaTilted <= 0 || muTilted <= 0) {
+    throw std::runtime_error("Tilted rates must be positive.");
+  }
+  this->importanceSampling = true;
+  this->tiltedLambda = lambdaTilted;
+  this->tiltedMu = muTilted;
+}
+
+void Simulator::setParallelEvents(int numberOfThreads, int windowSize) {
+  if (this->initReady) {
+    throw std::runtime_error(
+        "You can not set parallel events AFTER calling init simulator "
+        "method.");
+  }
+  if (windowSize < 1) {
+    throw std::runtime_error("Window size must be positive.");
+  }
+  this->parallelEvents = true;
+  this->parallelThreads = numberOfThreads;
+  this->windowSize = windowSize;
+}
+
 void Simulator::setGoalConnections(long long goal) {
   if (this->initReady) {
     throw std::runtime_error(
@@ -28864,6 +35761,16 @@ void Simulator::setConfidence(double c) {
   this->confidence = c;
 }
 
+void Simulator::setVerbose(bool verbose) { this->verbose = verbose; }
+
+void Simulator::setFragmentationStatistics(bool fragmentationStatistics) {
+  this->fragmentationStatistics = fragmentationStatistics;
+}
+
+bool Simulator::getFragmentationStatistics(void) {
+  return this->fragmentationStatistics;
+}
+
 void Simulator::setNetworkType(int networkType) { 
   if (this->initReady) {
     throw std::runtime_error(
@@ -28883,14 +35790,51 @@ void Simulator::defaultValues() {
   this->seedSrc = 12345;
   this->seedDst = 12345;
   this->seedBitRate = 12345;
+  this->randomEngine = MT19937;
+  this->randomEngineSet = false;
+  this->replication = 0;
+  this->batchSize = 0;
+  this->commonRandomNumbers = false;
+  this->antithetic = false;
+  this->controlVariates = false;
+  this->controlBatchSize = 1000;
+  this->importanceSampling = false;
+  this->parallelEvents = false;
+  this->fragmentationStatistics = false;
+  this->parallelThreads = 0;
+  this->windowSize = 4096;
+  this->unassignCallback = false;
+  this->isReplications = 0;
+  this->isSum = 0;
+  this->isSquares = 0;
+  this->isBandwidthSum = 0;
+  this->isBandwidthSquares = 0;
+  this->weightSum = 0;
+  this->weightSquares = 0;
+  this->stoppingRule = false;
+  this->stoppingCI = WILSON_CI;
+  this->precision = 0.05;
+  this->relativePrecision = true;
+  this->blockingFloor = 1e-5;
+  this->checkInterval = 10000;
+  this->minConnections = 10000;
+  this->stopped = false;
+  this->warmupDetection = false;
+  this->warmupBatchSize = 500;
+  this->warmupCallback = nullptr;
   this->numberOfConnections = -1;
   this->numberOfEvents = 0;
   this->goalConnections = 10000;
   this->columnWidth = 10;
+  this->verbose = true;
   this->confidence = 0.95;
 }
 
 void Simulator::printInitialInfo() {
+  if (!this->verbose) {
+    this->startingTime = std::chrono::high_resolution_clock::now();
+    return;
+  }
   std::cout << std::setfill(' ') << std::setw(20) << std::left << "Nodes:";
   std::cout << std::setw(30)
             << this->controller->getNetwork()->getNumberOfNodes() << "\n";
@@ -28915,6 +35859,8 @@ void Simulator::printInitialInfo() {
   std::cout << std::setw(11) << "+";
   std::cout << std::setw(11) << "+";
   std::cout << std::setw(11) << "+";
+  std::cout << std::setw(11) << "+";
+  std::cout << std::setw(11) << "+";
   std::cout << std::setw(1) << "+\n";
 
   std::cout << std::setfill(' ') << std::setw(11) << "| progress";
@@ -28924,6 +35870,8 @@ void Simulator::printInitialInfo() {
   std::cout << std::setw(11) << "| Wald CI";
   std::cout << std::setw(11) << "| A-C. CI";
   std::cout << std::setw(11) << "| Wilson CI";
+  std::cout << std::setw(11) << "| BBP";
+  std::cout << std::setw(11) << "| BBP BM CI";
   std::cout << std::setw(1) << "|\n";
 
   std::cout << std::setfill('-') << std::setw(11) << std::left << "+";
@@ -28933,6 +35881,8 @@ void Simulator::printInitialInfo() {
   std::cout << std::setfill('-') << std::setw(11) << std::left << "+";
   std::cout << std::setfill('-') << std::setw(11) << std::left << "+";
   std::cout << std::setfill('-') << std::setw(11) << std::left << "+";
+  std::cout << std::setfill('-') << std::setw(11) << std::left << "+";
+  std::cout << std::setfill('-') << std::setw(11) << std::left << "+";
   // Nueva
   std::cout << std::setfill('-') << std::setw(1) << std::left << "+\n";
 
@@ -28944,6 +35894,7 @@ void Simulator::printRow(double percentage) {
   this->timeDuration =
       std::chrono::duration_cast<std::chrono::duration<double>>(
           this->checkTime - this->startingTime);
+  if (!this->verbose) return;
   std::cout << std::setprecision(1);
   std::cout << "|";
   std::cout << std::setfill(' ') << std::right << std::setw(7) << std::fixed
@@ -28952,8 +35903,7 @@ void Simulator::printRow(double percentage) {
             << this->numberOfConnections - 1 << "   |";
   std::cout << std::setfill(' ') << std::setw(9) << std::right
             << std::scientific
-            << 1 - this->allocatedConnections / this->numberOfConnections
-            << " |";  // getBlockingProbability
+            << this->getBlockingProbability() << " |";
   std::cout << std::setprecision(0) << std::setfill(' ') << std::setw(8)
             << std::right << std::fixed << this->timeDuration.count() << "  |";
 
@@ -28966,91 +35916,703 @@ void Simulator::printRow(double percentage) {
   std::cout << std::setfill(' ') << std::setw(9) << std::right
             << std::scientific << this->wilsonCI() << " |";
 
+  std::cout << std::setfill(' ') << std::setw(9) << std::right
+            << std::scientific << this->getBandwidthBlockingProbability()
+            << " |";
+
+  std::cout << std::setfill(' ') << std::setw(9) << std::right
+            << std::scientific
+            << this->bbpBatchMeans.halfWidth(this->confidence) << " |";
+
   std::cout << std::setw(1) << "\n";
 }
 
 int Simulator::eventRoutine(void) {
   this->currentEvent = this->events.front();
   this->rtnAllocation = N_A;
+  if (this->fragmentationStatistics)
+    this->sampleFragmentation(this->currentEvent.getTime() - this->clock);
   this->clock = this->currentEvent.getTime();
   if (this->currentEvent.getType() == ARRIVE) {
-    nextEventTime = this->clock + this->arriveVariable.getNextValue();
+    // Index of the substream of the connection on the CRN mode (the id of
+    // the first connection is -1)
+    long long index = this->currentEvent.getIdConnection() + 1;
+    double interarrival = this->commonRandomNumbers
+                              ? this->arriveVariable.getValueAt(index + 1)
+                              : this->arriveVariable.getNextValue();
+    nextEventTime = this->clock + interarrival;
+    double weight =
+        this->importanceSampling ? exp(this->logLikelihoodRatio) : 1;
     for (std::list<Event>::reverse_iterator pos = this->events.rbegin();
          pos != this->events.rend(); pos++) {
       if ((pos)->getTime() < nextEventTime) {
-        this->events.insert((pos).base(), Event(ARRIVE, nextEventTime,
-                                                this->numberOfConnections++));
+        this->insertEvent((pos).base(), Event(ARRIVE, nextEventTime,
+                                              this->numberOfConnections++));
         break;
       }
-    }
-    this->src = this->srcVariable.getNextIntValue();
-    this->dst = this->dstVariable.getNextIntValue();
-    while (this->src == this->dst) {
-      this->dst = this->dstVariable.getNextIntValue();
-    }
-    this->bitRate = bitRateVariable.getNextIntValue();
-    this->rtnAllocation = this->controller->assignConnection(
-        this->src, this->dst, this->bitRates[this->bitRate],
-        this->currentEvent.getIdConnection(), this->clock);
-    if (this->rtnAllocation == ALLOCATED) {
-      nextEventTime = this->clock + this->departVariable.getNextValue();
-      for (std::list<Event>::reverse_iterator pos = this->events.rbegin();
-           pos != this->events.rend(); pos++) {
-        if ((pos)->getTime() < nextEventTime) {
-          this->events.insert((pos).base(),
-                              Event(DEPARTURE, nextEventTime,
-                                    this->currentEvent.getIdConnection()));
-          break;
+    }
+    if (this->batchSize > 0 || this->commonRandomNumbers) {
+      // The pair is drawn from the N(N-1) ordered pairs of different nodes:
+      // the destination skips over the source instead of being redrawn
+      int pair = this->commonRandomNumbers
+                     ? this->srcVariable.getIntValueAt(index)
+                     : this->srcVariable.getNextIntValue();
+      this->src = pair / (this->numberOfNodes - 1);
+      this->dst = pair % (this->numberOfNodes - 1);
+      if (this->dst >= this->src) this->dst++;
+    } else {
+      this->src = this->srcVariable.getNextIntValue();
+      this->dst = this->dstVariable.getNextIntValue();
+      while (this->src == this->dst) {
+        this->dst = this->dstVariable.getNextIntValue();
+      }
+    }
+    this->bitRate = this->commonRandomNumbers
+                        ? this->bitRateVariable.getIntValueAt(index)
+                        : this->bitRateVariable.getNextIntValue();
+    this->rtnAllocation = this->controller->assignConnection(
+        this->src, this->dst, this->bitRates[this->bitRate],
+        this->currentEvent.getIdConnection(), this->clock);
+    this->arrivalStatistics(interarrival, weight);
+    if (this->rtnAllocation == ALLOCATED) {
+      double holding = this->commonRandomNumbers
+                           ? this->departVariable.getValueAt(index)
+                           : this->departVariable.getNextValue();
+      nextEventTime = this->clock + holding;
+      if (this->importanceSampling) {
+        this->logLikelihoodRatio += log(this->mu / this->tiltedMu) -
+                                    (this->mu - this->tiltedMu) * holding;
+      }
+      for (std::list<Event>::reverse_iterator pos = this->events.rbegin();
+           pos != this->events.rend(); pos++) {
+        if ((pos)->getTime() < nextEventTime) {
+          this->insertEvent((pos).base(),
+                            Event(DEPARTURE, nextEventTime,
+                                  this->currentEvent.getIdConnection()));
+          break;
+        }
+      }
+      this->allocatedConnections++;
+    }
+    if (this->warmupDetection && !this->warmupDetected &&
+        this->numberOfConnections % this->warmupBatchSize == 0) {
+      this->warmupRoutine();
+    }
+  } else if (this->currentEvent.getType() == DEPARTURE) {
+    (this->controller->*(this->controller->unassignConnection))(
+        this->currentEvent.getIdConnection(), this->clock);
+  }
+  this->removeEvent(this->events.begin());
+  return this->rtnAllocation;
+}
+
+void Simulator::arrivalStatistics(double interarrival, double weight) {
+  this->bitRateArrivals[this->bitRate]++;
+  if (this->rtnAllocation != ALLOCATED) this->bitRateBlocked[this->bitRate]++;
+  double blocked = this->rtnAllocation == ALLOCATED ? 0 : 1;
+  this->bpBatchMeans.addValue(blocked);
+  this->bbpBatchMeans.addValue(blocked * this->bbpFactors[this->bitRate]);
+  this->bitRateBatchMeans[this->bitRate].addValue(blocked);
+  if (this->controlVariates) this->controlRoutine(interarrival);
+  if (this->importanceSampling) {
+    // The weight only includes the variables drawn before this arrival
+    this->weightSum += weight;
+    this->weightSquares += weight * weight;
+    if (this->rtnAllocation != ALLOCATED) {
+      this->weightedBlocked += weight;
+      this->weightedBandwidth += weight * this->bbpFactors[this->bitRate];
+    }
+    this->logLikelihoodRatio += log(this->lambda / this->tiltedLambda) -
+                                (this->lambda - this->tiltedLambda) *
+                                    interarrival;
+  }
+}
+
+void Simulator::sampleFragmentation(double elapsed) {
+  Network *network = this->controller->getNetwork();
+  this->fragmentationTime += elapsed;
+  this->externalFragmentationArea +=
+      elapsed * network->getExternalFragmentation();
+  this->spectrumEntropyArea += elapsed * network->getSpectrumEntropy();
+  this->freeBlocksArea += elapsed * network->getNumberOfFreeBlocks();
+}
+
+void Simulator::init(void) {
+  this->initReady = true;
+  this->numberOfNodes = this->controller->getNetwork()->getNumberOfNodes();
+  if (this->parallelEvents) {
+    if (this->unassignCallback) {
+      throw std::runtime_error(
+          "Unassign callbacks are not supported on parallel events mode.");
+    }
+    if (this->controller->getDefragmentationTrigger() != NO_DEFRAGMENTATION) {
+      throw std::runtime_error(
+          "Defragmentation is not supported on parallel events mode.");
+    }
+    if (this->fragmentationStatistics) {
+      throw std::runtime_error(
+          "Fragmentation statistics are not supported on parallel events "
+          "mode.");
+    }
+    if (!this->controller->getAllocator()->isParallelSafe()) {
+      throw std::runtime_error(
+          "The allocator " + this->controller->getAllocator()->getName() +
+          " is not supported on parallel events mode.");
+    }
+    this->commonRandomNumbers = true;
+    this->pool = std::make_shared<ThreadPool>(this->parallelThreads);
+    this->pairLinks = std::vector<std::vector<int>>(this->numberOfNodes *
+                                                    this->numberOfNodes);
+  }
+  if (this->commonRandomNumbers) {
+    // Substreams indexed by connection need the random access of PHILOX
+    if (this->randomEngineSet && this->randomEngine != PHILOX) {
+      throw std::runtime_error(
+          "Common random numbers (also used by parallel events mode) require "
+          "the PHILOX random engine.");
+    }
+    this->randomEngine = PHILOX;
+  }
+  if (this->importanceSampling && this->controlVariates) {
+    throw std::runtime_error(
+        "Importance sampling can not be combined with control variates.");
+  }
+  // The weighted estimates are only unbiased for whole replications from an
+  // empty network, of a length fixed in advance
+  if (this->importanceSampling && this->stoppingRule) {
+    throw std::runtime_error(
+        "Importance sampling can not be combined with the stopping rule.");
+  }
+  if (this->importanceSampling && this->warmupDetection) {
+    throw std::runtime_error(
+        "Importance sampling can not be combined with warm-up detection.");
+  }
+  if (this->antithetic && this->batchSize > 0 && !this->commonRandomNumbers) {
+    // Batched exponential values use the ziggurat, which isn't monotone on
+    // its input, so 1 - U wouldn't give a negatively correlated value
+    throw std::runtime_error(
+        "Antithetic variates require INVERSION: use a batch size of 0 or "
+        "common random numbers.");
+  }
+  this->bitRates = this->bitRatesDefault;
+  if (this->bbpWeights.empty()) {
+    for (unsigned int i = 0; i < this->bitRates.size(); i++) {
+      this->bbpWeights.push_back(this->bitRates[i].getBitRate());
+    }
+  } else if (this->bbpWeights.size() != this->bitRates.size()) {
+    throw std::runtime_error(
+        "The number of BBP weights must match the number of bit rates.");
+  }
+  double totalWeight = 0;
+  for (unsigned int i = 0; i < this->bbpWeights.size(); i++) {
+    totalWeight += this->bbpWeights[i];
+  }
+  this->bbpFactors.clear();
+  for (unsigned int i = 0; i < this->bbpWeights.size(); i++) {
+    this->bbpFactors.push_back(this->bbpWeights[i] * this->bbpWeights.size() /
+                               totalWeight);
+  }
+  this->initVariables();
+  this->resetStatistics();
+  this->scheduleFirstArrival();
+  this->initZScore();
+  this->initZScoreEven();
+}
+
+void Simulator::reset(void) {
+  if (!this->initReady) {
+    throw std::runtime_error(
+        "You can not reset the simulator BEFORE calling init simulator "
+        "method.");
+  }
+  this->closeReplication();
+  this->controller->reset();
+  this->events.clear();
+  this->spareEvents.clear();
+  this->numberOfConnections = -1;
+  this->numberOfEvents = 0;
+  if (this->randomEngine == PHILOX) {
+    // Counter based streams are split by replication, so the next one is
+    // independent of every previous replication
+    this->replication++;
+    this->initVariables();
+  }
+  this->resetStatistics();
+  this->scheduleFirstArrival();
+}
+
+void Simulator::initVariables(void) {
+  this->controller->getAllocator()->setReplication(this->replication);
+  int lastNode = this->numberOfNodes - 1;
+  if (this->batchSize > 0 || this->commonRandomNumbers) {
+    // The source variable draws the index of the (src, dst) pair
+    lastNode = this->numberOfNodes * (this->numberOfNodes - 1) - 1;
+  }
+  double lambda = this->importanceSampling ? this->tiltedLambda : this->lambda;
+  double mu = this->importanceSampling ? this->tiltedMu : this->mu;
+  if (this->randomEngine == PHILOX) {
+    this->arriveVariable = ExpVariable(
+        PhiloxEngine(this->seedArrive,
+                     PhiloxEngine::streamId(this->replication, ARRIVE_STREAM)),
+        lambda);
+    this->departVariable = ExpVariable(
+        PhiloxEngine(this->seedDeparture, PhiloxEngine::streamId(
+                                              this->replication,
+                                              DEPARTURE_STREAM)),
+        mu);
+    this->srcVariable = UniformVariable(
+        PhiloxEngine(this->seedSrc,
+                     PhiloxEngine::streamId(this->replication, SRC_STREAM)),
+        lastNode);
+    this->dstVariable = UniformVariable(
+        PhiloxEngine(this->seedDst,
+                     PhiloxEngine::streamId(this->replication, DST_STREAM)),
+        lastNode);
+    this->bitRateVariable = UniformVariable(
+        PhiloxEngine(this->seedBitRate,
+                     PhiloxEngine::streamId(this->replication, BITRATE_STREAM)),
+        this->bitRatesDefault.size() - 1);
+  } else {
+    this->arriveVariable = ExpVariable(this->seedArrive, lambda);
+    this->departVariable = ExpVariable(this->seedDeparture, mu);
+    this->srcVariable = UniformVariable(this->seedSrc, lastNode);
+    this->dstVariable = UniformVariable(this->seedDst, lastNode);
+    this->bitRateVariable =
+        UniformVariable(this->seedBitRate, this->bitRatesDefault.size() - 1);
+  }
+  if (this->batchSize > 0 && !this->commonRandomNumbers) {
+    this->arriveVariable.setBatchSize(this->batchSize);
+    this->departVariable.setBatchSize(this->batchSize);
+    this->srcVariable.setBatchSize(this->batchSize);
+    this->bitRateVariable.setBatchSize(this->batchSize);
+  }
+  if (this->antithetic) {
+    this->arriveVariable.setAntithetic(true);
+    this->departVariable.setAntithetic(true);
+    this->srcVariable.setAntithetic(true);
+    this->dstVariable.setAntithetic(true);
+    this->bitRateVariable.setAntithetic(true);
+  }
+}
+
+void Simulator::resetStatistics(void) {
+  this->clock = 0;
+  this->allocatedConnections = 0;
+  this->bitRateArrivals = std::vector<double>(this->bitRates.size(), 0.0);
+  this->bitRateBlocked = std::vector<double>(this->bitRates.size(), 0.0);
+  this->bpBatchMeans.reset();
+  this->bbpBatchMeans.reset();
+  this->bitRateBatchMeans =
+      std::vector<BatchMeans>(this->bitRates.size(), BatchMeans());
+  this->fragmentationTime = 0;
+  this->externalFragmentationArea = 0;
+  this->spectrumEntropyArea = 0;
+  this->freeBlocksArea = 0;
+  if (this->controlVariates) this->initControlVariates();
+  this->nextCheck = this->checkInterval;
+  this->stopped = false;
+  this->warmupDetected = false;
+  this->warmupConnections = 0;
+  this->warmupNextCheck = 20;
+  this->warmupMeans.clear();
+  this->warmupAllocated = 0;
+  this->logLikelihoodRatio = 0;
+  this->weightedBlocked = 0;
+  this->weightedBandwidth = 0;
+  this->weightSum = 0;
+  this->weightSquares = 0;
+  this->replicationClosed = false;
+}
+
+void Simulator::scheduleFirstArrival(void) {
+  double interarrival = this->commonRandomNumbers
+                            ? this->arriveVariable.getValueAt(0)
+                            : this->arriveVariable.getNextValue();
+  if (this->importanceSampling) {
+    this->logLikelihoodRatio += log(this->lambda / this->tiltedLambda) -
+                                (this->lambda - this->tiltedLambda) *
+                                    interarrival;
+  }
+  this->insertEvent(this->events.end(),
+                    Event(ARRIVE, interarrival, this->numberOfConnections++));
+}
+
+void Simulator::insertEvent(std::list<Event>::iterator position,
+                            const Event &event) {
+  if (this->spareEvents.empty()) {
+    this->events.insert(position, event);
+  } else {
+    this->spareEvents.front() = event;
+    this->events.splice(position, this->spareEvents,
+                        this->spareEvents.begin());
+  }
+}
+
+void Simulator::removeEvent(std::list<Event>::iterator position) {
+  this->spareEvents.splice(this->spareEvents.begin(), this->events, position);
+}
+
+void Simulator::closeReplication(void) {
+  if (!this->importanceSampling || this->replicationClosed) return;
+  this->replicationClosed = true;
+  double arrivals = this->numberOfConnections;
+  if (arrivals <= 0) return;
+  double bp = this->weightedBlocked / arrivals;
+  double bbp = this->weightedBandwidth / arrivals;
+  this->isReplications++;
+  this->isSum += bp;
+  this->isSquares += bp * bp;
+  this->isBandwidthSum += bbp;
+  this->isBandwidthSquares += bbp * bbp;
+}
+
+void Simulator::run(void) {
+  if (this->parallelEvents) {
+    this->runParallel();
+    this->closeReplication();
+    return;
+  }
+  float timesToShow = 20;
+  float arrivesByCycle = this->goalConnections / timesToShow;
+  printInitialInfo();
+  for (int i = 1; i <= timesToShow; i++) {
+    while (this->numberOfConnections <= i * arrivesByCycle) {
+      eventRoutine();
+      if (this->stoppingRule && this->numberOfConnections >= this->nextCheck) {
+        this->nextCheck += this->checkInterval;
+        if ((!this->warmupDetection || this->warmupDetected) &&
+            this->numberOfConnections - this->warmupConnections >=
+                this->minConnections &&
+            this->checkStoppingRule()) {
+          this->stopped = true;
+          printRow(100.0 * this->numberOfConnections / this->goalConnections);
+          this->closeReplication();
+          return;
+        }
+      }
+    }
+    printRow((100 / timesToShow) * i);
+  }
+  this->closeReplication();
+}
+
+const std::vector<int> &Simulator::candidateLinks(int src, int dst) {
+  std::vector<int> &links = this->pairLinks[src * this->numberOfNodes + dst];
+  if (links.empty()) {
+    std::vector<std::vector<Link *>> &routes =
+        (*this->controller->getPaths())[src][dst];
+    for (unsigned int r = 0; r < routes.size(); r++) {
+      for (unsigned int l = 0; l < routes[r].size(); l++) {
+        links.push_back(routes[r][l]->getId());
+      }
+    }
+    std::sort(links.begin(), links.end());
+    links.erase(std::unique(links.begin(), links.end()), links.end());
+  }
+  return links;
+}
+
+void Simulator::runParallel(void) {
+  float timesToShow = 20;
+  float arrivesByCycle = this->goalConnections / timesToShow;
+  int row = 1;
+  printInitialInfo();
+  int size = this->windowSize;
+  std::vector<int> linkLevel(
+      this->controller->getNetwork()->getNumberOfLinks(), 0);
+  std::vector<int> sources(size), destinations(size), rates(size);
+  std::vector<int> arrivalLevel(size);
+  std::vector<double> times(size + 1), interarrivals(size), holdings(size);
+  std::vector<allocationStatus> status(size);
+  std::vector<Connection> connections;
+  std::vector<Connection> departing;
+  // Events of the window. The position of an arrival, or of the departure of
+  // a connection of the window, is its position on the window; the departure
+  // of an older connection c has position -(c + 1)
+  std::vector<eventType> eventTypes;
+  std::vector<double> eventTimes;
+  std::vector<int> eventPositions;
+  std::vector<int> eventLevels;
+  std::vector<int> order;
+  std::vector<std::vector<int>> levels;
+  std::vector<int> *level = nullptr;
+  // Inserts events on the event list, keeping it ordered by time
+  std::function<void(std::vector<Event> &)> schedule =
+      [&](std::vector<Event> &next) {
+        std::stable_sort(next.begin(), next.end(), [](Event a, Event b) {
+          return a.getTime() < b.getTime();
+        });
+        std::list<Event>::iterator pos = this->events.begin();
+        for (unsigned int k = 0; k < next.size(); k++) {
+          while (pos != this->events.end() &&
+                 pos->getTime() < next[k].getTime()) {
+            pos++;
+          }
+          this->insertEvent(pos, next[k]);
+        }
+      };
+  std::function<void(int)> task = [&](int i) {
+    int e = (*level)[i];
+    int position = eventPositions[e];
+    if (eventTypes[e] == ARRIVE) {
+      status[position] = this->controller->allocate(
+          sources[position], destinations[position],
+          this->bitRates[rates[position]], connections[position]);
+    } else if (position >= 0) {
+      if (status[position] == ALLOCATED) {
+        this->controller->release(connections[position]);
+      }
+    } else {
+      this->controller->release(departing[-position - 1]);
+    }
+  };
+
+  while (true) {
+    // Draw every variable of the arrivals of the window, which only depend
+    // on the index of the connection
+    std::list<Event>::iterator pending = this->events.begin();
+    while (pending->getType() != ARRIVE) pending++;
+    long long first = pending->getIdConnection();
+    times[0] = pending->getTime();
+    this->removeEvent(pending);
+    connections.clear();
+    for (int j = 0; j < size; j++) {
+      long long index = first + j + 1;
+      interarrivals[j] = this->arriveVariable.getValueAt(index + 1);
+      times[j + 1] = times[j] + interarrivals[j];
+      int pair = this->srcVariable.getIntValueAt(index);
+      sources[j] = pair / (this->numberOfNodes - 1);
+      destinations[j] = pair % (this->numberOfNodes - 1);
+      if (destinations[j] >= sources[j]) destinations[j]++;
+      rates[j] = this->bitRateVariable.getIntValueAt(index);
+      holdings[j] = this->departVariable.getValueAt(index);
+      connections.push_back(
+          Connection(first + j, times[j], &this->bitRates[rates[j]]));
+    }
+    double end = times[size];
+
+    eventTypes.clear();
+    eventTimes.clear();
+    eventPositions.clear();
+    departing.clear();
+    while (!this->events.empty() && this->events.front().getTime() < end) {
+      Event event = this->events.front();
+      this->removeEvent(this->events.begin());
+      Connection connection(event.getIdConnection(), 0, nullptr);
+      if (this->controller->removeConnection(event.getIdConnection(),
+                                             connection)) {
+        eventTypes.push_back(DEPARTURE);
+        eventTimes.push_back(event.getTime());
+        eventPositions.push_back(-static_cast<int>(departing.size()) - 1);
+        departing.push_back(connection);
+      }
+    }
+    for (int j = 0; j < size; j++) {
+      eventTypes.push_back(ARRIVE);
+      eventTimes.push_back(times[j]);
+      eventPositions.push_back(j);
+      if (times[j] + holdings[j] < end) {
+        eventTypes.push_back(DEPARTURE);
+        eventTimes.push_back(times[j] + holdings[j]);
+        eventPositions.push_back(j);
+      }
+    }
+    order.resize(eventTimes.size());
+    for (unsigned int e = 0; e < order.size(); e++) order[e] = e;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+      return eventTimes[a] < eventTimes[b];
+    });
+
+    // Every event goes one level after the last earlier event on its links
+    eventLevels.assign(eventTimes.size(), 0);
+    int depth = 0;
+    for (unsigned int k = 0; k < order.size(); k++) {
+      int e = order[k];
+      int position = eventPositions[e];
+      const std::vector<int> &links =
+          position >= 0
+              ? this->candidateLinks(sources[position], destinations[position])
+              : departing[-position - 1].getLinks();
+      int eventLevel = 0;
+      for (unsigned int l = 0; l < links.size(); l++) {
+        eventLevel = std::max(eventLevel, linkLevel[links[l]]);
+      }
+      eventLevel++;
+      if (eventTypes[e] == DEPARTURE && position >= 0) {
+        eventLevel = std::max(eventLevel, arrivalLevel[position] + 1);
+      }
+      for (unsigned int l = 0; l < links.size(); l++) {
+        linkLevel[links[l]] = eventLevel;
+      }
+      if (eventTypes[e] == ARRIVE) arrivalLevel[position] = eventLevel;
+      eventLevels[e] = eventLevel;
+      depth = std::max(depth, eventLevel);
+    }
+    std::fill(linkLevel.begin(), linkLevel.end(), 0);
+    levels.assign(depth + 1, std::vector<int>());
+    for (unsigned int k = 0; k < order.size(); k++) {
+      levels[eventLevels[order[k]]].push_back(order[k]);
+    }
+    for (int l = 1; l <= depth; l++) {
+      level = &levels[l];
+      if (level->size() == 1) {
+        task(0);
+      } else {
+        this->pool->parallelFor(0, level->size(), task);
+      }
+    }
+
+    // Register the connections that outlive the window
+    std::vector<Event> next;
+    for (int j = 0; j < size; j++) {
+      if (status[j] == ALLOCATED && times[j] + holdings[j] >= end) {
+        this->controller->addConnection(std::move(connections[j]));
+        next.push_back(Event(DEPARTURE, times[j] + holdings[j], first + j));
+      }
+    }
+    next.push_back(Event(ARRIVE, end, first + size));
+    schedule(next);
+
+    // Undoes the events of the window after the arrival where the run stops,
+    // so the network and the event list are left as the sequential engine
+    // leaves them after that arrival
+    std::function<void(int)> truncate = [&](int last) {
+      double cut = times[last];
+      for (std::list<Event>::iterator e = this->events.begin();
+           e != this->events.end();) {
+        std::list<Event>::iterator current = e++;
+        if (current->getType() == ARRIVE ||
+            current->getIdConnection() > first + last) {
+          this->removeEvent(current);
+        }
+      }
+      // First release the later arrivals, and then place back the
+      // connections that departed after the cut, as they may share slots
+      for (int j = last + 1; j < size; j++) {
+        if (status[j] != ALLOCATED || times[j] + holdings[j] < end) continue;
+        Connection connection(first + j, 0, nullptr);
+        this->controller->removeConnection(first + j, connection);
+        this->controller->release(connection);
+      }
+      next.clear();
+      for (unsigned int e = 0; e < eventTypes.size(); e++) {
+        if (eventTypes[e] != DEPARTURE || eventTimes[e] <= cut) continue;
+        int position = eventPositions[e];
+        if (position >= 0 && (position > last || status[position] != ALLOCATED))
+          continue;
+        Connection &connection =
+            position >= 0 ? connections[position] : departing[-position - 1];
+        this->controller->occupy(connection);
+        this->controller->addConnection(connection);
+        next.push_back(Event(DEPARTURE, eventTimes[e], connection.getId()));
+      }
+      next.push_back(Event(ARRIVE, times[last + 1], first + last + 1));
+      schedule(next);
+    };
+
+    // Update the statistics in time order, as the sequential engine does
+    for (int j = 0; j < size; j++) {
+      this->clock = times[j];
+      this->numberOfConnections++;
+      double weight =
+          this->importanceSampling ? exp(this->logLikelihoodRatio) : 1;
+      this->src = sources[j];
+      this->dst = destinations[j];
+      this->bitRate = rates[j];
+      this->rtnAllocation = status[j];
+      this->arrivalStatistics(interarrivals[j], weight);
+      if (this->rtnAllocation == ALLOCATED) {
+        if (this->importanceSampling) {
+          this->logLikelihoodRatio += log(this->mu / this->tiltedMu) -
+                                      (this->mu - this->tiltedMu) * holdings[j];
+        }
+        this->allocatedConnections++;
+      }
+      if (this->warmupDetection && !this->warmupDetected &&
+          this->numberOfConnections % this->warmupBatchSize == 0) {
+        this->warmupRoutine();
+      }
+      if (this->stoppingRule && this->numberOfConnections >= this->nextCheck) {
+        this->nextCheck += this->checkInterval;
+        if ((!this->warmupDetection || this->warmupDetected) &&
+            this->numberOfConnections - this->warmupConnections >=
+                this->minConnections &&
+            this->checkStoppingRule()) {
+          this->stopped = true;
+          printRow(100.0 * this->numberOfConnections / this->goalConnections);
+          truncate(j);
+          return;
         }
       }
-      this->allocatedConnections++;
+      while (row <= timesToShow &&
+             this->numberOfConnections > row * arrivesByCycle) {
+        printRow((100 / timesToShow) * row);
+        row++;
+      }
+      if (row > timesToShow) {
+        truncate(j);
+        return;
+      }
     }
-  } else if (this->currentEvent.getType() == DEPARTURE) {
-    (this->controller->*(this->controller->unassignConnection))(
-        this->currentEvent.getIdConnection(), this->clock);
   }
-  this->events.pop_front();
-  return this->rtnAllocation;
-}
-
-void Simulator::init(void) {
-  this->initReady = true;
-  this->clock = 0;
-  this->arriveVariable = ExpVariable(this->seedArrive, this->lambda);
-  this->departVariable = ExpVariable(this->seedDeparture, this->mu);
-  this->srcVariable = UniformVariable(
-      this->seedSrc, this->controller->getNetwork()->getNumberOfNodes() - 1);
-  this->dstVariable = UniformVariable(
-      this->seedDst, this->controller->getNetwork()->getNumberOfNodes() - 1);
-  this->bitRateVariable =
-      UniformVariable(this->seedBitRate, this->bitRatesDefault.size() - 1);
-  this->events.push_back(Event(ARRIVE, this->arriveVariable.getNextValue(),
-                               this->numberOfConnections++));
-  this->bitRates = this->bitRatesDefault;
-  this->initZScore();
-  this->initZScoreEven();
 }
 
-void Simulator::run(void) {
-  float timesToShow = 20;
-  float arrivesByCycle = this->goalConnections / timesToShow;
-  printInitialInfo();
-  for (int i = 1; i <= timesToShow; i++) {
-    while (this->numberOfConnections <= i * arrivesByCycle) {
-      eventRoutine();
-    }
-    printRow((100 / timesToShow) * i);
+bool Simulator::checkStoppingRule(void) {
+  double n = this->numberOfConnections - this->warmupConnections;
+  double bp = this->getBlockingProbability();
+  double z2 = this->zScore * this->zScore;
+  if (this->allocatedConnections == n) {
+    // Without blocked connections every interval collapses to 0, so the
+    // upper bound of the Wilson interval decides if the load is blocking free
+    double upper = z2 / (n + z2);
+    if (this->relativePrecision) return upper < this->blockingFloor;
+    return upper < this->precision;
+  }
+  if (this->stoppingCI == BATCH_MEANS_CI) {
+    double bpHalfWidth = this->bpBatchMeans.halfWidth(this->confidence);
+    double bbpHalfWidth = this->bbpBatchMeans.halfWidth(this->confidence);
+    if (this->relativePrecision) {
+      return bpHalfWidth <= this->precision * this->bpBatchMeans.getMean() &&
+             bbpHalfWidth <= this->precision * this->bbpBatchMeans.getMean();
+    }
+    return bpHalfWidth <= this->precision && bbpHalfWidth <= this->precision;
+  }
+  double bpHalfWidth;
+  switch (this->stoppingCI) {
+    case WALD_CI:
+      bpHalfWidth = this->waldCI();
+      break;
+    case AGRESTI_COULL_CI:
+      bpHalfWidth = this->agrestiCI();
+      break;
+    default:
+      bpHalfWidth = this->wilsonCI();
+      break;
   }
+  double bbp = this->getBandwidthBlockingProbability();
+  double bbpHalfWidth = this->bbpCI();
+  if (this->relativePrecision) {
+    return bpHalfWidth <= this->precision * bp &&
+           bbpHalfWidth <= this->precision * bbp;
+  }
+  return bpHalfWidth <= this->precision && bbpHalfWidth <= this->precision;
 }
 
 void Simulator::addDepartureEvent(long long idConnection){
-  double nextEventTime = this->clock + this->departVariable.getNextValue();
+  double holding = this->commonRandomNumbers
+                       ? this->departVariable.getValueAt(idConnection + 1)
+                       : this->departVariable.getNextValue();
+  double nextEventTime = this->clock + holding;
+  if (this->importanceSampling) {
+    this->logLikelihoodRatio += log(this->mu / this->tiltedMu) -
+                                (this->mu - this->tiltedMu) * holding;
+  }
   for (std::list<Event>::reverse_iterator pos = this->events.rbegin();
         pos != this->events.rend(); pos++) {
     if ((pos)->getTime() < nextEventTime) {
-      this->events.insert((pos).base(),
-                          Event(DEPARTURE, nextEventTime,
-                                idConnection));
+      this->insertEvent((pos).base(),
+                        Event(DEPARTURE, nextEventTime,
+                              idConnection));
       break;
     }
   }
@@ -29061,11 +36623,268 @@ unsigned int Simulator::getTimeDuration(void) {
 }
 
 double Simulator::getBlockingProbability(void) {
-  return 1 - this->allocatedConnections / this->numberOfConnections;
+  return 1 - this->allocatedConnections /
+                 (this->numberOfConnections - this->warmupConnections);
 }
 
 double Simulator::getAllocatedProbability(void) {
-  return this->allocatedConnections / this->numberOfConnections;
+  return this->allocatedConnections /
+         (this->numberOfConnections - this->warmupConnections);
+}
+
+double Simulator::getBandwidthBlockingProbability(void) {
+  double bbp = 0;
+  double totalWeight = 0;
+  for (unsigned int b = 0; b < this->bbpWeights.size(); b++) {
+    totalWeight += this->bbpWeights[b];
+    if (this->bitRateArrivals[b] == 0) continue;
+    bbp += this->bbpWeights[b] * this->bitRateBlocked[b] /
+           this->bitRateArrivals[b];
+  }
+  return bbp / totalWeight;
+}
+
+long long Simulator::getNumberOfConnections(void) {
+  return this->numberOfConnections;
+}
+
+bool Simulator::targetReached(void) { return this->stopped; }
+
+bool Simulator::getWarmupDetected(void) { return this->warmupDetected; }
+
+long long Simulator::getWarmupConnections(void) {
+  return this->warmupConnections;
+}
+
+double Simulator::getMeanExternalFragmentation(void) {
+  if (this->fragmentationTime == 0) return 0;
+  return this->externalFragmentationArea / this->fragmentationTime;
+}
+
+double Simulator::getMeanSpectrumEntropy(void) {
+  if (this->fragmentationTime == 0) return 0;
+  return this->spectrumEntropyArea / this->fragmentationTime;
+}
+
+double Simulator::getMeanFreeBlocks(void) {
+  if (this->fragmentationTime == 0) return 0;
+  return this->freeBlocksArea / this->fragmentationTime;
+}
+
+BatchMeans Simulator::getBPBatchMeans(void) { return this->bpBatchMeans; }
+
+BatchMeans Simulator::getBBPBatchMeans(void) { return this->bbpBatchMeans; }
+
+ControlVariates Simulator::getControlVariates(void) {
+  return this->bpControlVariates;
+}
+
+double Simulator::getImportanceSamplingBP(void) {
+  if (this->isReplications == 0) return 0;
+  return this->isSum / this->isReplications;
+}
+
+double Simulator::getImportanceSamplingBBP(void) {
+  if (this->isReplications == 0) return 0;
+  return this->isBandwidthSum / this->isReplications;
+}
+
+double Simulator::importanceSamplingBPCI(void) {
+  if (this->isReplications < 2) return std::numeric_limits<double>::infinity();
+  double n = this->isReplications;
+  double mean = this->isSum / n;
+  double variance = std::max(0.0, (this->isSquares - n * mean * mean) / (n - 1));
+  return BatchMeans::tQuantile((1 + this->confidence) / 2, n - 1) *
+         sqrt(variance / n);
+}
+
+double Simulator::importanceSamplingBBPCI(void) {
+  if (this->isReplications < 2) return std::numeric_limits<double>::infinity();
+  double n = this->isReplications;
+  double mean = this->isBandwidthSum / n;
+  double variance =
+      std::max(0.0, (this->isBandwidthSquares - n * mean * mean) / (n - 1));
+  return BatchMeans::tQuantile((1 + this->confidence) / 2, n - 1) *
+         sqrt(variance / n);
+}
+
+long long Simulator::getImportanceSamplingReplications(void) {
+  return this->isReplications;
+}
+
+double Simulator::getLikelihoodRatio(void) {
+  return exp(this->logLikelihoodRatio);
+}
+
+double Simulator::getEffectiveSampleSize(void) {
+  if (this->weightSquares == 0) return 0;
+  return this->weightSum * this->weightSum / this->weightSquares;
+}
+
+double Simulator::erlangB(double load, int servers) {
+  // B(0) = 1, B(k) = A B(k-1) / (k + A B(k-1))
+  double blocking = 1;
+  for (int k = 1; k <= servers; k++) {
+    blocking = load * blocking / (k + load * blocking);
+  }
+  return blocking;
+}
+
+double Simulator::erlangBApproximation(void) {
+  if (!this->initReady) {
+    throw std::runtime_error(
+        "You can not compute the Erlang B approximation BEFORE calling init "
+        "simulator method.");
+  }
+  if (this->pathBlocking.empty()) this->initControlVariates();
+  int n = this->numberOfNodes;
+  double total = 0;
+  for (int src = 0; src < n; src++) {
+    for (int dst = 0; dst < n; dst++) {
+      if (src != dst) total += this->pathBlocking[src * n + dst];
+    }
+  }
+  return total / (n * (n - 1));
+}
+
+void Simulator::initControlVariates(void) {
+  Network *network = this->controller->getNetwork();
+  std::vector<std::vector<std::vector<std::vector<Link *>>>> *paths =
+      this->controller->getPaths();
+  int n = network->getNumberOfNodes();
+  this->bitRateSlots.clear();
+  double meanSlots = 0;
+  for (unsigned int b = 0; b < this->bitRates.size(); b++) {
+    this->bitRateSlots.push_back(this->bitRates[b].getNumberOfSlots(0));
+    meanSlots += this->bitRateSlots.back();
+  }
+  meanSlots /= this->bitRates.size();
+
+  // Offered load of every link, in Erlangs of connections
+  std::vector<double> load(network->getNumberOfLinks(), 0.0);
+  double pairLoad = this->lambda / (this->mu * n * (n - 1));
+  for (int src = 0; src < n; src++) {
+    for (int dst = 0; dst < n; dst++) {
+      if (src == dst || (*paths)[src][dst].empty()) continue;
+      for (unsigned int l = 0; l < (*paths)[src][dst][0].size(); l++) {
+        load[(*paths)[src][dst][0][l]->getId()] += pairLoad;
+      }
+    }
+  }
+  std::vector<double> linkBlocking(load.size());
+  for (unsigned int l = 0; l < load.size(); l++) {
+    int servers = network->getLink(l)->getSlots() / meanSlots;
+    linkBlocking[l] = Simulator::erlangB(load[l], servers);
+  }
+  this->pathBlocking = std::vector<double>(n * n, 0.0);
+  double meanBlocking = 0;
+  for (int src = 0; src < n; src++) {
+    for (int dst = 0; dst < n; dst++) {
+      if (src == dst) continue;
+      double free = (*paths)[src][dst].empty() ? 0 : 1;
+      if (!(*paths)[src][dst].empty()) {
+        for (unsigned int l = 0; l < (*paths)[src][dst][0].size(); l++) {
+          free *= 1 - linkBlocking[(*paths)[src][dst][0][l]->getId()];
+        }
+      }
+      this->pathBlocking[src * n + dst] = 1 - free;
+      meanBlocking += 1 - free;
+    }
+  }
+  meanBlocking /= n * (n - 1);
+
+  this->bpControlVariates =
+      ControlVariates({meanBlocking, 1 / this->lambda, meanSlots});
+  this->resetControlVariates();
+}
+
+void Simulator::resetControlVariates(void) {
+  this->bpControlVariates.reset();
+  this->controlBlocked = 0;
+  this->controlPredicted = 0;
+  this->controlInterarrival = 0;
+  this->controlSlots = 0;
+  this->controlCount = 0;
+}
+
+void Simulator::controlRoutine(double interarrival) {
+  if (this->rtnAllocation != ALLOCATED) this->controlBlocked++;
+  this->controlPredicted +=
+      this->pathBlocking[this->src * this->numberOfNodes + this->dst];
+  this->controlInterarrival += interarrival;
+  this->controlSlots += this->bitRateSlots[this->bitRate];
+  this->controlCount++;
+  if (this->controlCount < this->controlBatchSize) return;
+  double count = this->controlCount;
+  this->bpControlVariates.addObservation(
+      this->controlBlocked / count,
+      {this->controlPredicted / count, this->controlInterarrival / count,
+       this->controlSlots / count});
+  this->controlBlocked = 0;
+  this->controlPredicted = 0;
+  this->controlInterarrival = 0;
+  this->controlSlots = 0;
+  this->controlCount = 0;
+}
+
+BatchMeans Simulator::getBitRateBatchMeans(int bitRate) {
+  if (bitRate < 0 || bitRate >= static_cast<int>(this->bitRateBatchMeans.size())) {
+    throw std::runtime_error("Bit rate " + std::to_string(bitRate) +
+                             " does not exist.");
+  }
+  return this->bitRateBatchMeans[bitRate];
+}
+
+void Simulator::warmupRoutine(void) {
+  this->warmupMeans.push_back(
+      1 - (this->allocatedConnections - this->warmupAllocated) /
+              this->warmupBatchSize);
+  this->warmupAllocated = this->allocatedConnections;
+
+  unsigned int n = this->warmupMeans.size();
+  if (n < this->warmupNextCheck) return;
+  this->warmupNextCheck = n + n / 10;
+
+  // MSER(d) for every d that leaves at least two batches, with suffix sums
+  double sum = this->warmupMeans[n - 1];
+  double sumSquares = this->warmupMeans[n - 1] * this->warmupMeans[n - 1];
+  unsigned int truncation = n - 2;
+  double best = -1;
+  for (int d = n - 2; d >= 0; d--) {
+    sum += this->warmupMeans[d];
+    sumSquares += this->warmupMeans[d] * this->warmupMeans[d];
+    double m = n - d;
+    double mser = (sumSquares - sum * sum / m) / (m * m);
+    if (best < 0 || mser <= best) {
+      best = mser;
+      truncation = d;
+    }
+  }
+  // A minimum on the second half means the series is still drifting (or
+  // only its last batches are stable), so the run goes on
+  if (2 * truncation >= n) return;
+
+  // Every statistic restarts from here, not only from the truncation point,
+  // so they cover the same arrivals as the ones the warm-up callback resets
+  this->warmupDetected = true;
+  this->warmupConnections = this->numberOfConnections;
+  this->allocatedConnections = 0;
+  std::fill(this->bitRateArrivals.begin(), this->bitRateArrivals.end(), 0.0);
+  std::fill(this->bitRateBlocked.begin(), this->bitRateBlocked.end(), 0.0);
+  this->bpBatchMeans.reset();
+  this->bbpBatchMeans.reset();
+  for (unsigned int i = 0; i < this->bitRateBatchMeans.size(); i++) {
+    this->bitRateBatchMeans[i].reset();
+  }
+  if (this->controlVariates) this->resetControlVariates();
+  this->fragmentationTime = 0;
+  this->externalFragmentationArea = 0;
+  this->spectrumEntropyArea = 0;
+  this->freeBlocksArea = 0;
+  std::vector<double>().swap(this->warmupMeans);
+  if (this->warmupCallback != nullptr) {
+    this->warmupCallback(this->warmupConnections);
+  }
 }
 
 int Simulator::getNetworkType() { return this->controller->getNetwork()->getNetworkType(); }
@@ -29073,7 +36892,7 @@ int Simulator::getNetworkType() { return this->controller->getNetwork()->getNetw
 double Simulator::waldCI() {
   double np = this->getAllocatedProbability();
   double p = 1 - np;
-  int n = this->numberOfConnections;
+  int n = this->numberOfConnections - this->warmupConnections;
   double sd = sqrt((np * p) / n);
 
   return this->zScore * sd;
@@ -29081,7 +36900,7 @@ double Simulator::waldCI() {
 
 double Simulator::agrestiCI() {
   double np = this->getAllocatedProbability();
-  int n = this->numberOfConnections;
+  int n = this->numberOfConnections - this->warmupConnections;
 
   np = np * ((n * (this->allocatedConnections + (this->zScoreEven/2))) /
              (this->allocatedConnections * (n + this->zScoreEven)));
@@ -29095,7 +36914,7 @@ double Simulator::agrestiCI() {
 double Simulator::wilsonCI() {
   double np = this->getAllocatedProbability();
   double p = 1 - np;
-  int n = this->numberOfConnections;
+  int n = this->numberOfConnections - this->warmupConnections;
 
   double denom = (1 + (pow(this->zScore, 2) / n));
 
@@ -29105,6 +36924,21 @@ double Simulator::wilsonCI() {
   return (this->zScore * sd) / denom;
 }
 
+double Simulator::getConfidence(void) { return this->confidence; }
+
+double Simulator::bbpCI() {
+  double variance = 0;
+  double totalWeight = 0;
+  for (unsigned int b = 0; b < this->bbpWeights.size(); b++) {
+    totalWeight += this->bbpWeights[b];
+    double n = this->bitRateArrivals[b];
+    if (n == 0) continue;
+    double p = this->bitRateBlocked[b] / n;
+    variance += this->bbpWeights[b] * this->bbpWeights[b] * p * (1 - p) / n;
+  }
+  return this->zScore * sqrt(variance) / totalWeight;
+}
+
 void Simulator::initZScore(void) {
   double actual = 0.0;
   double step = 1.0;
@@ -29142,6 +36976,7 @@ void Simulator::initZScoreEven(void) {
 
 void Simulator::setUnassignCallback(void (*callbackFunction)(Connection, double,
                                                              Network *)) {
+  this->unassignCallback = true;
   this->controller->setUnassignCallback(callbackFunction);
 }
 
@@ -29151,3 +36986,357 @@ std::vector<std::vector<std::vector<std::vector<Link *>>>> *Simulator::getPaths(
 
 Controller *Simulator::getController() {return this->controller; }
 
+
+#ifndef __REPLICATION_RUNNER_H__
+#define __REPLICATION_RUNNER_H__
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// #include "simulator.hpp"
+// #include "thread_pool.hpp"
+
+/**
+ * @brief Class that runs independent replications of a simulation in parallel
+ * and merges their statistics.
+ *
+ * Instead of one long run per load point, R shorter replications run on the
+ * threads of a ThreadPool. Every replication has its own Simulator (and
+ * therefore its own Network state), built by a factory function, and runs
+ * on its own PHILOX substreams (replication index firstReplication + r), so
+ * the replications are independent. The runner doesn't change the goal
+ * connections set by the factory, so to spend the budget of a run of N
+ * connections the factory must set a goal of N / R.
+ *
+ * Each replication gives one estimate of every metric, and the merged
+ * estimate is the mean of the replications with a Student t interval:
+ *
+ * \f[
+        \bar{X} \pm t_{R-1} \cdot \frac{s_R}{\sqrt{R}}
+   \f]
+ *
+ * The BP, the BBP and the BP of every bit rate are always collected. Any
+ * other metric (for example the buffer metrics of a driver) can be added
+ * with addMetric, as long as it is computed from state owned by the
+ * replication.
+ */
+class ReplicationRunner {
+ public:
+  /**
+   * @brief Constructs a new ReplicationRunner object.
+   *
+   * @param factory function that builds and configures the simulator of a
+   * replication (network, allocator, lambda, mu, goal connections...), given
+   * the index of the replication. It must NOT call the init method, and must
+   * not share mutable state between replications. Calls to the factory are
+   * serialized, so it may read files.
+   * @param replications the amount of replications, at least 2.
+   * @param numberOfThreads the threads used to run the replications. If it's
+   * lower than 1, the number of hardware threads is used.
+   */
+  ReplicationRunner(std::function<Simulator *(int)> factory, int replications,
+                    int numberOfThreads = 0);
+  /**
+   * @brief Set if the transient of every replication is detected and
+   * deleted with MSER-5 (see Simulator::setWarmupDetection).
+   *
+   * @param warmupDetection true to delete the warm-up of every replication.
+   */
+  void setWarmupDetection(bool warmupDetection);
+  /**
+   * @brief Set the index of the first replication, so several runners (for
+   * example, of different load points) use different substreams.
+   *
+   * @param firstReplication the replication index of the first replication.
+   */
+  void setFirstReplication(unsigned int firstReplication);
+  /**
+   * @brief Set the confidence of the merged confidence intervals.
+   *
+   * @param confidence a number between 0 and 1.
+   */
+  void setConfidence(double confidence);
+  /**
+   * @brief Adds a metric computed on every replication once it has finished.
+   *
+   * @param name the name of the metric.
+   * @param metric function that computes the metric from the simulator of the
+   * replication. It's executed on the thread of the replication.
+   */
+  void addMetric(std::string name, std::function<double(Simulator &)> metric);
+  /**
+   * @brief Runs every replication and merges their statistics. Previous
+   * results are discarded.
+   *
+   */
+  void run(void);
+  /**
+   * @brief Get the merged Blocking Probability.
+   *
+   * @return double the mean of the BP of the replications.
+   */
+  double getBlockingProbability(void);
+  /**
+   * @brief Get the merged Bandwidth Blocking Probability.
+   *
+   * @return double the mean of the BBP of the replications.
+   */
+  double getBandwidthBlockingProbability(void);
+  /**
+   * @brief Get the merged Blocking Probability of a bit rate.
+   *
+   * @param bitRate the position of the bit rate.
+   * @return double the mean of the BP of the bit rate of the replications.
+   */
+  double getBitRateBlockingProbability(int bitRate);
+  /**
+   * @brief Get the merged value of a metric added with addMetric.
+   *
+   * @param name the name of the metric.
+   * @return double the mean of the metric over the replications.
+   */
+  double getMetric(std::string name);
+  /**
+   * @brief Half width of the merged confidence interval of the BP.
+   *
+   * @return double the half width.
+   */
+  double bpCI(void);
+  /**
+   * @brief Half width of the merged confidence interval of the BBP.
+   *
+   * @return double the half width.
+   */
+  double bbpCI(void);
+  /**
+   * @brief Half width of the merged confidence interval of the BP of a bit
+   * rate.
+   *
+   * @param bitRate the position of the bit rate.
+   * @return double the half width.
+   */
+  double bitRateCI(int bitRate);
+  /**
+   * @brief Half width of the merged confidence interval of a metric added
+   * with addMetric.
+   *
+   * @param name the name of the metric.
+   * @return double the half width.
+   */
+  double metricCI(std::string name);
+  /**
+   * @brief Get the estimates of every replication of a metric. The BP, BBP
+   * and bit rate metrics are named "BP", "BBP" and "BP <position>".
+   *
+   * @param name the name of the metric.
+   * @return std::vector<double> the estimate of each replication, on order.
+   */
+  std::vector<double> getReplicationValues(std::string name);
+  /**
+   * @brief Get the amount of connections of every replication after the
+   * warm-up deletion.
+   *
+   * @return std::vector<long long> the connections of each replication.
+   */
+  std::vector<long long> getReplicationConnections(void);
+  /**
+   * @brief Get the amount of replications.
+   *
+   * @return int the amount of replications.
+   */
+  int getNumberOfReplications(void);
+  /**
+   * @brief Get the wall time of the last run.
+   *
+   * @return double the duration in seconds.
+   */
+  double getTimeDuration(void);
+
+ private:
+  std::function<Simulator *(int)> factory;
+  int replications;
+  ThreadPool pool;
+  bool warmupDetection;
+  unsigned int firstReplication;
+  double confidence;
+  std::vector<std::string> metricNames;
+  std::vector<std::function<double(Simulator &)>> metrics;
+  std::map<std::string, std::vector<double>> values;
+  std::vector<long long> connections;
+  std::mutex mutex;
+  std::chrono::duration<double> timeDuration;
+
+  double mean(std::string name);
+  double halfWidth(std::string name);
+};
+
+#endif
+// #include "replication_runner.hpp"
+
+ReplicationRunner::ReplicationRunner(std::function<Simulator *(int)> factory,
+                                     int replications, int numberOfThreads)
+    : pool(numberOfThreads) {
+  if (replications < 2) {
+    throw std::runtime_error("Number of replications must be at least 2.");
+  }
+  this->factory = factory;
+  this->replications = replications;
+  this->warmupDetection = false;
+  this->firstReplication = 0;
+  this->confidence = 0.95;
+  this->timeDuration = std::chrono::duration<double>(0);
+}
+
+void ReplicationRunner::setWarmupDetection(bool warmupDetection) {
+  this->warmupDetection = warmupDetection;
+}
+
+void ReplicationRunner::setFirstReplication(unsigned int firstReplication) {
+  this->firstReplication = firstReplication;
+}
+
+void ReplicationRunner::setConfidence(double confidence) {
+  if (confidence <= 0 || confidence >= 1) {
+    throw std::runtime_error(
+        "You can't set a confidence interval with confidence equal/higher than "
+        "1 or equal/lower than 0.");
+  }
+  this->confidence = confidence;
+}
+
+void ReplicationRunner::addMetric(std::string name,
+                                  std::function<double(Simulator &)> metric) {
+  if (name == "BP" || name == "BBP" || name.compare(0, 3, "BP ") == 0) {
+    throw std::runtime_error("Metric name " + name + " is reserved.");
+  }
+  this->metricNames.push_back(name);
+  this->metrics.push_back(metric);
+}
+
+void ReplicationRunner::run(void) {
+  std::chrono::high_resolution_clock::time_point start =
+      std::chrono::high_resolution_clock::now();
+  this->values.clear();
+  this->connections = std::vector<long long>(this->replications, 0);
+  this->values["BP"] = std::vector<double>(this->replications, 0.0);
+  this->values["BBP"] = std::vector<double>(this->replications, 0.0);
+  for (unsigned int m = 0; m < this->metricNames.size(); m++) {
+    this->values[this->metricNames[m]] =
+        std::vector<double>(this->replications, 0.0);
+  }
+
+  std::function<void(int)> task = [this](int r) {
+    // Owned by the task, so it's deleted even if the replication throws
+    std::unique_ptr<Simulator> simulator;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      simulator.reset(this->factory(r));
+    }
+    simulator->setVerbose(false);
+    simulator->setRandomEngine(PHILOX);
+    simulator->setReplication(this->firstReplication + r);
+    if (this->warmupDetection) simulator->setWarmupDetection();
+    simulator->init();
+    simulator->run();
+
+    std::vector<double> bitRateBP;
+    for (unsigned int b = 0; b < simulator->getBitRates().size(); b++) {
+      bitRateBP.push_back(simulator->getBitRateBatchMeans(b).getMean());
+    }
+    std::vector<double> metricValues;
+    for (unsigned int m = 0; m < this->metrics.size(); m++) {
+      metricValues.push_back(this->metrics[m](*simulator));
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->values["BP"][r] = simulator->getBlockingProbability();
+    this->values["BBP"][r] = simulator->getBandwidthBlockingProbability();
+    for (unsigned int b = 0; b < bitRateBP.size(); b++) {
+      std::vector<double> &series = this->values["BP " + std::to_string(b)];
+      series.resize(this->replications, 0.0);
+      series[r] = bitRateBP[b];
+    }
+    for (unsigned int m = 0; m < metricValues.size(); m++) {
+      this->values[this->metricNames[m]][r] = metricValues[m];
+    }
+    this->connections[r] = simulator->getNumberOfConnections() -
+                           simulator->getWarmupConnections();
+  };
+  this->pool.parallelFor(0, this->replications, task);
+
+  this->timeDuration =
+      std::chrono::duration_cast<std::chrono::duration<double>>(
+          std::chrono::high_resolution_clock::now() - start);
+}
+
+double ReplicationRunner::mean(std::string name) {
+  if (this->values.count(name) == 0) {
+    throw std::runtime_error("There are no values of metric " + name + ".");
+  }
+  std::vector<double> &series = this->values[name];
+  double sum = 0;
+  for (unsigned int r = 0; r < series.size(); r++) sum += series[r];
+  return sum / series.size();
+}
+
+double ReplicationRunner::halfWidth(std::string name) {
+  double average = this->mean(name);
+  std::vector<double> &series = this->values[name];
+  double variance = 0;
+  for (unsigned int r = 0; r < series.size(); r++) {
+    variance += (series[r] - average) * (series[r] - average);
+  }
+  variance /= series.size() - 1;
+  return BatchMeans::tQuantile((1 + this->confidence) / 2, series.size() - 1) *
+         sqrt(variance / series.size());
+}
+
+double ReplicationRunner::getBlockingProbability(void) {
+  return this->mean("BP");
+}
+
+double ReplicationRunner::getBandwidthBlockingProbability(void) {
+  return this->mean("BBP");
+}
+
+double ReplicationRunner::getBitRateBlockingProbability(int bitRate) {
+  return this->mean("BP " + std::to_string(bitRate));
+}
+
+double ReplicationRunner::getMetric(std::string name) {
+  return this->mean(name);
+}
+
+double ReplicationRunner::bpCI(void) { return this->halfWidth("BP"); }
+
+double ReplicationRunner::bbpCI(void) { return this->halfWidth("BBP"); }
+
+double ReplicationRunner::bitRateCI(int bitRate) {
+  return this->halfWidth("BP " + std::to_string(bitRate));
+}
+
+double ReplicationRunner::metricCI(std::string name) {
+  return this->halfWidth(name);
+}
+
+std::vector<double> ReplicationRunner::getReplicationValues(std::string name) {
+  if (this->values.count(name) == 0) {
+    throw std::runtime_error("There are no values of metric " + name + ".");
+  }
+  return this->values[name];
+}
+
+std::vector<long long> ReplicationRunner::getReplicationConnections(void) {
+  return this->connections;
+}
+
+int ReplicationRunner::getNumberOfReplications(void) {
+  return this->replications;
+}
+
+double ReplicationRunner::getTimeDuration(void) {
+  return this->timeDuration.count();
+}
@@ -0,0 +1,112 @@
+#include "../src/simulator.hpp"
+/*********************************************************************************
+ * Checks that the parallel evaluation of candidates (see
+ * Allocator::setParallelCandidates) chooses the same candidate as a
+ * sequential loop, whatever the number of threads. First on random scores
+ * with many ties, and then on the Most Used policy of SpectrumAllocator,
+ * whose choices on NSFNet are recorded without and with a pool. Run it from
+ * the root of the repository, as the drivers:
+ *
+ *   g++ -std=c++17 -O2 -pthread tests/parallel_candidates.cpp \
+ *       -o parallel_candidates && ./parallel_candidates
+ *
+ * It prints every failed check and returns the number of failures.
+ **********************************************************************************/
+
+int failures = 0;
+
+void check(bool condition, const std::string &name) {
+  if (!condition) {
+    std::cout << "FAILED: " << name << '\n';
+    failures++;
+  }
+}
+
+// Exposes bestCandidate, which is protected
+class ScoringAllocator : public Allocator {
+ public:
+  allocationStatus exec(int, int, BitRate, Connection &) {
+    return NOT_ALLOCATED;
+  }
+  long long best(long long numberOfCandidates,
+                 std::function<double(long long)> score) {
+    return this->bestCandidate(numberOfCandidates, score);
+  }
+};
+
+void randomScores(void) {
+  std::mt19937 random(12345);
+  ScoringAllocator sequential;
+  ScoringAllocator one;
+  one.setParallelCandidates(1, 1);
+  ScoringAllocator many;
+  many.setParallelCandidates(4, 1);
+  for (int t = 0; t < 2000; t++) {
+    // Few distinct scores, so most candidates tie, and some infeasible ones
+    int candidates = random() % 600;
+    std::vector<double> scores(candidates);
+    for (int i = 0; i < candidates; i++) {
+      int value = random() % 8;
+      scores[i] = value == 0 ? std::numeric_limits<double>::infinity() : value;
+    }
+    if (t % 10 == 0) {
+      std::fill(scores.begin(), scores.end(),
+                std::numeric_limits<double>::infinity());
+    }
+    long long expected = -1;
+    for (int i = 0; i < candidates; i++) {
+      if (scores[i] < (expected == -1 ? std::numeric_limits<double>::infinity()
+                                      : scores[expected])) {
+        expected = i;
+      }
+    }
+    auto score = [&](long long i) { return scores[i]; };
+    std::string name = " on " + std::to_string(candidates) + " candidates";
+    check(sequential.best(candidates, score) == expected,
+          "sequential best candidate" + name);
+    check(one.best(candidates, score) == expected,
+          "best candidate with 1 thread" + name);
+    check(many.best(candidates, score) == expected,
+          "best candidate with 4 threads" + name);
+  }
+}
+
+// Records the connections placed by the allocator, in order
+class RecordingAllocator : public SpectrumAllocator {
+ public:
+  RecordingAllocator(void) : SpectrumAllocator(MOST_USED) {}
+  allocationStatus exec(int src, int dst, BitRate bitRate, Connection &con) {
+    allocationStatus status = SpectrumAllocator::exec(src, dst, bitRate, con);
+    this->choices.push_back(con.getId());
+    this->choices.push_back(status == ALLOCATED ? con.getSlots()[0][0] : -1);
+    return status;
+  }
+  std::vector<long long> choices;
+};
+
+std::vector<long long> mostUsed(int numberOfThreads) {
+  Simulator sim(std::string("./networks/NSFNet.json"),
+                std::string("./networks/NSFNet_routes.json"),
+                std::string("./networks/bitrates.json"));
+  RecordingAllocator *allocator = new RecordingAllocator();
+  if (numberOfThreads > 0) allocator->setParallelCandidates(numberOfThreads, 1);
+  sim.setAllocator(allocator);
+  sim.setGoalConnections(20000);
+  sim.setLambda(500);
+  sim.setMu(1);
+  sim.setCommonRandomNumbers(true);
+  sim.setVerbose(false);
+  sim.init();
+  sim.run();
+  return allocator->choices;
+}
+
+int main(void) {
+  randomScores();
+  std::vector<long long> sequential = mostUsed(0);
+  check(!sequential.empty(), "Most Used allocates");
+  check(mostUsed(1) == sequential, "Most Used with 1 thread");
+  check(mostUsed(4) == sequential, "Most Used with 4 threads");
+  std::cout << (failures == 0 ? "ok" : "failed") << '\n';
+  return failures;
+}
@@ -0,0 +1,169 @@
+#include "../src/simulator.hpp"
+/*********************************************************************************
+ * Checks of the slot validation of the Controller and the Links. The bounds
+ * and state of every slot changed by Link::setSlot are only checked on builds
+ * that define BUFFEREON_CHECKED, while Controller::occupy validates every
+ * connection on both, so the driver must pass built both ways:
+ *
+ *   g++ -std=c++17 -O2 tests/slot_checks.cpp -o slot_checks && ./slot_checks
+ *   g++ -std=c++17 -O2 -DBUFFEREON_CHECKED tests/slot_checks.cpp \
+ *       -o slot_checks_checked && ./slot_checks_checked
+ *
+ * It prints every failed check and returns the number of failures.
+ **********************************************************************************/
+
+int failures = 0;
+
+void check(bool condition, const std::string &name) {
+  if (!condition) {
+    std::cout << "FAILED: " << name << '\n';
+    failures++;
+  }
+}
+
+template <typename F>
+bool throws(F function) {
+  try {
+    function();
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+// State of every slot of the network, to tell if a failed operation left it
+// untouched
+std::vector<bool> state(Network *network) {
+  std::vector<bool> slots;
+  for (int i = 0; i < network->getNumberOfLinks(); i++) {
+    Link *link = network->getLink(i);
+    for (int j = 0; j < link->getSlots(); j++) slots.push_back(link->getSlot(j));
+  }
+  return slots;
+}
+
+// The sums of the fragmentation metrics kept by the Links must match a scan
+// of every core and mode
+bool metricsMatch(Network *network) {
+  double fragmentation = 0;
+  double entropy = 0;
+  double blocks = 0;
+  int spectra = 0;
+  for (int i = 0; i < network->getNumberOfLinks(); i++) {
+    Link *link = network->getLink(i);
+    for (int c = 0; c < link->getCores(); c++) {
+      for (int m = 0; m < link->getModes(); m++) {
+        fragmentation += link->getExternalFragmentation(c, m);
+        entropy += link->getSpectrumEntropy(c, m);
+        blocks += link->getNumberOfFreeBlocks(c, m);
+        spectra++;
+      }
+    }
+  }
+  return std::fabs(network->getExternalFragmentation() -
+                   fragmentation / spectra) < 1e-9 &&
+         std::fabs(network->getSpectrumEntropy() - entropy / spectra) <
+             1e-9 &&
+         std::fabs(network->getNumberOfFreeBlocks() - blocks / spectra) <
+             1e-9;
+}
+
+void linkBounds(void) {
+  Link link(0, 100, 16);
+  link.setSlot(3, true);
+  check(link.getSlot(3), "setSlot activates the slot");
+  check(link.getFreeSlots() == 15, "setSlot updates the free slots");
+  check(link.getLargestFreeBlock() == 12, "setSlot splits the free block");
+  link.setSlot(3, false);
+  check(link.getLargestFreeBlock() == 16, "setSlot merges the free blocks");
+#ifdef BUFFEREON_CHECKED
+  check(throws([&] { link.setSlot(-1, true); }), "setSlot below the bounds");
+  check(throws([&] { link.setSlot(16, true); }), "setSlot above the bounds");
+  check(throws([&] { link.setSlot(0, false); }), "setSlot in the same state");
+  check(throws([&] { link.setSlot(1, 0, 0, true); }),
+        "setSlot in a core out of bounds");
+  check(throws([&] { link.setSlot(0, 1, 0, true); }),
+        "setSlot in a mode out of bounds");
+  check(link.getFreeSlots() == 16, "a rejected setSlot changes nothing");
+#endif
+}
+
+void controllerChecks(void) {
+  Network *network = new Network();
+  for (int i = 0; i < 3; i++) network->addNode(new Node(i));
+  for (int i = 0; i < 2; i++) {
+    network->addLink(new Link(i, 100, 16));
+    network->connect(i, i, i + 1);
+  }
+  Controller *controller = new Controller(network);
+
+  Connection placed(0, 0, nullptr);
+  placed.addLink(0, 0, 4);
+  placed.addLink(1, 0, 4);
+  controller->occupy(placed);
+  check(network->getLink(1)->getFreeSlots() == 12, "occupy uses the slots");
+  std::vector<bool> before = state(network);
+
+  // Every check runs before the first slot changes, so a rejected
+  // connection leaves the network as it was
+  Connection outOfLinks(1, 0, nullptr);
+  outOfLinks.addLink(0, 8, 10);
+  outOfLinks.addLink(2, 0, 4);
+  check(throws([&] { controller->occupy(outOfLinks); }),
+        "occupy on a link out of bounds");
+  Connection outOfSlots(2, 0, nullptr);
+  outOfSlots.addLink(0, 8, 10);
+  outOfSlots.addLink(1, 14, 18);
+  check(throws([&] { controller->occupy(outOfSlots); }),
+        "occupy on slots out of bounds");
+  Connection overlapping(3, 0, nullptr);
+  overlapping.addLink(0, 8, 10);
+  overlapping.addLink(1, 2, 6);
+  check(throws([&] { controller->occupy(overlapping); }),
+        "occupy on used slots");
+  Connection twice(4, 0, nullptr);
+  twice.addLink(0, std::vector<int>({8, 9}));
+  twice.addLink(0, std::vector<int>({9, 10}));
+  check(throws([&] { controller->occupy(twice); }),
+        "occupy the same slot twice");
+  check(state(network) == before, "a rejected occupy changes nothing");
+  check(metricsMatch(network), "the metrics after a rejected occupy");
+
+  // A transaction undoes every range it changed, in reverse order
+  controller->beginTransaction();
+  Connection first(5, 0, nullptr);
+  first.addLink(0, 4, 8);
+  first.addLink(1, 4, 8);
+  controller->occupy(first);
+  Connection second(6, 0, nullptr);
+  second.addLink(1, std::vector<int>({8, 9, 12, 13}));
+  controller->occupy(second);
+  check(throws([&] { controller->occupy(overlapping); }),
+        "occupy on used slots inside a transaction");
+  controller->rollbackTransaction();
+  check(state(network) == before, "a rolled back transaction changes nothing");
+  check(metricsMatch(network), "the metrics after a rollback");
+
+  controller->release(placed);
+  check(network->getLink(0)->getFreeSlots() == 16 &&
+            network->getLink(1)->getFreeSlots() == 16,
+        "release frees the slots");
+  check(metricsMatch(network), "the metrics after a release");
+#ifdef BUFFEREON_CHECKED
+  // Released connections are only validated on checked builds
+  before = state(network);
+  check(throws([&] { controller->release(placed); }),
+        "release of free slots");
+  check(state(network) == before, "a rejected release changes nothing");
+#endif
+
+  delete controller;
+  delete network;
+}
+
+int main(void) {
+  linkBounds();
+  controllerChecks();
+  std::cout << (failures == 0 ? "ok" : "failed") << '\n';
+  return failures;
+}
@@ -0,0 +1,188 @@
+#include "../src/simulator.hpp"
+/*********************************************************************************
+ * Randomized checks of SpectrumIndex against a brute-force scan of the slots.
+ * Random intervals are allocated and released on several indexes, and after
+ * every change the gaps, the fits and the intersection of the indexes (the
+ * gaps of a route, see Allocator::routeGaps) must match a scan of the state
+ * of the slots. The indexes kept by the Links must follow Link::setSlot too.
+ *
+ *   g++ -std=c++17 -O2 tests/spectrum_index_checks.cpp -o spectrum_index_checks
+ *   ./spectrum_index_checks [seed] [steps]
+ *
+ * It prints every failed check and returns the number of failures.
+ **********************************************************************************/
+
+int failures = 0;
+
+void check(bool condition, const std::string &name) {
+  if (!condition) {
+    if (failures < 20) std::cout << "FAILED: " << name << '\n';
+    failures++;
+  }
+}
+
+// The free intervals of a slots state, ordered by their first slot
+std::vector<std::pair<int, int>> scanGaps(const std::vector<bool> &state) {
+  std::vector<std::pair<int, int>> gaps;
+  for (unsigned int i = 0; i < state.size(); i++) {
+    if (state[i]) continue;
+    if (i > 0 && !state[i - 1]) {
+      gaps.back().second++;
+    } else {
+      gaps.push_back(std::make_pair(i, 1));
+    }
+  }
+  return gaps;
+}
+
+// The fits by brute force, the reference of the static and member fits
+int scanFirstFit(const std::vector<std::pair<int, int>> &gaps, int length) {
+  for (unsigned int i = 0; i < gaps.size(); i++) {
+    if (gaps[i].second >= length) return gaps[i].first;
+  }
+  return -1;
+}
+
+int scanBestFit(const std::vector<std::pair<int, int>> &gaps, int length) {
+  int best = -1;
+  int bestLength = std::numeric_limits<int>::max();
+  for (unsigned int i = 0; i < gaps.size(); i++) {
+    if (gaps[i].second >= length && gaps[i].second < bestLength) {
+      best = gaps[i].first;
+      bestLength = gaps[i].second;
+    }
+  }
+  return best;
+}
+
+int scanExactFit(const std::vector<std::pair<int, int>> &gaps, int length) {
+  for (unsigned int i = 0; i < gaps.size(); i++) {
+    if (gaps[i].second == length) return gaps[i].first;
+  }
+  return -1;
+}
+
+int scanLastFit(const std::vector<std::pair<int, int>> &gaps, int length) {
+  for (int i = gaps.size() - 1; i >= 0; i--) {
+    if (gaps[i].second >= length) return gaps[i].first + gaps[i].second - length;
+  }
+  return -1;
+}
+
+void compare(const SpectrumIndex &index, const std::vector<bool> &state,
+             const std::string &step) {
+  std::vector<std::pair<int, int>> gaps = scanGaps(state);
+  std::vector<std::pair<int, int>> indexed(index.getGaps().begin(),
+                                           index.getGaps().end());
+  check(indexed == gaps, "gaps after " + step);
+  int free = 0;
+  int largest = 0;
+  for (unsigned int i = 0; i < gaps.size(); i++) {
+    free += gaps[i].second;
+    largest = std::max(largest, gaps[i].second);
+  }
+  check(index.getFreeSlots() == free, "free slots after " + step);
+  check(index.getLargestGap() == largest, "largest gap after " + step);
+  check(index.getNumberOfGaps() == (int)gaps.size(),
+        "number of gaps after " + step);
+  for (int length = 1; length <= largest + 1; length++) {
+    check(index.firstFit(length) == scanFirstFit(gaps, length),
+          "first fit of " + std::to_string(length) + " after " + step);
+    check(index.bestFit(length) == scanBestFit(gaps, length),
+          "best fit of " + std::to_string(length) + " after " + step);
+    check(index.exactFit(length) == scanExactFit(gaps, length),
+          "exact fit of " + std::to_string(length) + " after " + step);
+  }
+  for (unsigned int slot = 0; slot < state.size(); slot++) {
+    std::pair<int, int> gap = index.gapContaining(slot);
+    check(state[slot] ? gap.first == -1
+                      : gap.first <= (int)slot &&
+                            (int)slot < gap.first + gap.second,
+          "gap containing " + std::to_string(slot) + " after " + step);
+  }
+}
+
+void randomIndexes(unsigned int seed, int steps) {
+  const int slots = 64;
+  std::mt19937 random(seed);
+  std::vector<std::vector<bool>> states(3, std::vector<bool>(slots, false));
+  std::vector<SpectrumIndex> indexes(3, SpectrumIndex(slots));
+
+  for (int step = 0; step < steps; step++) {
+    std::string name = "step " + std::to_string(step);
+    int i = random() % indexes.size();
+    int from = random() % slots;
+    int count = 1 + random() % 8;
+    std::vector<bool> &state = states[i];
+    bool used = state[from];
+
+    // Grow the interval while the slots are in the same state, so it is a
+    // valid allocation (inside one gap) or release (only used slots)
+    int to = from;
+    while (to < slots && to - from < count && state[to] == used) to++;
+    if (used) {
+      indexes[i].release(from, to - from);
+    } else {
+      indexes[i].allocate(from, to - from);
+    }
+    for (int s = from; s < to; s++) state[s] = !used;
+    compare(indexes[i], state, name);
+
+    // The indexes built from the state must be the same as the updated ones
+    SpectrumIndex rebuilt(state);
+    check(rebuilt.getGaps() == indexes[i].getGaps(), "rebuilt " + name);
+
+    // The common free intervals and the fits on them
+    std::vector<bool> common(slots, false);
+    for (unsigned int j = 0; j < states.size(); j++) {
+      for (int s = 0; s < slots; s++) common[s] = common[s] || states[j][s];
+    }
+    std::vector<std::pair<int, int>> gaps = scanGaps(common);
+    std::vector<const SpectrumIndex *> route;
+    for (unsigned int j = 0; j < indexes.size(); j++) route.push_back(&indexes[j]);
+    std::vector<std::pair<int, int>> intersection = SpectrumIndex::intersect(route);
+    check(intersection == gaps, "intersection after " + name);
+    for (int length = 1; length <= 9; length++) {
+      std::string fit = " of " + std::to_string(length) + " after " + name;
+      check(SpectrumIndex::firstFit(intersection, length) ==
+                scanFirstFit(gaps, length),
+            "static first fit" + fit);
+      check(SpectrumIndex::lastFit(intersection, length) ==
+                scanLastFit(gaps, length),
+            "static last fit" + fit);
+      check(SpectrumIndex::bestFit(intersection, length) ==
+                scanBestFit(gaps, length),
+            "static best fit" + fit);
+      check(SpectrumIndex::exactFit(intersection, length) ==
+                scanExactFit(gaps, length),
+            "static exact fit" + fit);
+    }
+  }
+}
+
+void linkIndexes(unsigned int seed, int steps) {
+  const int slots = 32;
+  std::mt19937 random(seed);
+  Link link(0, 100, slots);
+  link.setSpectrumIndex(true);
+  std::vector<bool> state(slots, false);
+  for (int step = 0; step < steps; step++) {
+    int slot = random() % slots;
+    state[slot] = !state[slot];
+    link.setSlot(slot, state[slot]);
+    compare(link.getSpectrumIndex(), state, "link step " + std::to_string(step));
+  }
+  // Enabling the index on a used link builds it from the slots
+  link.setSpectrumIndex(false);
+  link.setSpectrumIndex(true);
+  compare(link.getSpectrumIndex(), state, "enabling the index");
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int seed = argc > 1 ? std::stoul(argv[1]) : 12345;
+  int steps = argc > 2 ? std::stoi(argv[2]) : 20000;
+  randomIndexes(seed, steps);
+  linkIndexes(seed, steps / 10);
+  std::cout << (failures == 0 ? "ok" : "failed") << '\n';
+  return failures;
+}